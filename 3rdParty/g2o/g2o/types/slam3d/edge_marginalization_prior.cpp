@@ -0,0 +1,147 @@
+// g2o - General Graph Optimization
+// Copyright (C) 2011 R. Kuemmerle, G. Grisetti, W. Burgard
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "edge_marginalization_prior.h"
+#include "isometry3d_mappings.h"
+
+#include <Eigen/Eigenvalues>
+
+namespace g2o {
+
+  EdgeMarginalizationPrior::EdgeMarginalizationPrior() : BaseMultiEdge<-1, VectorXD>() {
+    resize(0);
+    setDimension(0);
+  }
+
+  void EdgeMarginalizationPrior::setDimension(int dimension_){
+    _dimension = dimension_;
+    _information.setIdentity(dimension_, dimension_);
+    _error.setZero(dimension_, 1);
+    _measurement.setZero(dimension_, 1);
+  }
+
+  bool EdgeMarginalizationPrior::setPrior(const MatrixXD& H, const VectorXD& b){
+    // H = V diag(lambda) V^T -> sqrtH = diag(sqrt(lambda)) V^T, r0 = diag(1/sqrt(lambda)) V^T b
+    Eigen::SelfAdjointEigenSolver<MatrixXD> eigenSolver(0.5*(H + H.transpose()));
+    const VectorXD& lambda = eigenSolver.eigenvalues();
+    const double eps = 1e-8 * std::max(lambda.maxCoeff(), 0.0);
+    int rank = 0;
+    for (int i = 0; i < lambda.size(); ++i)
+      if (lambda[i] > eps)
+        rank++;
+    if (rank == 0)
+      return false;
+    setDimension(rank);
+    _sqrtH.resize(rank, H.cols());
+    _r0.resize(rank);
+    int row = 0;
+    for (int i = 0; i < lambda.size(); ++i){
+      if (lambda[i] <= eps)
+        continue;
+      double sqrtLambda = sqrt(lambda[i]);
+      _sqrtH.row(row) = sqrtLambda * eigenSolver.eigenvectors().col(i).transpose();
+      _r0[row] = eigenSolver.eigenvectors().col(i).dot(b) / sqrtLambda;
+      row++;
+    }
+    // linearization points
+    _linearizationPoints.resize(_vertices.size());
+    for (size_t i = 0; i < _vertices.size(); ++i){
+      const OptimizableGraph::Vertex* v = static_cast<const OptimizableGraph::Vertex*>(_vertices[i]);
+      _linearizationPoints[i].resize(v->estimateDimension());
+      v->getEstimateData(_linearizationPoints[i].data());
+    }
+    return true;
+  }
+
+  VectorXD EdgeMarginalizationPrior::vertexDelta(size_t vertexNo) const {
+    const OptimizableGraph::Vertex* v = static_cast<const OptimizableGraph::Vertex*>(_vertices[vertexNo]);
+    const VectorXD& x0 = _linearizationPoints[vertexNo];
+    if (const VertexSE3* pose = dynamic_cast<const VertexSE3*>(v)){
+      // VertexSE3::oplus: x = x0 * fromVectorMQT(delta)
+      Vector7d x0QT = x0;
+      return internal::toVectorMQT(internal::fromVectorQT(x0QT).inverse() * pose->estimate());
+    }
+    VectorXD estimate(v->estimateDimension());
+    v->getEstimateData(estimate.data());
+    return estimate - x0;
+  }
+
+  void EdgeMarginalizationPrior::computeError(){
+    VectorXD delta(_sqrtH.cols());
+    int col = 0;
+    for (size_t i = 0; i < _vertices.size(); ++i){
+      int dim = static_cast<OptimizableGraph::Vertex*>(_vertices[i])->dimension();
+      delta.segment(col, dim) = vertexDelta(i);
+      col += dim;
+    }
+    _error = _r0 + _sqrtH * delta;
+  }
+
+  void EdgeMarginalizationPrior::linearizeOplus(){
+    int col = 0;
+    for (size_t i = 0; i < _vertices.size(); ++i){
+      int dim = static_cast<OptimizableGraph::Vertex*>(_vertices[i])->dimension();
+      _jacobianOplus[i] = _sqrtH.middleCols(col, dim);
+      col += dim;
+    }
+  }
+
+  bool EdgeMarginalizationPrior::read(std::istream& is){
+    int rank, cols = 0;
+    is >> rank;
+    setDimension(rank);
+    _linearizationPoints.resize(_vertices.size());
+    for (size_t i = 0; i < _vertices.size(); ++i){
+      const OptimizableGraph::Vertex* v = static_cast<const OptimizableGraph::Vertex*>(_vertices[i]);
+      _linearizationPoints[i].resize(v->estimateDimension());
+      for (int j = 0; j < v->estimateDimension(); ++j)
+        is >> _linearizationPoints[i][j];
+      cols += v->dimension();
+    }
+    _r0.resize(rank);
+    for (int i = 0; i < rank; ++i)
+      is >> _r0[i];
+    _sqrtH.resize(rank, cols);
+    for (int i = 0; i < rank; ++i)
+      for (int j = 0; j < cols; ++j)
+        is >> _sqrtH(i,j);
+    return !is.fail();
+  }
+
+  bool EdgeMarginalizationPrior::write(std::ostream& os) const{
+    os << "|| " << _dimension;
+    for (size_t i = 0; i < _linearizationPoints.size(); ++i)
+      for (int j = 0; j < _linearizationPoints[i].size(); ++j)
+        os << " " << _linearizationPoints[i][j];
+    for (int i = 0; i < _r0.size(); ++i)
+      os << " " << _r0[i];
+    for (int i = 0; i < _sqrtH.rows(); ++i)
+      for (int j = 0; j < _sqrtH.cols(); ++j)
+        os << " " << _sqrtH(i,j);
+    return os.good();
+  }
+
+}
@@ -0,0 +1,86 @@
+// g2o - General Graph Optimization
+// Copyright (C) 2011 R. Kuemmerle, G. Grisetti, W. Burgard
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Dense prior obtained by marginalization (Schur complement) of the removed part of the graph
+
+#ifndef G2O_EDGE_MARGINALIZATION_PRIOR_H_
+#define G2O_EDGE_MARGINALIZATION_PRIOR_H_
+
+#include "g2o/config.h"
+#include "g2o_types_slam3d_api.h"
+#include "g2o/core/base_multi_edge.h"
+#include "vertex_se3.h"
+#include "vertex_pointxyz.h"
+
+namespace g2o {
+
+  /*! \class EdgeMarginalizationPrior
+   * \brief dense prior on the Markov blanket of the marginalized vertices (VertexSE3 and VertexPointXYZ)
+   *
+   * The marginalized system H dx = -b (H = J^T Omega J, b = J^T Omega e) is stored as
+   * the linear residual e(x) = r0 + Jp (x [-] x0) with Jp^T Jp = H, Jp^T r0 = b,
+   * where x0 is the estimate of the vertices at the time of the marginalization.
+   */
+  class G2O_TYPES_SLAM3D_API EdgeMarginalizationPrior : public BaseMultiEdge<-1, VectorXD> {
+    public:
+      EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+      EdgeMarginalizationPrior();
+
+      /**
+       * set prior from the marginalized hessian and gradient (vertices have to be set before).
+       * Current estimates of the vertices become linearization points.
+       * returns false if the hessian is empty (no information about the vertices).
+       */
+      bool setPrior(const MatrixXD& H, const VectorXD& b);
+
+      void computeError();
+
+      /// first-estimate Jacobians (constant, evaluated at the linearization point)
+      virtual void linearizeOplus();
+
+      virtual bool read(std::istream& is);
+      virtual bool write(std::ostream& os) const;
+
+      virtual void initialEstimate(const OptimizableGraph::VertexSet&, OptimizableGraph::Vertex*) {}
+      virtual double initialEstimatePossible(const OptimizableGraph::VertexSet&, OptimizableGraph::Vertex*) { return -1.;}
+
+    protected:
+      /// square root of the marginalized hessian
+      MatrixXD _sqrtH;
+      /// residual at the linearization point
+      VectorXD _r0;
+      /// estimates of the vertices at the linearization point
+      std::vector<VectorXD> _linearizationPoints;
+
+      void setDimension(int dimension_);
+
+      /// difference between current estimate of the vertex and its linearization point (in the tangent space)
+      VectorXD vertexDelta(size_t vertexNo) const;
+  };
+
+}
+
+#endif
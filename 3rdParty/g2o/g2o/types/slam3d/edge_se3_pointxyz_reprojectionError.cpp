@@ -37,8 +37,8 @@ namespace g2o {
     resizeParameters(1);
     installParameter(params, 0);
     information().setIdentity();
-//    J.fill(0);
-//    J.block<2,2>(0,0) = -Matrix3D::Identity();
+    J.fill(0);
+    J.block<3,3>(0,0) = -Matrix3D::Identity();
   }
 
   bool EdgeSE3PointXYZReprojectionError::resolveCaches(){
@@ -98,42 +98,43 @@ namespace g2o {
 
     // error, which is backwards from the normal observed - calculated
     // _measurement is the measured projection
-    _error = p.head<2>() - _measurement;
+    _error = p.head<2>()/p(2) - _measurement;
     //    std::cout << _error << std::endl << std::endl;
   }
 
-//  void EdgeSE3PointXYZReprojectionError::linearizeOplus() {
-//    //VertexSE3 *cam = static_cast<VertexSE3 *>(_vertices[0]);
-//    VertexPointXYZ *vp = static_cast<VertexPointXYZ *>(_vertices[1]);
-//
-//    const Vector3D& pt = vp->estimate();
-//
-//    Vector3D Zcam = cache->w2l() * pt;
-//
-//    //  J(0,3) = -0.0;
-//    J(0,4) = -2*Zcam(2);
-//    J(0,5) = 2*Zcam(1);
-//
-//    J(1,3) = 2*Zcam(2);
-//    //  J(1,4) = -0.0;
-//    J(1,5) = -2*Zcam(0);
-//
-//    J(2,3) = -2*Zcam(1);
-//    J(2,4) = 2*Zcam(0);
-//    //  J(2,5) = -0.0;
-//
-//    J.block<3,3>(0,6) = cache->w2l().rotation();
-//
-//    Eigen::Matrix<double,3,9,Eigen::ColMajor> Jprime = params->Kcam_inverseOffsetR()  * J;
-//    Vector3D Zprime = cache->w2i() * pt;
-//
-//    Eigen::Matrix<double,3,9,Eigen::ColMajor> Jhom;
-//    Jhom.block<2,9>(0,0) = 1/(Zprime(2)*Zprime(2)) * (Jprime.block<2,9>(0,0)*Zprime(2) - Zprime.head<2>() * Jprime.block<1,9>(2,0));
-//    Jhom.block<1,9>(2,0) = Jprime.block<1,9>(2,0);
-//
-//    _jacobianOplusXi = Jhom.block<3,6>(0,0);
-//    _jacobianOplusXj = Jhom.block<3,3>(0,6);
-//  }
+  void EdgeSE3PointXYZReprojectionError::linearizeOplus() {
+    //VertexSE3 *cam = static_cast<VertexSE3 *>(_vertices[0]);
+    VertexPointXYZ *vp = static_cast<VertexPointXYZ *>(_vertices[1]);
+
+    const Vector3D& pt = vp->estimate();
+
+    // point in the local frame of the pose (derivative w.r.t. the rotation part of the minimal quaternion)
+    Vector3D Zcam = cache->w2l() * pt;
+
+    //  J(0,3) = -0.0;
+    J(0,4) = -2*Zcam(2);
+    J(0,5) = 2*Zcam(1);
+
+    J(1,3) = 2*Zcam(2);
+    //  J(1,4) = -0.0;
+    J(1,5) = -2*Zcam(0);
+
+    J(2,3) = -2*Zcam(1);
+    J(2,4) = 2*Zcam(0);
+    //  J(2,5) = -0.0;
+
+    J.block<3,3>(0,6) = cache->w2l().rotation();
+
+    // homogeneous image coordinates
+    Eigen::Matrix<double,3,9,Eigen::ColMajor> Jprime = params->Kcam_inverseOffsetR()  * J;
+    Vector3D Zprime = cache->w2i() * pt;
+
+    // perspective division
+    Eigen::Matrix<double,2,9,Eigen::ColMajor> Jhom = 1/(Zprime(2)*Zprime(2)) * (Jprime.block<2,9>(0,0)*Zprime(2) - Zprime.head<2>() * Jprime.block<1,9>(2,0));
+
+    _jacobianOplusXi = Jhom.block<2,6>(0,0);
+    _jacobianOplusXj = Jhom.block<2,3>(0,6);
+  }
 
 
   bool EdgeSE3PointXYZReprojectionError::setMeasurementFromState(){
@@ -144,7 +145,7 @@ namespace g2o {
     const Vector3D& pt = point->estimate();
 
     Vector3D p = cache->w2i() * pt;
-    _measurement = p.head<2>();
+    _measurement = p.head<2>()/p(2);
     return true;
   }
 
@@ -48,10 +48,10 @@ namespace g2o {
     virtual bool read(std::istream& is);
     virtual bool write(std::ostream& os) const;
 
-    // return the error estimate as a 3-vector
+    // return the error estimate as a 2-vector (projection of the point minus measurement)
     void computeError();
     // jacobian
-    //virtual void linearizeOplus();
+    virtual void linearizeOplus();
 
 
     virtual void setMeasurement(const Vector2D& m){
@@ -83,7 +83,7 @@ namespace g2o {
     virtual void initialEstimate(const OptimizableGraph::VertexSet& from, OptimizableGraph::Vertex* to);
 
   private:
-   // Eigen::Matrix<double,3,9,Eigen::ColMajor> J; // jacobian before projection
+    Eigen::Matrix<double,3,9,Eigen::ColMajor> J; // jacobian before projection
 
     virtual bool resolveCaches();
     ParameterCamera* params;
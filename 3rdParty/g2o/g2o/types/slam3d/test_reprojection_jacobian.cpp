@@ -0,0 +1,117 @@
+// g2o - General Graph Optimization
+// Copyright (C) 2011 R. Kuemmerle, G. Grisetti, W. Burgard
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <iostream>
+#include <cstdio>
+
+#include "g2o/core/jacobian_workspace.h"
+#include "g2o/core/optimizable_graph.h"
+#include "g2o/stuff/macros.h"
+#include "edge_se3_pointxyz_reprojectionError.h"
+
+using namespace std;
+using namespace g2o;
+using namespace Eigen;
+
+Isometry3D randomIsometry3d()
+{
+  Vector3D rotAxisAngle = Vector3D::Random();
+  rotAxisAngle += Vector3D::Random();
+  Eigen::AngleAxisd rotation(rotAxisAngle.norm(), rotAxisAngle.normalized());
+  Isometry3D result = (Isometry3D)rotation.toRotationMatrix();
+  result.translation() = Vector3D::Random();
+  return result;
+}
+
+int main(int , char** )
+{
+  OptimizableGraph graph;
+  ParameterCamera* cameraParam = new ParameterCamera;
+  cameraParam->setId(0);
+  cameraParam->setKcam(525.0, 525.0, 320.0, 240.0);
+  graph.addParameter(cameraParam);
+
+  VertexSE3* v1 = new VertexSE3;
+  v1->setId(0);
+  graph.addVertex(v1);
+
+  VertexPointXYZ* v2 = new VertexPointXYZ;
+  v2->setId(1);
+  graph.addVertex(v2);
+
+  EdgeSE3PointXYZReprojectionError* e = new EdgeSE3PointXYZReprojectionError;
+  e->setVertex(0, v1);
+  e->setVertex(1, v2);
+  e->setParameterId(0, 0);
+  e->setMeasurement(Vector2D(320.0, 240.0));
+  graph.addEdge(e);
+
+  JacobianWorkspace jacobianWorkspace;
+  JacobianWorkspace numericJacobianWorkspace;
+  numericJacobianWorkspace.updateSize(e);
+  numericJacobianWorkspace.allocate();
+
+  for (int k = 0; k < 100000; ++k) {
+    cameraParam->setOffset(randomIsometry3d());
+    v1->setEstimate(randomIsometry3d());
+    // point in front of the camera
+    Vector3D pointCam = Vector3D::Random();
+    pointCam(2) = 1.0 + 4.0 * fabs(pointCam(2));
+    v2->setEstimate(v1->estimate() * (cameraParam->offset() * pointCam));
+    e->setMeasurement(Vector2D(320.0, 240.0) + 50.0 * Vector2D::Random());
+
+    // calling the analytic Jacobian but writing to the numeric workspace
+    e->BaseBinaryEdge<2, Vector2D, VertexSE3, VertexPointXYZ>::linearizeOplus(numericJacobianWorkspace);
+    // copy result into analytic workspace
+    jacobianWorkspace = numericJacobianWorkspace;
+
+    // compute the numeric Jacobian into the numericJacobianWorkspace workspace as setup by the previous call
+    e->BaseBinaryEdge<2, Vector2D, VertexSE3, VertexPointXYZ>::linearizeOplus();
+
+    // compare the two Jacobians (relative to the magnitude of the entries, pixels per metre can be large)
+    const double allowedDifference = 1e-3;
+    const int dimensions[2] = {6, 3};
+    for (int i = 0; i < 2; ++i) {
+      double* n = numericJacobianWorkspace.workspaceForVertex(i);
+      double* a = jacobianWorkspace.workspaceForVertex(i);
+      for (int j = 0; j < 2*dimensions[i]; ++j) {
+        double d = fabs(n[j] - a[j]) / std::max(1.0, fabs(a[j]));
+        if (d > allowedDifference) {
+          cerr << "\ndetected difference in the Jacobians " << d << endl;
+          cerr << PVAR(v1->estimate().matrix()) << endl << endl;
+          cerr << PVAR(v2->estimate().transpose()) << endl << endl;
+          cerr << PVAR(cameraParam->offset().matrix()) << endl << endl;
+          return 1;
+        }
+      }
+    }
+    if (k % 1000 == 0)
+      cerr << "+";
+
+  }
+  cerr << endl;
+  return 0;
+}
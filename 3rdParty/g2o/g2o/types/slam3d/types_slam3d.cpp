@@ -44,6 +44,7 @@ namespace g2o {
   G2O_REGISTER_TYPE(EDGE_POINTXYZ, EdgePointXYZ);
 
   G2O_REGISTER_TYPE(EDGE_SE3_LOTSOF_XYZ, EdgeSE3LotsOfXYZ)
+  G2O_REGISTER_TYPE(EDGE_MARGINALIZATION_PRIOR, EdgeMarginalizationPrior)
 
   /*********** ACTIONS ************/
   G2O_REGISTER_ACTION(VertexSE3WriteGnuplotAction);
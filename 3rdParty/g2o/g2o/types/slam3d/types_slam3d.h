@@ -42,4 +42,5 @@
 #include "edge_pointxyz.h"
 
 #include "edge_se3_lotsofxyz.h"
+#include "edge_marginalization_prior.h"
 #endif
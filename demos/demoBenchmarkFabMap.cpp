@@ -0,0 +1,121 @@
+/** @file demoBenchmarkFabMap.cpp
+ *
+ * Benchmark of FabMap variants (FABMAP1, FABMAPLUT, FABMAPFBO, FABMAP2)
+ * stored BOW sequence is replayed to build the map of places (perturbed copies of the sequence are used to reach
+ * 10^4-10^5 places), then noisy revisits of known places are queried and per-query latency and recall@1 are reported
+ *
+ */
+#include <iostream>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include "Defs/opencv.h"
+#include "VisualPlaceRecognition/put_ofm.h"
+
+/// copy of the BOW with randomly removed/added words
+cv::Mat perturb(const cv::Mat& bow, double dropout, double noise, std::mt19937& generator) {
+    cv::Mat result = bow.clone();
+    std::uniform_real_distribution<double> uniform(0, 1);
+    float* values = result.ptr<float>(0);
+    for (int j = 0; j < result.cols; j++) {
+        if (values[j] > 0 && uniform(generator) < dropout)
+            values[j] = 0;
+        else if (values[j] == 0 && uniform(generator) < noise)
+            values[j] = 1;
+    }
+    return result;
+}
+
+int main(int argc, char * argv[])
+{
+    try {
+        if (argc < 3) {
+            std::cout << "Usage: demoBenchmarkFabMap settings.yml bowSequence.yml [queriesNo [placesNo ...]]\n";
+            std::cout << "settings.yml: openFABMAP settings (ChowLiuTree, TrainImagDesc, openFabMapOptions)\n";
+            std::cout << "bowSequence.yml: BOWImageDescs - BOW descriptors of the sequence (one image per row)\n";
+            std::cout << "queriesNo: number of queries (default 100), placesNo: sizes of the map (default 1000 10000 100000)\n";
+            std::cout << "larger maps are skipped if the variant already took more than 10 minutes\n";
+            return 0;
+        }
+        cv::FileStorage settings(argv[1], cv::FileStorage::READ);
+        if (!settings.isOpened()) {
+            std::cerr << "Could not open settings file: " << argv[1] << std::endl;
+            return 1;
+        }
+        cv::FileStorage fs(argv[2], cv::FileStorage::READ);
+        cv::Mat sequence;
+        fs["BOWImageDescs"] >> sequence;
+        fs.release();
+        if (sequence.empty()) {
+            std::cerr << argv[2] << ": BOW sequence not found" << std::endl;
+            return 1;
+        }
+        if (sequence.type() != CV_32F)
+            sequence.convertTo(sequence, CV_32F);
+
+        int queriesNo = (argc > 3) ? atoi(argv[3]) : 100;
+        std::vector<int> placesNos;
+        for (int i = 4; i < argc; i++)
+            placesNos.push_back(atoi(argv[i]));
+        if (placesNos.empty())
+            placesNos = {1000, 10000, 100000};
+        const double timeLimit = 600;
+        const double dropout = 0.2, noise = 0.001;
+
+        std::vector<std::string> versions = {"FABMAP1", "FABMAPLUT", "FABMAPFBO", "FABMAP2"};
+        std::cout << "version\tplaces\tadd[us]\tquery mean[ms]\tquery p95[ms]\trecall@1\n";
+        for (size_t v = 0; v < versions.size(); v++) {
+            double variantTime = 0;
+            for (size_t p = 0; p < placesNos.size(); p++) {
+                if (variantTime > timeLimit) {
+                    std::cout << versions[v] << "\t" << placesNos[p] << "\tskipped (time limit)\n";
+                    continue;
+                }
+                auto variantStart = std::chrono::high_resolution_clock::now();
+                cv::Ptr<of2::FabMap> fabMap(generateFABMAPInstance(settings, versions[v]));
+                if (!fabMap)
+                    return 1;
+
+                // map: place i is a perturbed copy of image (i mod sequence length)
+                std::mt19937 generator(1);
+                auto start = std::chrono::high_resolution_clock::now();
+                for (int i = 0; i < placesNos[p]; i++)
+                    fabMap->add(perturb(sequence.row(i % sequence.rows), dropout, noise, generator));
+                double addTime = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+
+                // queries: revisits of random places, correct if the best match shows the same image of the sequence
+                std::vector<double> latencies;
+                int correct = 0;
+                std::uniform_int_distribution<int> placeDist(0, placesNos[p] - 1);
+                for (int q = 0; q < queriesNo; q++) {
+                    int place = placeDist(generator);
+                    cv::Mat query = perturb(sequence.row(place % sequence.rows), dropout, noise, generator);
+                    std::vector<of2::IMatch> matches;
+                    start = std::chrono::high_resolution_clock::now();
+                    fabMap->compare(query, matches, false);
+                    latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+                    std::vector<of2::IMatch>::iterator best = std::max_element(matches.begin(), matches.end());
+                    if (best != matches.end() && best->imgIdx >= 0 && best->imgIdx % sequence.rows == place % sequence.rows)
+                        correct++;
+                }
+                std::sort(latencies.begin(), latencies.end());
+                double meanLatency = 0;
+                for (size_t i = 0; i < latencies.size(); i++)
+                    meanLatency += latencies[i];
+                meanLatency /= (double)std::max((size_t)1, latencies.size());
+                double p95Latency = latencies.empty() ? 0 : latencies[std::min(latencies.size() - 1, (size_t)(0.95 * (double)latencies.size()))];
+
+                std::cout << versions[v] << "\t" << placesNos[p] << "\t" << addTime / placesNos[p] << "\t"
+                          << meanLatency << "\t" << p95Latency << "\t" << (double)correct / std::max(1, queriesNo) << std::endl;
+                variantTime += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - variantStart).count();
+            }
+        }
+    }
+    catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
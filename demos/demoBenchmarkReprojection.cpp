@@ -0,0 +1,157 @@
+/** @file demoBenchmarkReprojection.cpp
+ *
+ * Benchmark of the reprojection error edge: analytic vs numeric Jacobians
+ * (edge linearization and PoseGraphG2O::optimize on the synthetic reprojection-error graph)
+ *
+ */
+#include <iostream>
+#include <random>
+#include <chrono>
+#include "Defs/putslam_defs.h"
+#include "PoseGraph/graph_g2o.h"
+
+using namespace std;
+using namespace putslam;
+
+/// camera parameters
+const double focalU = 525.0, focalV = 525.0, centerU = 320.0, centerV = 240.0;
+
+/// reprojection error edge with numeric differentiation implemented in g2o::BaseBinaryEdge
+class EdgeSE3PointXYZReprojectionErrorNumeric : public g2o::EdgeSE3PointXYZReprojectionError {
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    virtual void linearizeOplus(){
+        g2o::BaseBinaryEdge<2, g2o::Vector2D, g2o::VertexSE3, g2o::VertexPointXYZ>::linearizeOplus();
+    }
+};
+
+/// edges created by PoseGraphG2O (factory tag EDGE_SE3_REPROJECTION) use numeric or analytic Jacobians
+void setNumericJacobians(bool numeric){
+    g2o::Factory* factory = g2o::Factory::instance();
+    factory->unregisterType("EDGE_SE3_REPROJECTION");
+    if (numeric)
+        factory->registerType("EDGE_SE3_REPROJECTION", new g2o::HyperGraphElementCreator<EdgeSE3PointXYZReprojectionErrorNumeric>);
+    else
+        factory->registerType("EDGE_SE3_REPROJECTION", new g2o::HyperGraphElementCreator<g2o::EdgeSE3PointXYZReprojectionError>);
+}
+
+/// linearize reprojection edges 'iterNo' times, returns time [ms]
+double linearizeEdges(int edgesNo, int iterNo, bool analytic){
+    g2o::OptimizableGraph graph;
+    g2o::ParameterCamera* cameraParam = new g2o::ParameterCamera;
+    cameraParam->setId(0);
+    cameraParam->setKcam(focalU, focalV, centerU, centerV);
+    graph.addParameter(cameraParam);
+
+    std::default_random_engine generator(1);
+    std::uniform_real_distribution<double> distribution(-1.0,1.0);
+    std::vector<g2o::EdgeSE3PointXYZReprojectionError*> edges;
+    g2o::VertexSE3* pose = new g2o::VertexSE3;
+    pose->setId(0);
+    pose->setEstimate(Eigen::Isometry3d::Identity());
+    graph.addVertex(pose);
+    for (int i=0;i<edgesNo;i++){
+        g2o::VertexPointXYZ* point = new g2o::VertexPointXYZ;
+        point->setId(i+1);
+        point->setEstimate(Eigen::Vector3d(distribution(generator), distribution(generator), 3.0+distribution(generator)));
+        graph.addVertex(point);
+        g2o::EdgeSE3PointXYZReprojectionError* e = new g2o::EdgeSE3PointXYZReprojectionError;
+        e->setVertex(0, pose);
+        e->setVertex(1, point);
+        e->setParameterId(0, 0);
+        graph.addEdge(e);
+        e->setMeasurementFromState();
+        edges.push_back(e);
+    }
+    g2o::JacobianWorkspace jacobianWorkspace;
+    jacobianWorkspace.updateSize(edges[0]);
+    jacobianWorkspace.allocate();
+    // map jacobians of the edges to the workspace
+    for (auto& e : edges)
+        static_cast<g2o::OptimizableGraph::Edge*>(e)->linearizeOplus(jacobianWorkspace);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int iter=0;iter<iterNo;iter++){
+        for (auto& e : edges){
+            if (analytic)
+                e->linearizeOplus();
+            else // numeric differentiation implemented in g2o::BaseBinaryEdge
+                e->g2o::BaseBinaryEdge<2, g2o::Vector2D, g2o::VertexSE3, g2o::VertexPointXYZ>::linearizeOplus();
+        }
+    }
+    return (double)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count()/1000.0;
+}
+
+/// create synthetic graph (camera moving along x axis, features on the wall in front of the camera)
+void createGraph(PoseGraphG2O& graph, int posesNo, int featuresNo){
+    std::default_random_engine generator(1);
+    std::normal_distribution<double> noise(0.0,1.0);
+    std::vector<Eigen::Vector3d> features;
+    for (int i=0;i<featuresNo;i++)
+        features.push_back(Eigen::Vector3d(0.1*posesNo*(double)i/featuresNo-1.0, 2.0*(double)(i%11)/11.0-1.0, 3.0+0.5*(double)(i%5)/5.0));
+    for (int poseNo=0;poseNo<posesNo;poseNo++){
+        Mat34 pose(Mat34::Identity());
+        pose(0,3) = 0.1*poseNo;
+        Mat34 poseInit(pose);
+        if (poseNo>0){
+            poseInit(0,3) += 0.01*noise(generator); poseInit(1,3) += 0.01*noise(generator);
+        }
+        graph.addVertexPose(VertexSE3(poseNo, poseInit));
+        if (poseNo>0){
+            Mat34 odometry(Mat34::Identity());
+            odometry(0,3) = 0.1;
+            graph.addEdgeSE3(EdgeSE3(odometry, Mat66::Identity()*10.0, poseNo-1, poseNo));
+        }
+    }
+    for (int i=0;i<featuresNo;i++){
+        Eigen::Vector3d featureInit = features[i] + 0.01*Eigen::Vector3d(noise(generator), noise(generator), noise(generator));
+        graph.addVertexFeature(Vertex3D(posesNo+i, Vec3(featureInit)));
+        for (int poseNo=0;poseNo<posesNo;poseNo++){
+            Eigen::Vector3d pointCam = features[i] - Eigen::Vector3d(0.1*poseNo, 0, 0);
+            double u = focalU*pointCam.x()/pointCam.z()+centerU, v = focalV*pointCam.y()/pointCam.z()+centerV;
+            if (u<0||u>2*centerU||v<0||v>2*centerV)
+                continue;
+            graph.addEdge3DReproj(Edge3DReproj(u+0.5*noise(generator), v+0.5*noise(generator), Eigen::Matrix<double,2,2>::Identity(), poseNo, posesNo+i));
+        }
+    }
+}
+
+/// optimize synthetic graph, returns time [ms]
+double optimizeGraph(int posesNo, int featuresNo, int iterNo, bool numeric){
+    setNumericJacobians(numeric);
+    PoseGraphG2O graph;
+    graph.setCameraParameters(focalU, focalV, centerU, centerV);
+    createGraph(graph, posesNo, featuresNo);
+    auto start = std::chrono::high_resolution_clock::now();
+    graph.optimize(iterNo, 0);
+    return (double)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count()/1000.0;
+}
+
+int main(int argc, char * argv[])
+{
+    try {
+        int posesNo = (argc>1) ? atoi(argv[1]) : 100;
+        int featuresNo = (argc>2) ? atoi(argv[2]) : 1000;
+        int iterNo = (argc>3) ? atoi(argv[3]) : 10;
+
+        std::cout << "Reprojection edge linearization (" << 10*featuresNo << " edges x " << iterNo << " iterations):\n";
+        double analyticTime = linearizeEdges(10*featuresNo, iterNo, true);
+        double numericTime = linearizeEdges(10*featuresNo, iterNo, false);
+        std::cout << "analytic Jacobians: " << analyticTime << " ms\n";
+        std::cout << "numeric Jacobians: " << numericTime << " ms\n";
+        std::cout << "speed-up: " << numericTime/analyticTime << "\n";
+
+        std::cout << "PoseGraphG2O::optimize, reprojection error (" << posesNo << " poses, " << featuresNo << " features, " << iterNo << " iterations):\n";
+        double analyticOptTime = optimizeGraph(posesNo, featuresNo, iterNo, false);
+        double numericOptTime = optimizeGraph(posesNo, featuresNo, iterNo, true);
+        setNumericJacobians(false);
+        std::cout << "analytic Jacobians: " << analyticOptTime << " ms\n";
+        std::cout << "numeric Jacobians: " << numericOptTime << " ms\n";
+        std::cout << "speed-up: " << numericOptTime/analyticOptTime << "\n";
+    }
+    catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+/** @file demoSimulator.cpp
+ *
+ * Synthetic scene generator for stress-testing the back-end
+ * room with 10^5-10^6 features, camera moving along the circle (or the loaded trajectory),
+ * saves the measurement stream, the graph (g2o format) and the ground truth of features,
+ * optionally the graph is loaded to PoseGraphG2O and optimized
+ *
+ * usage: demoSimulator [pointsNo=100000] [posesNo=500] [roomSize=20] [cellSize=0.5] [threads=0] [iterations=0]
+ *        [outputPrefix=../../results/simulator_] [trajectory.txt (Freiburg format)]
+ *
+ */
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+#include "Defs/putslam_defs.h"
+#include "Utilities/simulator.h"
+#include "Grabber/depthSensorModel.h"
+#include "PoseGraph/graph_g2o.h"
+
+using namespace putslam;
+
+/// circular trajectory in the room (camera looks outside the circle)
+std::vector<Mat34> circleTrajectory(int posesNo, double radius, double height) {
+    std::vector<Mat34> trajectory;
+    for (int i = 0; i < posesNo; i++) {
+        double angle = 2.0 * M_PI * (double) i / (double) posesNo;
+        Eigen::Vector3d axisZ(cos(angle), sin(angle), 0), axisY(0, 0, -1);
+        Mat34 pose(Mat34::Identity());
+        pose.matrix().block<3, 1>(0, 0) = axisY.cross(axisZ);
+        pose.matrix().block<3, 1>(0, 1) = axisY;
+        pose.matrix().block<3, 1>(0, 2) = axisZ;
+        pose(0, 3) = radius * cos(angle);
+        pose(1, 3) = radius * sin(angle);
+        pose(2, 3) = height;
+        trajectory.push_back(pose);
+    }
+    return trajectory;
+}
+
+int main(int argc, char * argv[]) {
+    try {
+        size_t pointsNo = (argc > 1) ? (size_t) atol(argv[1]) : 100000;
+        int posesNo = (argc > 2) ? atoi(argv[2]) : 500;
+        double roomSize = (argc > 3) ? atof(argv[3]) : 20.0;
+        double cellSize = (argc > 4) ? atof(argv[4]) : 0.5;
+        int threadsNo = (argc > 5) ? atoi(argv[5]) : 0;
+        int iterNo = (argc > 6) ? atoi(argv[6]) : 0;
+        std::string outputPrefix = (argc > 7) ? argv[7] : "../../results/simulator_";
+
+        Simulator simulator(1);
+        DepthSensorModel sensorModel("putslamfileModel.xml");
+        std::vector<Mat34> trajectory;
+        if (argc > 8) {
+            simulator.loadTrajectory(argv[8]);
+            trajectory = simulator.getTrajectory();
+        }
+        else
+            trajectory = circleTrajectory(posesNo, roomSize / 4.0, 1.5);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        simulator.createRoom(pointsNo, roomSize, roomSize, 3.0);
+        simulator.buildIndex(cellSize);
+        std::cout << "environment: " << simulator.getEnvironment().size() << " points, "
+                << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count()
+                << " ms\n";
+
+        start = std::chrono::high_resolution_clock::now();
+        Simulator::SequenceConfig sequenceConfig;
+        sequenceConfig.threadsNo = threadsNo;
+        if (!simulator.generateSequence(trajectory, Mat34::Identity(), sensorModel, outputPrefix + "measurements.txt",
+                outputPrefix + "graph.g2o", sequenceConfig))
+            return 1;
+        simulator.saveEnvironment(outputPrefix + "features.txt");
+        std::cout << "sequence: " << trajectory.size() << " poses, "
+                << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count()
+                << " ms\n";
+
+        if (iterNo > 0) {
+            PoseGraphG2O graph;
+            start = std::chrono::high_resolution_clock::now();
+            graph.load(outputPrefix + "graph.g2o");
+            std::cout << "graph loaded: "
+                    << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count()
+                    << " ms\n";
+            start = std::chrono::high_resolution_clock::now();
+            graph.optimize(iterNo, 1);
+            std::cout << "optimization (" << iterNo << " iterations): "
+                    << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count()
+                    << " ms\n";
+            graph.export2RGBDSLAM(outputPrefix + "graph_trajectory.res");
+        }
+    }
+    catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
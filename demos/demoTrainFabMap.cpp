@@ -0,0 +1,163 @@
+/** @file demoTrainFabMap.cpp
+ *
+ * Out-of-core training of the FabMap model (vocabulary tree, Chow-Liu tree and FabMap training data)
+ * descriptor files are streamed one by one (each file is a chunk), only a sample of descriptors
+ * (vocabulary) and word co-occurrence statistics (Chow-Liu tree) are kept in memory
+ * the output is loaded by generateFABMAPInstance and VisualPlaceRecognition
+ *
+ */
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <chrono>
+#include "Defs/opencv.h"
+#include "VisualPlaceRecognition/openfabmap.hpp"
+
+/// read descriptors of images stored in the file (ImageDescriptors - sequence of matrices)
+bool readImageDescriptors(const std::string& filename, std::vector<cv::Mat>& imageDescriptors) {
+    cv::FileStorage fs(filename, cv::FileStorage::READ);
+    if (!fs.isOpened()) {
+        std::cerr << "Could not open descriptors file: " << filename << std::endl;
+        return false;
+    }
+    imageDescriptors.clear();
+    fs["ImageDescriptors"] >> imageDescriptors;
+    fs.release();
+    return true;
+}
+
+int main(int argc, char * argv[])
+{
+    try {
+        if (argc < 3) {
+            std::cout << "Usage: demoTrainFabMap settings.yml descriptorFiles.txt\n";
+            std::cout << "descriptorFiles.txt: list of files (one per line) with ImageDescriptors - sequence of descriptors of training images\n";
+            std::cout << "settings.yml: FilePaths/VocabularyTree (trained if the file does not exist), FilePaths/ChowLiuTree, FilePaths/TrainImagDesc,\n";
+            std::cout << "VocabularyTreeOptions/Branching, Depth, Iterations, MaxTrainDescriptors, ChowLiuOptions/MaxTrainImages\n";
+            return 0;
+        }
+        cv::FileStorage settings(argv[1], cv::FileStorage::READ);
+        if (!settings.isOpened()) {
+            std::cerr << "Could not open settings file: " << argv[1] << std::endl;
+            return 1;
+        }
+        std::string vocabTreePath = settings["FilePaths"]["VocabularyTree"];
+        std::string chowliutreePath = settings["FilePaths"]["ChowLiuTree"];
+        std::string fabmapTrainDataPath = settings["FilePaths"]["TrainImagDesc"];
+        int branching = settings["VocabularyTreeOptions"]["Branching"];
+        int depth = settings["VocabularyTreeOptions"]["Depth"];
+        int iterations = settings["VocabularyTreeOptions"]["Iterations"];
+        int maxTrainDescriptors = settings["VocabularyTreeOptions"]["MaxTrainDescriptors"];
+        int maxTrainImages = settings["ChowLiuOptions"]["MaxTrainImages"];
+        if (branching < 2) branching = 10;
+        if (depth < 1) depth = 5;
+        if (iterations < 1) iterations = 10;
+        if (maxTrainDescriptors < 1) maxTrainDescriptors = 1000000;
+        if (maxTrainImages < 1) maxTrainImages = 1000;
+
+        std::vector<std::string> descriptorFiles;
+        std::ifstream list(argv[2]);
+        std::string line;
+        while (std::getline(list, line))
+            if (!line.empty())
+                descriptorFiles.push_back(line);
+        if (descriptorFiles.empty()) {
+            std::cerr << argv[2] << ": no descriptor files" << std::endl;
+            return 1;
+        }
+
+        std::mt19937 generator(0);
+        std::vector<cv::Mat> imageDescriptors;
+
+        // vocabulary: reservoir sample of descriptors from all files
+        of2::VocabularyTree vocabTree(branching, depth);
+        if (!vocabTree.load(vocabTreePath)) {
+            cv::Mat sample;
+            uint64_t descriptorsNo = 0;
+            for (size_t file = 0; file < descriptorFiles.size(); file++) {
+                if (!readImageDescriptors(descriptorFiles[file], imageDescriptors))
+                    continue;
+                for (size_t i = 0; i < imageDescriptors.size(); i++) {
+                    for (int row = 0; row < imageDescriptors[i].rows; row++, descriptorsNo++) {
+                        if (sample.rows < maxTrainDescriptors)
+                            sample.push_back(imageDescriptors[i].row(row));
+                        else {
+                            uint64_t pos = std::uniform_int_distribution<uint64_t>(0, descriptorsNo)(generator);
+                            if (pos < (uint64_t)maxTrainDescriptors)
+                                imageDescriptors[i].row(row).copyTo(sample.row((int)pos));
+                        }
+                    }
+                }
+            }
+            if (sample.empty()) {
+                std::cerr << "Training descriptors not found" << std::endl;
+                return 1;
+            }
+            std::cout << "Training vocabulary tree (branching " << branching << ", depth " << depth << ") on "
+                      << sample.rows << " of " << descriptorsNo << " descriptors" << std::endl;
+            vocabTree.train(sample, iterations);
+        }
+        else
+            std::cout << "Vocabulary tree loaded from " << vocabTreePath << std::endl;
+
+        // co-occurrence statistics, BOWs of each chunk are computed in parallel
+        auto start = std::chrono::high_resolution_clock::now();
+        of2::ChowLiuTreeBuilder treeBuilder(vocabTree.getWordsNo());
+        cv::Mat trainBOWs;
+        uint64_t imagesNo = 0;
+        std::vector<uint64_t> occurrences(vocabTree.getWordsNo(), 0);
+        for (size_t file = 0; file < descriptorFiles.size(); file++) {
+            if (!readImageDescriptors(descriptorFiles[file], imageDescriptors) || imageDescriptors.empty())
+                continue;
+            cv::Mat chunkBOWs((int)imageDescriptors.size(), vocabTree.getWordsNo(), CV_32F);
+#pragma omp parallel for schedule(dynamic)
+            for (int i = 0; i < (int)imageDescriptors.size(); i++) {
+                cv::Mat bow;
+                vocabTree.transform(imageDescriptors[i], bow);
+                bow.copyTo(chunkBOWs.row(i));
+            }
+            treeBuilder.add(chunkBOWs);
+            for (int i = 0; i < chunkBOWs.rows; i++, imagesNo++) {
+                for (int j = 0; j < chunkBOWs.cols; j++)
+                    if (chunkBOWs.at<float>(i, j) > 0)
+                        occurrences[j]++;
+                // FabMap training data (sampled new place method) -- reservoir sample of images
+                if (trainBOWs.rows < maxTrainImages)
+                    trainBOWs.push_back(chunkBOWs.row(i));
+                else {
+                    uint64_t pos = std::uniform_int_distribution<uint64_t>(0, imagesNo)(generator);
+                    if (pos < (uint64_t)maxTrainImages)
+                        chunkBOWs.row(i).copyTo(trainBOWs.row((int)pos));
+                }
+            }
+            std::cout << descriptorFiles[file] << ": " << imageDescriptors.size() << " images" << std::endl;
+        }
+        if (imagesNo == 0) {
+            std::cerr << "Training images not found" << std::endl;
+            return 1;
+        }
+
+        // IDF weights from all images
+        vocabTree.computeWeights(occurrences, imagesNo);
+        std::cout << "Training Chow-Liu tree on " << imagesNo << " images" << std::endl;
+        cv::Mat clTree = treeBuilder.make();
+        double trainingTime = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        std::cout << "\nChow-Liu tree training time: " << trainingTime << "s" << std::endl;
+
+        if (!vocabTree.save(vocabTreePath))
+            return 1;
+        cv::FileStorage fs(chowliutreePath, cv::FileStorage::WRITE);
+        fs << "ChowLiuTree" << clTree;
+        fs.release();
+        fs.open(fabmapTrainDataPath, cv::FileStorage::WRITE);
+        fs << "BOWImageDescs" << trainBOWs;
+        fs.release();
+        std::cout << "Model saved: " << vocabTreePath << ", " << chowliutreePath << ", " << fabmapTrainDataPath << std::endl;
+    }
+    catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,147 @@
+/** @file demoVocabularyTree.cpp
+ *
+ * Training of the hierarchical vocabulary (vocabulary tree) from openFABMAP descriptor files
+ * and comparison of the quantisation time with the flat vocabulary
+ * binary descriptors (ORB, LDB) are clustered with k-majority, the Chow-Liu tree and FabMap training data
+ * are computed from BOWs of training images, so the whole FabMap stack runs on frontend descriptors
+ *
+ */
+#include <iostream>
+#include <chrono>
+#include <cfloat>
+#include "Defs/opencv.h"
+#include "VisualPlaceRecognition/openfabmap.hpp"
+
+int main(int argc, char * argv[])
+{
+    try {
+        if (argc < 2) {
+            std::cout << "Usage: demoVocabularyTree settings.yml [imageDescriptors.yml]\n";
+            std::cout << "settings.yml: FilePaths/VocabTrainData (descriptors), FilePaths/VocabularyTree (output),\n";
+            std::cout << "VocabularyTreeOptions/Branching, VocabularyTreeOptions/Depth, VocabularyTreeOptions/Iterations\n";
+            std::cout << "imageDescriptors.yml: ImageDescriptors - sequence of descriptors of training images (IDF weights)\n";
+            std::cout << "if FilePaths/ChowLiuTree and FilePaths/TrainImagDesc are set, the Chow-Liu tree (ChowLiuOptions/LowerInfoBound)\n";
+            std::cout << "and FabMap training data are computed from BOWs of training images\n";
+            return 0;
+        }
+        cv::FileStorage settings(argv[1], cv::FileStorage::READ);
+        if (!settings.isOpened()) {
+            std::cerr << "Could not open settings file: " << argv[1] << std::endl;
+            return 1;
+        }
+        std::string trainDataPath = settings["FilePaths"]["VocabTrainData"];
+        std::string vocabTreePath = settings["FilePaths"]["VocabularyTree"];
+        int branching = settings["VocabularyTreeOptions"]["Branching"];
+        int depth = settings["VocabularyTreeOptions"]["Depth"];
+        int iterations = settings["VocabularyTreeOptions"]["Iterations"];
+        if (branching < 2) branching = 10;
+        if (depth < 1) depth = 5;
+        if (iterations < 1) iterations = 10;
+
+        cv::FileStorage fs(trainDataPath, cv::FileStorage::READ);
+        cv::Mat descriptors;
+        fs["VocabTrainData"] >> descriptors;
+        if (descriptors.empty()) {
+            std::cerr << trainDataPath << ": Training Data not found" << std::endl;
+            return 1;
+        }
+        fs.release();
+
+        std::cout << "Training vocabulary tree (branching " << branching << ", depth " << depth << ") on "
+                  << descriptors.rows << " descriptors" << std::endl;
+        of2::VocabularyTree vocabTree(branching, depth);
+        vocabTree.train(descriptors, iterations);
+
+        // IDF weights from descriptors of training images
+        if (argc > 2) {
+            fs.open(argv[2], cv::FileStorage::READ);
+            std::vector<cv::Mat> imageDescriptors;
+            fs["ImageDescriptors"] >> imageDescriptors;
+            fs.release();
+            cv::Mat imageBOWs;
+            for (size_t i = 0; i < imageDescriptors.size(); i++) {
+                cv::Mat bow;
+                vocabTree.transform(imageDescriptors[i], bow);
+                imageBOWs.push_back(bow);
+            }
+            if (!imageBOWs.empty())
+                vocabTree.computeWeights(imageBOWs);
+            std::cout << "IDF weights computed from " << imageBOWs.rows << " images" << std::endl;
+
+            // Chow-Liu tree and FabMap training data (loaded by generateFABMAPInstance)
+            std::string chowliutreePath = settings["FilePaths"]["ChowLiuTree"];
+            std::string fabmapTrainDataPath = settings["FilePaths"]["TrainImagDesc"];
+            if (!imageBOWs.empty() && !chowliutreePath.empty() && !fabmapTrainDataPath.empty()) {
+                double infoThreshold = settings["ChowLiuOptions"]["LowerInfoBound"];
+                std::cout << "Training Chow-Liu tree on " << imageBOWs.rows << " images" << std::endl;
+                of2::ChowLiuTree treeBuilder;
+                treeBuilder.add(imageBOWs);
+                cv::Mat clTree = treeBuilder.make(infoThreshold);
+                fs.open(chowliutreePath, cv::FileStorage::WRITE);
+                fs << "ChowLiuTree" << clTree;
+                fs.release();
+                fs.open(fabmapTrainDataPath, cv::FileStorage::WRITE);
+                fs << "BOWImageDescs" << imageBOWs;
+                fs.release();
+                std::cout << "Chow-Liu tree saved to " << chowliutreePath << std::endl;
+            }
+        }
+
+        if (!vocabTree.save(vocabTreePath))
+            return 1;
+        std::cout << "Vocabulary tree saved to " << vocabTreePath << std::endl;
+
+        // quantisation time: tree vs flat vocabulary (linear search over all words)
+        cv::Mat vocabulary = vocabTree.getVocabulary();
+        // binary descriptors stay binary (Hamming distance)
+        cv::Mat descriptorsVocab;
+        if (vocabTree.descriptorType() == CV_8U)
+            descriptorsVocab = descriptors;
+        else
+            descriptors.convertTo(descriptorsVocab, CV_32F);
+        int samplesNo = std::min(descriptorsVocab.rows, 10000);
+        int sameWords = 0;
+        double treeTime = 0, flatTime = 0;
+        for (int i = 0; i < samplesNo; i++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            int treeWord = vocabTree.quantize(descriptorsVocab.row(i));
+            auto middle = std::chrono::high_resolution_clock::now();
+            int flatWord = -1;
+            float bestDist = FLT_MAX;
+            for (int j = 0; j < vocabulary.rows; j++) {
+                float dist = 0;
+                if (vocabulary.type() == CV_8U) {
+                    const uchar* desc = descriptorsVocab.ptr(i);
+                    const uchar* word = vocabulary.ptr(j);
+                    for (int k = 0; k < vocabulary.cols; k++)
+                        dist += (float)__builtin_popcount((unsigned int)(desc[k] ^ word[k]));
+                }
+                else {
+                    const float* desc = descriptorsVocab.ptr<float>(i);
+                    const float* word = vocabulary.ptr<float>(j);
+                    for (int k = 0; k < vocabulary.cols; k++)
+                        dist += (desc[k] - word[k]) * (desc[k] - word[k]);
+                }
+                if (dist < bestDist) {
+                    bestDist = dist;
+                    flatWord = j;
+                }
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            treeTime += std::chrono::duration<double, std::micro>(middle - start).count();
+            flatTime += std::chrono::duration<double, std::micro>(end - middle).count();
+            if (treeWord == flatWord)
+                sameWords++;
+        }
+        std::cout << "Quantisation of " << samplesNo << " descriptors (" << vocabTree.getWordsNo() << " words):\n";
+        std::cout << "vocabulary tree: " << treeTime / samplesNo << " us/descriptor\n";
+        std::cout << "flat vocabulary: " << flatTime / samplesNo << " us/descriptor\n";
+        std::cout << "the same word as the nearest one: " << 100.0 * sameWords / samplesNo << "%\n";
+    }
+    catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
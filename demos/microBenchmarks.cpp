@@ -0,0 +1,530 @@
+/** @file microBenchmarks.cpp
+ *
+ * Microbenchmarks of the core kernels on fixed synthetic inputs (fixed seeds, fixed parameters)
+ * every kernel is run 'repetitions' times after a warm-up run, min, median, mean and max times are printed
+ * and saved to the CSV file, so the results of different commits can be compared
+ *
+ * usage: putslam_microbench [-r repetitions] [-o results.csv] [-f kernelFilter]
+ *
+ */
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <numeric>
+#include <cstdlib>
+
+// LDB declares its interface with unqualified KeyPoint (cv::KeyPoint), so it goes before putslam::KeyPoint
+#include "LDB/ldb.h"
+#include "Defs/putslam_defs.h"
+#include "TransformEst/RANSAC.h"
+#include "TransformEst/kabschEst.h"
+#include "TransformEst/g2oEst.h"
+#include "Matcher/matcherOpenCV.h"
+#include "Matcher/dbscan.h"
+#include "RGBD/RGBD.h"
+#include "PoseGraph/graph_g2o.h"
+
+using namespace putslam;
+
+/// camera parameters
+const double focalU = 525.0, focalV = 525.0, centerU = 320.0, centerV = 240.0;
+/// image size
+const int imageCols = 640, imageRows = 480;
+/// depth image scale
+const double depthImageScale = 5000.0;
+
+/// Result of the benchmark [ms]
+class BenchResult {
+public:
+    /// name of the kernel
+    std::string kernel;
+    /// parameters of the synthetic input
+    std::string params;
+    /// number of measured runs
+    int repetitions;
+    /// statistics of the measured runs [ms]
+    double min, median, mean, max;
+};
+
+/// Benchmark harness
+class MicroBench {
+public:
+    MicroBench(int _repetitions, const std::string& _filter) : repetitions(_repetitions), filter(_filter) {
+    }
+
+    /// run the kernel (returns time of the measured part [ms]) after a warm-up run
+    void run(const std::string& kernel, const std::string& params, const std::function<double()>& kernelRun) {
+        if (!filter.empty() && kernel.find(filter) == std::string::npos)
+            return;
+        kernelRun();
+        std::vector<double> times;
+        for (int i = 0; i < repetitions; i++)
+            times.push_back(kernelRun());
+        std::sort(times.begin(), times.end());
+        BenchResult result;
+        result.kernel = kernel;
+        result.params = params;
+        result.repetitions = repetitions;
+        result.min = times.front();
+        result.max = times.back();
+        result.median = (times.size() % 2) ? times[times.size() / 2]
+                : 0.5 * (times[times.size() / 2 - 1] + times[times.size() / 2]);
+        result.mean = std::accumulate(times.begin(), times.end(), 0.0) / (double) times.size();
+        std::cout << std::left << std::setw(28) << kernel << std::setw(28) << params << std::right << std::fixed
+                << std::setprecision(4) << std::setw(12) << result.min << std::setw(12) << result.median
+                << std::setw(12) << result.mean << std::setw(12) << result.max << "\n";
+        results.push_back(result);
+    }
+
+    /// save results to the CSV file
+    bool saveCSV(const std::string& filename) const {
+        std::ofstream file(filename);
+        if (!file.is_open()) {
+            std::cerr << "putslam_microbench: unable to open " << filename << "\n";
+            return false;
+        }
+        file << "kernel,params,repetitions,min_ms,median_ms,mean_ms,max_ms\n";
+        for (auto& result : results)
+            file << result.kernel << "," << result.params << "," << result.repetitions << "," << result.min << ","
+                    << result.median << "," << result.mean << "," << result.max << "\n";
+        return true;
+    }
+
+private:
+    /// number of measured runs
+    int repetitions;
+    /// only kernels which contain the filter are run
+    std::string filter;
+    /// results
+    std::vector<BenchResult> results;
+};
+
+/// Stopwatch [ms] with sub-millisecond resolution
+class Timer {
+public:
+    Timer() : start(std::chrono::high_resolution_clock::now()) {
+    }
+    double elapsed() const {
+        return (double) std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::high_resolution_clock::now() - start).count() / 1e6;
+    }
+private:
+    std::chrono::high_resolution_clock::time_point start;
+};
+
+/// camera matrix (CV_32F)
+cv::Mat cameraMatrix(void) {
+    cv::Mat camera = cv::Mat::zeros(3, 3, CV_32FC1);
+    camera.at<float>(0, 0) = (float) focalU;
+    camera.at<float>(1, 1) = (float) focalV;
+    camera.at<float>(0, 2) = (float) centerU;
+    camera.at<float>(1, 2) = (float) centerV;
+    camera.at<float>(2, 2) = 1.0f;
+    return camera;
+}
+
+/// fixed transformation between frames
+Eigen::Matrix4f frameTransformation(void) {
+    Eigen::Matrix4f transformation(Eigen::Matrix4f::Identity());
+    transformation.block<3, 3>(0, 0) = Eigen::AngleAxisf(0.08f, Eigen::Vector3f(0.3f, 1.0f, 0.2f).normalized()).toRotationMatrix();
+    transformation.block<3, 1>(0, 3) = Eigen::Vector3f(0.05f, -0.02f, 0.1f);
+    return transformation;
+}
+
+/// random point in the field of view of the camera
+Eigen::Vector3f randomPoint(std::mt19937& generator) {
+    std::uniform_real_distribution<float> depth(1.0f, 4.0f), image(-0.5f, 0.5f);
+    float z = depth(generator);
+    return Eigen::Vector3f(image(generator) * z * (float) (imageCols / focalU),
+            image(generator) * z * (float) (imageRows / focalV), z);
+}
+
+/// random binary descriptors (ORB size)
+cv::Mat randomDescriptors(int descriptorsNo, std::mt19937& generator) {
+    std::uniform_int_distribution<int> byte(0, 255);
+    cv::Mat descriptors(descriptorsNo, 32, CV_8UC1);
+    for (int i = 0; i < descriptorsNo; i++)
+        for (int j = 0; j < 32; j++)
+            descriptors.at<uchar>(i, j) = (uchar) byte(generator);
+    return descriptors;
+}
+
+/// projection of the point onto the image
+cv::Point2f project(const Eigen::Vector3f& point) {
+    return cv::Point2f((float) (focalU * point.x() / point.z() + centerU), (float) (focalV * point.y() / point.z() + centerV));
+}
+
+/// RANSAC::estimateTransformation (Euclidean error) on matches with the given inlier ratio
+void benchRANSAC(MicroBench& bench, int matchesNo, double inlierRatio) {
+    std::mt19937 generator(1);
+    std::normal_distribution<float> noise(0.0f, 0.002f);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    Eigen::Matrix4f transformation = frameTransformation();
+    std::vector<Eigen::Vector3f> prevFeatures, features;
+    std::vector<cv::DMatch> matches;
+    for (int i = 0; i < matchesNo; i++) {
+        prevFeatures.push_back(randomPoint(generator));
+        if (uniform(generator) < inlierRatio)
+            features.push_back(transformation.block<3, 3>(0, 0) * prevFeatures.back() + transformation.block<3, 1>(0, 3)
+                    + Eigen::Vector3f(noise(generator), noise(generator), noise(generator)));
+        else
+            features.push_back(randomPoint(generator));
+        matches.push_back(cv::DMatch(i, i, 0.0f));
+    }
+    RANSAC::parameters params;
+    params.verbose = 0;
+    params.errorVersion = params.errorVersionVO = params.errorVersionMap = RANSAC::EUCLIDEAN_ERROR;
+    params.inlierThresholdEuclidean = 0.04;
+    params.inlierThresholdReprojection = 2.0;
+    params.inlierThresholdMahalanobis = 0.0002;
+    params.minimalInlierRatioThreshold = 0.2;
+    params.minimalNumberOfMatches = 15;
+    params.usedPairs = 3;
+    params.iterationCount = 0;
+    RANSAC ransac(params, cameraMatrix());
+    bench.run("RANSAC::estimateTransformation",
+            "matches=" + std::to_string(matchesNo) + " inliers=" + std::to_string((int) (inlierRatio * 100)) + "%", [&]() {
+                // RANSAC seeds rand() with time in the constructor
+                srand(1);
+                std::vector<cv::DMatch> inliers;
+                Timer timer;
+                ransac.estimateTransformation(prevFeatures, features, matches, inliers);
+                return timer.elapsed();
+            });
+}
+
+/// Matcher with the current frame set directly (without detection and description)
+class BenchMatcher : public MatcherOpenCV {
+public:
+    BenchMatcher(const std::string& parametersFile, const std::string& grabberParametersFile) :
+            MatcherOpenCV(parametersFile, grabberParametersFile) {
+    }
+
+    /// set features of the current frame
+    void setFrame(const std::vector<Eigen::Vector3f>& features3D, const cv::Mat& descriptors) {
+        prevFeatures3D = features3D;
+        prevDescriptors = descriptors;
+        prevKeyPoints.clear();
+        prevDetDists.clear();
+        prevFeaturesUndistorted.clear();
+        for (auto& feature : features3D) {
+            prevFeaturesUndistorted.push_back(project(feature));
+            prevKeyPoints.push_back(cv::KeyPoint(prevFeaturesUndistorted.back(), 31.0f, -1.0f, 0.0f, 0));
+            prevDetDists.push_back(feature.norm());
+        }
+        prevFeaturesDistorted = prevFeaturesUndistorted;
+    }
+};
+
+/// Matcher::matchXYZ: current frame against the map of the given size (map features in the current camera frame)
+void benchMatchXYZ(MicroBench& bench, int mapSize, int frameSize) {
+    std::mt19937 generator(2);
+    std::normal_distribution<float> noise(0.0f, 0.005f);
+    std::uniform_int_distribution<int> bit(0, 255);
+    BenchMatcher matcher("putslammatcherOpenCVParameters.xml", "putslamfileModel.xml");
+    // fixed parameters (independent of the resources)
+    matcher.matcherParameters.verbose = 0;
+    matcher.matcherParameters.OpenCVParams.descriptor = "ORB";
+    matcher.matcherParameters.OpenCVParams.matchingXYZSphereRadius = 0.12;
+    matcher.matcherParameters.OpenCVParams.matchingXYZacceptRatioOfBestMatch = 0.55;
+    matcher.matcherParameters.RANSACParams.verbose = 0;
+    matcher.matcherParameters.RANSACParams.errorVersionMap = RANSAC::EUCLIDEAN_ERROR;
+    matcher.matcherParameters.RANSACParams.inlierThresholdEuclidean = 0.04;
+    matcher.matcherParameters.RANSACParams.minimalInlierRatioThreshold = 0.2;
+    matcher.matcherParameters.RANSACParams.minimalNumberOfMatches = 15;
+    matcher.matcherParameters.RANSACParams.usedPairs = 3;
+    matcher.matcherParameters.cameraMatrixMat = cameraMatrix();
+    matcher.matcherParameters.distortionCoeffsMat = cv::Mat::zeros(1, 5, CV_32FC1);
+
+    cv::Mat mapDescriptors = randomDescriptors(mapSize, generator);
+    std::vector<MapFeature> mapFeatures;
+    for (int i = 0; i < mapSize; i++) {
+        Eigen::Vector3f point = randomPoint(generator);
+        MapFeature feature(i);
+        feature.position = Vec3(point.x(), point.y(), point.z());
+        cv::Point2f point2D = project(point);
+        feature.descriptors[0] = ExtendedDescriptor(point2D, point2D, feature.position, mapDescriptors.row(i).clone(), 0,
+                point.norm());
+        mapFeatures.push_back(feature);
+    }
+    // the first features of the map are observed in the current frame (noisy positions, a few flipped bits)
+    std::vector<Eigen::Vector3f> features3D;
+    cv::Mat descriptors(frameSize, 32, CV_8UC1);
+    for (int i = 0; i < frameSize; i++) {
+        features3D.push_back(mapFeatures[i].position.vector().cast<float>()
+                + Eigen::Vector3f(noise(generator), noise(generator), noise(generator)));
+        mapDescriptors.row(i).copyTo(descriptors.row(i));
+        for (int j = 0; j < 8; j++)
+            descriptors.at<uchar>(i, bit(generator) % 32) ^= (uchar) (1 << (bit(generator) % 8));
+    }
+    bench.run("Matcher::matchXYZ", "map=" + std::to_string(mapSize) + " frame=" + std::to_string(frameSize), [&]() {
+        matcher.setFrame(features3D, descriptors);
+        std::vector<MapFeature> found;
+        Eigen::Matrix4f transformation;
+        Timer timer;
+        matcher.matchXYZ(mapFeatures, 0, found, transformation, false);
+        return timer.elapsed();
+    });
+}
+
+/// depth image of the slanted plane
+cv::Mat planeDepthImage(void) {
+    cv::Mat depth(imageRows, imageCols, CV_16UC1);
+    for (int v = 0; v < imageRows; v++)
+        for (int u = 0; u < imageCols; u++)
+            depth.at<uint16_t>(v, u) = (uint16_t) ((2.0 + 0.5 * u / imageCols + 0.3 * v / imageRows) * depthImageScale);
+    return depth;
+}
+
+/// RGBD::computeNormals and RGBD::keypoints2Dto3D
+void benchRGBD(MicroBench& bench, int featuresNo) {
+    std::mt19937 generator(3);
+    std::uniform_real_distribution<float> u(10.0f, (float) imageCols - 10.0f), v(10.0f, (float) imageRows - 10.0f);
+    cv::Mat depth = planeDepthImage(), camera = cameraMatrix();
+    std::vector<cv::Point2f> points;
+    std::vector<RGBDFeature> features(featuresNo);
+    for (auto& feature : features) {
+        points.push_back(cv::Point2f(u(generator), v(generator)));
+        feature.u = points.back().x;
+        feature.v = points.back().y;
+    }
+    bench.run("RGBD::computeNormals", "features=" + std::to_string(featuresNo), [&]() {
+        Timer timer;
+        RGBD::computeNormals(depth, features, camera, depthImageScale);
+        return timer.elapsed();
+    });
+    bench.run("RGBD::keypoints2Dto3D", "features=" + std::to_string(featuresNo), [&]() {
+        Timer timer;
+        std::vector<Eigen::Vector3f> points3D = RGBD::keypoints2Dto3D(points, depth, camera, depthImageScale);
+        return timer.elapsed();
+    });
+}
+
+/// KabschEst and G2OEst on corresponding point sets
+void benchTransformEst(MicroBench& bench, int pointsNo) {
+    std::mt19937 generator(4);
+    std::normal_distribution<double> noise(0.0, 0.002);
+    Eigen::Matrix4d transformation = frameTransformation().cast<double>();
+    Eigen::MatrixXd setA(pointsNo, 3), setB(pointsNo, 3);
+    for (int i = 0; i < pointsNo; i++) {
+        Eigen::Vector3d point = randomPoint(generator).cast<double>();
+        setA.row(i) = point.transpose();
+        setB.row(i) = (transformation.block<3, 3>(0, 0) * point + transformation.block<3, 1>(0, 3)
+                + Eigen::Vector3d(noise(generator), noise(generator), noise(generator))).transpose();
+    }
+    KabschEst kabsch;
+    bench.run("KabschEst", "points=" + std::to_string(pointsNo), [&]() {
+        Timer timer;
+        kabsch.computeTransformation(setA, setB);
+        return timer.elapsed();
+    });
+    G2OEst g2oEst;
+    bench.run("G2OEst", "points=" + std::to_string(pointsNo), [&]() {
+        Timer timer;
+        g2oEst.computeTransformation(setA, setB);
+        return timer.elapsed();
+    });
+}
+
+/// create synthetic graph (camera moving along x axis, features on the wall in front of the camera)
+void createGraph(PoseGraphG2O& graph, int posesNo, int featuresNo) {
+    std::mt19937 generator(5);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    std::vector<Eigen::Vector3d> features;
+    for (int i = 0; i < featuresNo; i++)
+        features.push_back(Eigen::Vector3d(0.1 * posesNo * (double) i / featuresNo - 1.0, 2.0 * (double) (i % 11) / 11.0 - 1.0,
+                3.0 + 0.5 * (double) (i % 5) / 5.0));
+    for (int poseNo = 0; poseNo < posesNo; poseNo++) {
+        Mat34 pose(Mat34::Identity());
+        pose(0, 3) = 0.1 * poseNo;
+        if (poseNo > 0) {
+            pose(0, 3) += 0.01 * noise(generator);
+            pose(1, 3) += 0.01 * noise(generator);
+        }
+        graph.addVertexPose(VertexSE3(poseNo, pose));
+        if (poseNo > 0) {
+            Mat34 odometry(Mat34::Identity());
+            odometry(0, 3) = 0.1;
+            graph.addEdgeSE3(EdgeSE3(odometry, Mat66::Identity() * 10.0, poseNo - 1, poseNo));
+        }
+    }
+    for (int i = 0; i < featuresNo; i++) {
+        Eigen::Vector3d featureInit = features[i] + 0.01 * Eigen::Vector3d(noise(generator), noise(generator), noise(generator));
+        graph.addVertexFeature(Vertex3D(posesNo + i, Vec3(featureInit)));
+        for (int poseNo = 0; poseNo < posesNo; poseNo++) {
+            Eigen::Vector3d pointCam = features[i] - Eigen::Vector3d(0.1 * poseNo, 0, 0);
+            double u = focalU * pointCam.x() / pointCam.z() + centerU, v = focalV * pointCam.y() / pointCam.z() + centerV;
+            if (u < 0 || u > 2 * centerU || v < 0 || v > 2 * centerV)
+                continue;
+            graph.addEdge3D(Edge3D(Vec3(pointCam + 0.005 * Eigen::Vector3d(noise(generator), noise(generator), noise(generator))),
+                    Mat33::Identity() * 1e4, poseNo, posesNo + i));
+        }
+    }
+}
+
+/// PoseGraphG2O::optimize on the synthetic graph (graph creation is not measured)
+void benchPoseGraph(MicroBench& bench, int posesNo, int featuresNo, int iterNo) {
+    bench.run("PoseGraphG2O::optimize", "poses=" + std::to_string(posesNo) + " features=" + std::to_string(featuresNo)
+            + " iter=" + std::to_string(iterNo), [&]() {
+        PoseGraphG2O graph;
+        graph.setCameraParameters(focalU, focalV, centerU, centerV);
+        createGraph(graph, posesNo, featuresNo);
+        Timer timer;
+        graph.optimize(iterNo, 0);
+        return timer.elapsed();
+    });
+}
+
+/// PoseGraphG2O::optimize called after every new pose (as in the frontend), time of the call after the last pose
+void benchPoseGraphSequence(MicroBench& bench, int posesNo, int featuresNo, int iterNo, bool incremental) {
+    bench.run("PoseGraphG2O::optimize step", "poses=" + std::to_string(posesNo) + " features=" + std::to_string(featuresNo)
+            + " incremental=" + std::to_string(incremental), [&]() {
+        PoseGraphG2O graph;
+        graph.setCameraParameters(focalU, focalV, centerU, centerV);
+        graph.setIncrementalOptimization(incremental, 3, 0.01, 0);
+        std::mt19937 generator(5);
+        std::normal_distribution<double> noise(0.0, 1.0);
+        std::vector<Eigen::Vector3d> features;
+        for (int i = 0; i < featuresNo; i++)
+            features.push_back(Eigen::Vector3d(0.1 * posesNo * (double) i / featuresNo - 1.0, 2.0 * (double) (i % 11) / 11.0 - 1.0,
+                    3.0 + 0.5 * (double) (i % 5) / 5.0));
+        std::vector<bool> featureAdded(features.size(), false);
+        double stepTime = 0;
+        for (int poseNo = 0; poseNo < posesNo; poseNo++) {
+            Mat34 pose(Mat34::Identity());
+            pose(0, 3) = 0.1 * poseNo;
+            if (poseNo > 0) {
+                pose(0, 3) += 0.01 * noise(generator);
+                pose(1, 3) += 0.01 * noise(generator);
+            }
+            graph.addVertexPose(VertexSE3(poseNo, pose));
+            if (poseNo > 0) {
+                Mat34 odometry(Mat34::Identity());
+                odometry(0, 3) = 0.1;
+                graph.addEdgeSE3(EdgeSE3(odometry, Mat66::Identity() * 10.0, poseNo - 1, poseNo));
+            }
+            for (int i = 0; i < featuresNo; i++) {
+                Eigen::Vector3d pointCam = features[i] - Eigen::Vector3d(0.1 * poseNo, 0, 0);
+                double u = focalU * pointCam.x() / pointCam.z() + centerU, v = focalV * pointCam.y() / pointCam.z() + centerV;
+                if (u < 0 || u > 2 * centerU || v < 0 || v > 2 * centerV)
+                    continue;
+                if (!featureAdded[i]) {
+                    Eigen::Vector3d featureInit = features[i] + 0.01 * Eigen::Vector3d(noise(generator), noise(generator), noise(generator));
+                    graph.addVertexFeature(Vertex3D(posesNo + i, Vec3(featureInit)));
+                    featureAdded[i] = true;
+                }
+                graph.addEdge3D(Edge3D(Vec3(pointCam + 0.005 * Eigen::Vector3d(noise(generator), noise(generator), noise(generator))),
+                        Mat33::Identity() * 1e4, poseNo, posesNo + i));
+            }
+            Timer timer;
+            graph.optimize(iterNo, 0);
+            stepTime = timer.elapsed();
+        }
+        return stepTime;
+    });
+}
+
+/// DBScan::run on clustered keypoints
+void benchDBScan(MicroBench& bench, int keypointsNo) {
+    std::mt19937 generator(6);
+    std::uniform_real_distribution<float> u(0.0f, (float) imageCols), v(0.0f, (float) imageRows);
+    std::normal_distribution<float> noise(0.0f, 5.0f);
+    std::vector<cv::Point2f> centers;
+    for (int i = 0; i < 50; i++)
+        centers.push_back(cv::Point2f(u(generator), v(generator)));
+    std::vector<cv::KeyPoint> keypoints;
+    for (int i = 0; i < keypointsNo; i++) {
+        const cv::Point2f& center = centers[(size_t) i % centers.size()];
+        keypoints.push_back(cv::KeyPoint(center.x + noise(generator), center.y + noise(generator), 7.0f, -1.0f,
+                (float) (i % 100)));
+    }
+    bench.run("DBScan::run", "keypoints=" + std::to_string(keypointsNo), [&]() {
+        std::vector<cv::KeyPoint> clusteringSet(keypoints);
+        DBScan dbscan(10, 2, 1);
+        Timer timer;
+        dbscan.run(clusteringSet);
+        return timer.elapsed();
+    });
+}
+
+/// LDB::compute on the textured image
+void benchLDB(MicroBench& bench, int keypointsNo, bool rotated) {
+    std::mt19937 generator(7);
+    std::uniform_int_distribution<int> intensity(0, 255);
+    std::uniform_real_distribution<float> u(40.0f, (float) imageCols - 40.0f), v(40.0f, (float) imageRows - 40.0f),
+            angle(0.0f, 360.0f);
+    cv::Mat noiseImage(imageRows, imageCols, CV_8UC1), image;
+    for (int row = 0; row < imageRows; row++)
+        for (int col = 0; col < imageCols; col++)
+            noiseImage.at<uchar>(row, col) = (uchar) intensity(generator);
+    cv::GaussianBlur(noiseImage, image, cv::Size(5, 5), 1.5);
+    std::vector<cv::KeyPoint> keypoints;
+    for (int i = 0; i < keypointsNo; i++)
+        keypoints.push_back(cv::KeyPoint(u(generator), v(generator), 31.0f, angle(generator)));
+    LDB ldb;
+    bench.run("LDB::compute", "keypoints=" + std::to_string(keypointsNo) + " rotated=" + std::to_string(rotated), [&]() {
+        std::vector<cv::KeyPoint> describedKeypoints(keypoints);
+        cv::Mat descriptors;
+        Timer timer;
+        ldb.compute(image, describedKeypoints, descriptors, rotated);
+        return timer.elapsed();
+    });
+}
+
+int main(int argc, char* argv[]) {
+    int repetitions = 10;
+    std::string resultsFile("microBenchmarks.csv"), filter;
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if ((arg == "-r" || arg == "-o" || arg == "-f") && i + 1 < argc) {
+            std::string value(argv[++i]);
+            if (arg == "-r")
+                repetitions = std::max(atoi(value.c_str()), 1);
+            else if (arg == "-o")
+                resultsFile = value;
+            else
+                filter = value;
+        }
+        else {
+            std::cout << "usage: putslam_microbench [-r repetitions] [-o results.csv] [-f kernelFilter]\n";
+            return 1;
+        }
+    }
+
+    try {
+        MicroBench bench(repetitions, filter);
+        std::cout << std::left << std::setw(28) << "kernel" << std::setw(28) << "params" << std::right << std::setw(12)
+                << "min [ms]" << std::setw(12) << "median [ms]" << std::setw(12) << "mean [ms]" << std::setw(12)
+                << "max [ms]" << "\n";
+        for (double inlierRatio : { 0.3, 0.5, 0.8 })
+            benchRANSAC(bench, 500, inlierRatio);
+        for (int mapSize : { 1000, 4000, 16000 })
+            benchMatchXYZ(bench, mapSize, 500);
+        for (int featuresNo : { 500, 2000 })
+            benchRGBD(bench, featuresNo);
+        for (int pointsNo : { 100, 1000, 10000 })
+            benchTransformEst(bench, pointsNo);
+        benchPoseGraph(bench, 50, 500, 10);
+        benchPoseGraph(bench, 200, 2000, 10);
+        for (bool incremental : { false, true })
+            benchPoseGraphSequence(bench, 100, 1000, 3, incremental);
+        for (int keypointsNo : { 500, 2000 })
+            benchDBScan(bench, keypointsNo);
+        for (bool rotated : { false, true })
+            benchLDB(bench, 500, rotated);
+        if (!bench.saveCSV(resultsFile))
+            return 1;
+        std::cout << "putslam_microbench: results saved to " << resultsFile << "\n";
+    }
+    catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
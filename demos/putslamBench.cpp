@@ -0,0 +1,279 @@
+/** @file putslamBench.cpp
+ *
+ * Headless benchmark of PUTSLAM over dataset configs (e.g. configs/PUTSLAM_*)
+ * every config is processed in a separate process (optionally several in parallel) without windows and console output,
+ * FPS, latency percentiles of stages, peak RSS, ATE and RPE of all runs are saved in one JSON summary
+ *
+ * usage: putslam_bench [-j jobs] [-o summary.json] [-r resourcesDir] [-w workDir] [-l configsList] configDir...
+ *
+ */
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <iterator>
+#include <cstdlib>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "PUTSLAM/PUTSLAM.h"
+#include "Utilities/profiler.h"
+
+/// Benchmark settings
+class BenchConfig {
+public:
+    BenchConfig() : jobs(1), summaryFile("putslamBench.json"), resourcesDir("../../resources"),
+        workDir("../../results/bench") {
+    }
+    /// max number of configs processed in parallel
+    int jobs;
+    /// output summary (JSON)
+    std::string summaryFile;
+    /// default resources (overwritten by files of the config)
+    std::string resourcesDir;
+    /// results of the config are stored in workDir/configName
+    std::string workDir;
+    /// dataset configs
+    std::vector<std::string> configs;
+};
+
+/// Single run of PUTSLAM
+class BenchRun {
+public:
+    BenchRun(const std::string& _config, const std::string& _name) : config(_config), name(_name), pid(-1), exitCode(-1) {
+    }
+    /// config directory
+    std::string config;
+    /// config name
+    std::string name;
+    /// process id
+    pid_t pid;
+    /// exit code of the process (-1 - not finished, killed)
+    int exitCode;
+};
+
+/// last component of the path
+std::string baseName(std::string path) {
+    while (path.size() > 1 && path.back() == '/')
+        path.pop_back();
+    size_t pos = path.find_last_of('/');
+    return (pos == std::string::npos) ? path : path.substr(pos + 1);
+}
+
+/// read the value of the key from the file of "key value" lines (VOAte.res, VORpe.res, ...)
+bool readValue(const std::string& filename, const std::string& key, double& value) {
+    std::ifstream file(filename);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream lineStream(line);
+        std::string lineKey;
+        if ((lineStream >> lineKey) && lineKey == key)
+            return bool(lineStream >> value);
+    }
+    return false;
+}
+
+/// write value or null
+void writeValue(std::ostream& os, bool valid, double value) {
+    if (valid)
+        os << value;
+    else
+        os << "null";
+}
+
+/// ATE and RPE of the trajectory (files saved by PUTSLAM::evaluateResults), results are written as JSON fields
+void writeAccuracy(const std::string& prefix, std::ostream& json) {
+    double ate = 0, rpeTrans = 0, rpeRot = 0;
+    bool ateValid = readValue(prefix + "Ate.res", "absolute_translational_error.rmse", ate);
+    bool rpeValid = readValue(prefix + "Rpe.res", "translational_error.rmse", rpeTrans)
+            && readValue(prefix + "Rpe.res", "rotational_error.rmse", rpeRot);
+    json << "\"" << prefix << "\":{\"ate_rmse_m\":";
+    writeValue(json, ateValid, ate);
+    json << ",\"rpe_trans_rmse_m\":";
+    writeValue(json, rpeValid, rpeTrans);
+    json << ",\"rpe_rot_rmse_deg\":";
+    writeValue(json, rpeValid, rpeRot);
+    json << "}";
+}
+
+/// process the config (child process, working directory contains results), returns exit code
+int processConfig(const BenchRun& run) {
+    // console output of PUTSLAM goes to the log
+    if (freopen("putslam.log", "w", stdout) == nullptr)
+        return 1;
+    dup2(fileno(stdout), fileno(stderr));
+
+    auto start = std::chrono::steady_clock::now();
+    try {
+        std::unique_ptr<PUTSLAM> putslam(new PUTSLAM);
+        putslam->setHeadless();
+        Profiler::get().setEnabled(true);
+        putslam->startProcessing();
+    }
+    catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    double wallTime = (double) std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count() / 1000.0;
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    double fps = 0;
+    std::ifstream fpsFile("fps.res");
+    bool fpsValid = bool(fpsFile >> fps);
+
+    std::ofstream json("bench.json");
+    json << "{\"config\":\"" << run.name << "\",\"status\":\"ok\",\"fps\":";
+    writeValue(json, fpsValid, fps);
+    json << ",\"wall_time_s\":" << wallTime << ",\"peak_rss_mb\":" << (double) usage.ru_maxrss / 1024.0 << ",";
+
+    writeAccuracy("VO", json);
+    json << ",";
+    writeAccuracy("g2o", json);
+
+    json << ",\"stages\":[";
+    bool first = true;
+    for (auto& stats : Profiler::get().getStats()) {
+        json << (first ? "" : ",") << "{\"name\":\"" << stats.name << "\",\"count\":" << stats.count
+                << ",\"mean_ms\":" << stats.mean / 1000.0 << ",\"p50_ms\":" << stats.p50 / 1000.0
+                << ",\"p95_ms\":" << stats.p95 / 1000.0 << ",\"p99_ms\":" << stats.p99 / 1000.0
+                << ",\"max_ms\":" << stats.max / 1000.0 << "}";
+        first = false;
+    }
+    json << "]}";
+    json.close();
+    return 0;
+}
+
+/// prepare resources and working directory of the run (the same layout as the repository: resources, build/bin)
+bool prepareRun(const BenchConfig& bench, const BenchRun& run, std::string& runDir) {
+    std::string configDir = bench.workDir + "/" + run.name;
+    runDir = configDir + "/build/bin";
+    std::string prepare = "rm -rf '" + configDir + "' && mkdir -p '" + configDir + "/resources' '" + runDir
+            + "' && cp -r '" + bench.resourcesDir + "'/* '" + configDir + "/resources/' && cp -r '" + run.config
+            + "'/* '" + configDir + "/resources/'";
+    if (std::system(prepare.c_str()) != 0) {
+        std::cerr << "putslam_bench: unable to prepare " << configDir << "\n";
+        return false;
+    }
+    return true;
+}
+
+/// start processing of the config in the child process
+bool startRun(const BenchConfig& bench, BenchRun& run) {
+    std::string runDir;
+    if (!prepareRun(bench, run, runDir))
+        return false;
+    std::cout.flush();
+    run.pid = fork();
+    if (run.pid < 0) {
+        std::cerr << "putslam_bench: unable to start process for " << run.name << "\n";
+        return false;
+    }
+    if (run.pid == 0) {
+        int exitCode = (chdir(runDir.c_str()) == 0) ? processConfig(run) : 1;
+        fflush(stdout);
+        // threads of PUTSLAM are not joined in every configuration
+        _exit(exitCode);
+    }
+    return true;
+}
+
+/// load settings from the command line
+bool parseArguments(int argc, char* argv[], BenchConfig& bench) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if ((arg == "-j" || arg == "-o" || arg == "-r" || arg == "-w" || arg == "-l") && i + 1 < argc) {
+            std::string value(argv[++i]);
+            if (arg == "-j")
+                bench.jobs = std::max(atoi(value.c_str()), 1);
+            else if (arg == "-o")
+                bench.summaryFile = value;
+            else if (arg == "-r")
+                bench.resourcesDir = value;
+            else if (arg == "-w")
+                bench.workDir = value;
+            else {
+                std::ifstream list(value);
+                if (!list.is_open()) {
+                    std::cerr << "putslam_bench: unable to open " << value << "\n";
+                    return false;
+                }
+                std::string config;
+                while (std::getline(list, config)) {
+                    if (!config.empty() && config[0] != '#')
+                        bench.configs.push_back(config);
+                }
+            }
+        }
+        else if (arg[0] == '-')
+            return false;
+        else
+            bench.configs.push_back(arg);
+    }
+    return !bench.configs.empty();
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig bench;
+    if (!parseArguments(argc, argv, bench)) {
+        std::cout << "usage: putslam_bench [-j jobs] [-o summary.json] [-r resourcesDir] [-w workDir] [-l configsList] configDir...\n";
+        return 1;
+    }
+    std::vector<BenchRun> runs;
+    for (auto& config : bench.configs)
+        runs.push_back(BenchRun(config, baseName(config)));
+
+    size_t nextRun = 0;
+    int running = 0;
+    while (nextRun < runs.size() || running > 0) {
+        while (nextRun < runs.size() && running < bench.jobs) {
+            std::cout << "putslam_bench: processing " << runs[nextRun].name << "\n";
+            if (startRun(bench, runs[nextRun]))
+                running++;
+            nextRun++;
+        }
+        if (running == 0)
+            continue;
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0)
+            break;
+        for (auto& run : runs) {
+            if (run.pid == pid) {
+                run.exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+                std::cout << "putslam_bench: " << run.name << (run.exitCode == 0 ? " finished\n" : " failed\n");
+                running--;
+            }
+        }
+    }
+
+    std::ofstream summary(bench.summaryFile);
+    if (!summary.is_open()) {
+        std::cerr << "putslam_bench: unable to open " << bench.summaryFile << "\n";
+        return 1;
+    }
+    int failedNo = 0;
+    summary << "{\"runs\":[\n";
+    for (size_t i = 0; i < runs.size(); i++) {
+        std::ifstream runSummary(bench.workDir + "/" + runs[i].name + "/build/bin/bench.json");
+        std::string runJson((std::istreambuf_iterator<char>(runSummary)), std::istreambuf_iterator<char>());
+        if (runs[i].exitCode != 0 || runJson.empty()) {
+            runJson = "{\"config\":\"" + runs[i].name + "\",\"status\":\"failed\",\"exit_code\":"
+                    + std::to_string(runs[i].exitCode) + "}";
+            failedNo++;
+        }
+        summary << runJson << ((i + 1 < runs.size()) ? ",\n" : "\n");
+    }
+    summary << "]}\n";
+    summary.close();
+    std::cout << "putslam_bench: " << runs.size() - failedNo << "/" << runs.size() << " configs processed, summary saved to "
+            << bench.summaryFile << "\n";
+    return (failedNo > 0) ? 1 : 0;
+}
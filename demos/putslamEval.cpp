@@ -0,0 +1,97 @@
+/** @file putslamEval.cpp
+ *
+ * Trajectory accuracy (ATE and RPE) -- replacement of evaluate_ate.py and evaluate_rpe.py
+ *
+ * usage: putslam_eval groundtruth.txt estimated.txt [--max_difference 0.02] [--offset 0] [--scale 1]
+ *        [--delta 1] [--delta_unit s|m|rad|f] [--fixed_delta] [--max_pairs 10000] [--threads 0]
+ *        [--save_associations file] [--ate_only] [--rpe_only]
+ *
+ */
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include "Utilities/trajectoryEvaluation.h"
+
+using namespace putslam;
+
+int main(int argc, char* argv[]) {
+    TrajectoryEvaluator::Config config;
+    std::vector<std::string> files;
+    std::string associationsFile;
+    bool ate = true, rpe = true;
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "--fixed_delta")
+            config.fixedDelta = true;
+        else if (arg == "--ate_only")
+            rpe = false;
+        else if (arg == "--rpe_only")
+            ate = false;
+        else if (arg.compare(0, 2, "--") == 0 && i + 1 < argc) {
+            std::string value(argv[++i]);
+            if (arg == "--max_difference")
+                config.maxDifference = atof(value.c_str());
+            else if (arg == "--offset")
+                config.offset = atof(value.c_str());
+            else if (arg == "--scale")
+                config.scale = atof(value.c_str());
+            else if (arg == "--delta")
+                config.delta = atof(value.c_str());
+            else if (arg == "--delta_unit")
+                config.deltaUnit = value[0];
+            else if (arg == "--max_pairs")
+                config.maxPairs = (size_t) atol(value.c_str());
+            else if (arg == "--threads")
+                config.threadsNo = atoi(value.c_str());
+            else if (arg == "--save_associations")
+                associationsFile = value;
+            else {
+                std::cerr << "putslam_eval: unknown option " << arg << "\n";
+                return 1;
+            }
+        }
+        else
+            files.push_back(arg);
+    }
+    if (files.size() != 2) {
+        std::cout << "usage: putslam_eval groundtruth.txt estimated.txt [--max_difference 0.02] [--offset 0] [--scale 1] "
+                "[--delta 1] [--delta_unit s|m|rad|f] [--fixed_delta] [--max_pairs 10000] [--threads 0] "
+                "[--save_associations file] [--ate_only] [--rpe_only]\n";
+        return 1;
+    }
+
+    TrajectoryEvaluator::Trajectory groundtruth, estimated;
+    if (!TrajectoryEvaluator::loadTrajectory(files[0], groundtruth) || !TrajectoryEvaluator::loadTrajectory(files[1], estimated))
+        return 1;
+
+    TrajectoryEvaluator evaluator(config);
+    bool success = true;
+    if (ate) {
+        TrajectoryEvaluator::ATEResult ateResult;
+        if (evaluator.computeATE(groundtruth, estimated, ateResult)) {
+            TrajectoryEvaluator::printATE(std::cout, ateResult);
+            if (!associationsFile.empty()) {
+                // format of evaluate_ate.py: stamp1 x1 y1 z1 stamp2 x2 y2 z2 (second trajectory aligned)
+                std::ofstream file(associationsFile);
+                for (auto& association : ateResult.associations) {
+                    const TrajectoryEvaluator::StampedPose& first = groundtruth[association.first];
+                    const TrajectoryEvaluator::StampedPose& second = estimated[association.second];
+                    Eigen::Vector3d aligned = ateResult.alignment * (second.pose.translation() * config.scale);
+                    file << std::fixed << first.timestamp << " " << first.pose.translation().transpose() << " "
+                            << second.timestamp << " " << aligned.transpose() << "\n";
+                }
+            }
+        }
+        else
+            success = false;
+    }
+    if (rpe) {
+        TrajectoryEvaluator::RPEResult rpeResult;
+        if (evaluator.computeRPE(groundtruth, estimated, rpeResult))
+            TrajectoryEvaluator::printRPE(std::cout, rpeResult);
+        else
+            success = false;
+    }
+    return success ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+/** @file putslamReplay.cpp
+ *
+ * Replays the log of frontend calls (recorded by FeaturesMap, see <recording> in the map config) to the map
+ * back-end experiments (solvers, map management, LC) without detection, matching and RANSAC,
+ * the map and its threads are configured by putslamconfigGlobal.xml (Map, Grabber, Matcher, ThreadSettings)
+ *
+ * usage: putslam_replay [-c globalConfig] log
+ *
+ */
+#include <iostream>
+#include <string>
+#include <chrono>
+
+#include "../3rdParty/tinyXML/tinyxml2.h"
+#include "Map/featuresMap.h"
+#include "Map/mapLog.h"
+#include "Matcher/matcherOpenCV.h"
+
+using namespace putslam;
+
+/// thread settings (the same values as in PUTSLAM)
+enum LoopClosureThread {
+    LCTHREAD_OFF, LCTHREAD_ON
+};
+enum MapManagmentThread {
+    MAPTHREAD_OFF, MAPTHREAD_ON
+};
+enum OptimizationThread {
+    OPTTHREAD_OFF, OPTTHREAD_ATEND, OPTTHREAD_ON, OPTTHREAD_ON_ROBUSTKERNEL
+};
+
+int main(int argc, char* argv[]) {
+    std::string configFile("putslamconfigGlobal.xml");
+    std::string logFile;
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "-c" && i + 1 < argc)
+            configFile = argv[++i];
+        else
+            logFile = arg;
+    }
+    if (logFile.empty()) {
+        std::cout << "usage: putslam_replay [-c globalConfig] log\n";
+        return 1;
+    }
+
+    try {
+        tinyxml2::XMLDocument config;
+        std::string filename = "../../resources/" + configFile;
+        config.LoadFile(filename.c_str());
+        if (config.ErrorID()) {
+            std::cout << "unable to load config file " << filename << "\n";
+            return 1;
+        }
+        int verbose = 0, optimizationThreadVersion = OPTTHREAD_OFF;
+        int mapManagmentThreadVersion = MAPTHREAD_OFF, loopClosureThreadVersion = LCTHREAD_OFF;
+        bool keepCameraFrames = false;
+        config.FirstChildElement("PUTSLAM")->QueryBoolAttribute("keepCameraFrames", &keepCameraFrames);
+        config.FirstChildElement("ThreadSettings")->QueryIntAttribute("verbose", &verbose);
+        config.FirstChildElement("ThreadSettings")->QueryIntAttribute("optimizationThreadVersion", &optimizationThreadVersion);
+        config.FirstChildElement("ThreadSettings")->QueryIntAttribute("mapManagmentThreadVersion", &mapManagmentThreadVersion);
+        config.FirstChildElement("ThreadSettings")->QueryIntAttribute("loopClosureThreadVersion", &loopClosureThreadVersion);
+        std::string configFileGrabber(config.FirstChildElement("Grabber")->FirstChildElement("calibrationFile")->GetText());
+        std::string configFileMap(config.FirstChildElement("Map")->FirstChildElement("parametersFile")->GetText());
+        std::string matcherParametersLC(config.FirstChildElement("Matcher")->FirstChildElement("parametersFileLC")->GetText());
+
+        MapLogReader reader;
+        if (!reader.open(logFile))
+            return 1;
+
+        std::unique_ptr<Map> map(createFeaturesMap(configFileMap, configFileGrabber));
+        // the replayed calls are not recorded again (the log of the map config could be the replayed one)
+        ((FeaturesMap*) map.get())->finishRecording();
+        map->setStoreImages(keepCameraFrames);
+        Matcher* loopClosureMatcher = createloopClosingMatcherOpenCV(matcherParametersLC, configFileGrabber);
+
+        if (optimizationThreadVersion == OPTTHREAD_ON)
+            map->startOptimizationThread(1, verbose);
+        else if (optimizationThreadVersion == OPTTHREAD_ON_ROBUSTKERNEL)
+            map->startOptimizationThread(1, verbose, "Cauchy", 1);
+        if (mapManagmentThreadVersion == MAPTHREAD_ON)
+            map->startMapManagerThread(verbose);
+        if (loopClosureThreadVersion == LCTHREAD_ON)
+            map->startLoopClosureThread(verbose, loopClosureMatcher);
+
+        auto start = std::chrono::steady_clock::now();
+        size_t recordsNo = reader.replayAll(*((FeaturesMap*) map.get()));
+        double replayTime = (double) std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count() / 1e6;
+
+        if (mapManagmentThreadVersion == MAPTHREAD_ON)
+            map->finishManagementThr();
+        if (loopClosureThreadVersion == LCTHREAD_ON)
+            map->finishLoopClosureThr();
+        if (optimizationThreadVersion == OPTTHREAD_ATEND)
+            map->startOptimizationThread(1, 1);
+        if (optimizationThreadVersion != OPTTHREAD_OFF)
+            map->finishOptimization("graph_trajectory.res", "optimizedGraphFile.g2o");
+        double totalTime = (double) std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count() / 1e6;
+
+        size_t posesNo = reader.getRecordsNo(MapLog::RECORD_NEW_POSE);
+        std::cout << "putslam_replay: " << recordsNo << " records (" << posesNo << " poses, "
+                << reader.getRecordsNo(MapLog::RECORD_FEATURES) << " addFeatures, "
+                << reader.getRecordsNo(MapLog::RECORD_MEASUREMENTS) << " addMeasurements, "
+                << reader.getRecordsNo(MapLog::RECORD_MEASUREMENT) << " addMeasurement, "
+                << reader.getRecordsNo(MapLog::RECORD_FRAME_FEATURES) << " addFrameFeatures)\n";
+        std::cout << "putslam_replay: replay " << replayTime << " s (" << ((replayTime > 0) ? (double) posesNo / replayTime : 0)
+                << " poses/s), total with back-end threads " << totalTime << " s\n";
+    }
+    catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
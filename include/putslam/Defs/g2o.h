@@ -4,6 +4,7 @@
 // Avoid tons of warnings with g2o code
 #pragma GCC system_header
 #endif
+#include "g2o/config.h"
 #include "g2o/core/sparse_optimizer.h"
 #include "g2o/core/optimizable_graph.h"
 #include "g2o/core/block_solver.h"
@@ -13,6 +14,10 @@
 #include "g2o/core/optimization_algorithm_levenberg.h"
 #include "g2o/solvers/csparse/linear_solver_csparse.h"
 #include "g2o/solvers/pcg/linear_solver_pcg.h"
+#include "g2o/solvers/eigen/linear_solver_eigen.h"
+#ifdef G2O_HAVE_CHOLMOD
+#include "g2o/solvers/cholmod/linear_solver_cholmod.h"
+#endif
 #include "g2o/types/slam3d/parameter_se3_offset.h"
 #include "g2o/core/robust_kernel.h"
 #include "g2o/core/robust_kernel_factory.h"
@@ -24,4 +29,5 @@
 //#include "g2o/core/eigen_types.h"
 //#include "g2o/types/sba/types_six_dof_expmap.h"
 #include "g2o/types/slam3d/edge_se3_pointxyz_reprojectionError.h"
+#include "g2o/types/slam3d/edge_marginalization_prior.h"
 #endif
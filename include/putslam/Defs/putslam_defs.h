@@ -17,6 +17,7 @@
 //#include <pcl/point_types.h>
 //#include <pcl/io/pcd_io.h>
 #include <mutex>
+#include "Utilities/instrumentedMutex.h"
 #include <set>
 #include <iostream>
 #include <map>
@@ -563,7 +564,7 @@ public:
     inline bool updatePoses() const { return (poses2update.size()>0) ?  true : false;}
 
     /// mutex to lock access
-    std::recursive_mutex mtxBuffer;
+    putslam::RecursiveMutex mtxBuffer{"MapModifier::mtxBuffer"};
 };
 
 }
@@ -8,6 +8,7 @@
 #define _LOOPCLOSURE_H_
 
 #include "../Defs/putslam_defs.h"
+#include "../Utilities/minMaxHeap.h"
 #include <deque>
 #include <queue>
 #include <thread>
@@ -55,7 +56,7 @@ public:
 
 	/// overloaded constructor
     LoopClosure(const std::string _name, Type _type) :
-    	type(_type), name(_name) {
+    	type(_type), name(_name), imageScale(1.0), maxQueuedImagesBytes(0), queuedImagesBytes(0) {
     }
 
     /// Name of the LoopClosure
@@ -65,11 +66,36 @@ public:
     virtual ~LoopClosure() {
 	}
 
-    /// add new pose
+    /// add new pose (only grey, downscaled copy of the image is stored)
     virtual void addPose(const Mat34& cameraPose, cv::Mat& imageRGB, int frameId) {
+        cv::Mat thumbnail;
+        if (imageRGB.channels() > 1)
+            cv::cvtColor(imageRGB, thumbnail, CV_RGB2GRAY);
+        else
+            thumbnail = imageRGB.clone();
+        if (imageScale < 1.0)
+            cv::resize(thumbnail, thumbnail, cv::Size(), imageScale, imageScale, cv::INTER_AREA);
 
     	imageDataMtx.lock();
-        imagesSeq.push_back(imageRGB);
+        imagesSeq.push_back(thumbnail);
+        queuedImagesBytes += thumbnail.total() * thumbnail.elemSize();
+        trimImagesQueue();
+        keypointsSeq.push_back(std::vector<cv::KeyPoint>());
+        descriptorsSeq.push_back(cv::Mat());
+        cameraPoses.push_back(cameraPose);
+        frameIds.push_back(frameId);
+        imageDataMtx.unlock();
+    }
+
+    /// add new pose (keypoints and descriptors computed by the frontend, the image is not stored)
+    virtual void addPose(const Mat34& cameraPose, const std::vector<cv::KeyPoint>& keypoints, const cv::Mat& descriptors, int frameId) {
+
+    	imageDataMtx.lock();
+        imagesSeq.push_back(cv::Mat());
+        keypointsSeq.push_back(keypoints);
+        descriptorsSeq.push_back(descriptors);
+        queuedImagesBytes += descriptors.total() * descriptors.elemSize() + keypoints.size() * sizeof(cv::KeyPoint);
+        trimImagesQueue();
         cameraPoses.push_back(cameraPose);
         frameIds.push_back(frameId);
         imageDataMtx.unlock();
@@ -104,8 +130,17 @@ protected:
     /// LC name
 	const std::string name;
 
-	/// mutex to protect imagesSeq, cameraPoses and frameIds
-	std::mutex imageDataMtx;
+	/// mutex to protect imagesSeq, keypointsSeq, descriptorsSeq, cameraPoses, frameIds and queuedImagesBytes
+	putslam::Mutex imageDataMtx{"LoopClosure::imageDataMtx"};
+
+    /// scale of the stored images (thumbnails)
+    double imageScale;
+
+    /// max memory used by images and features waiting for VPR (0 -- unlimited)
+    size_t maxQueuedImagesBytes;
+
+    /// memory used by images and features waiting for VPR
+    size_t queuedImagesBytes;
 
     /// poses (random access, not continous storage)
     std::deque<Mat34> cameraPoses;
@@ -113,12 +148,44 @@ protected:
     /// images (random access, not continous storage)
     std::deque<cv::Mat> imagesSeq;
 
+    /// keypoints computed by the frontend (empty if image is provided)
+    std::deque<std::vector<cv::KeyPoint>> keypointsSeq;
+
+    /// descriptors computed by the frontend (empty if image is provided)
+    std::deque<cv::Mat> descriptorsSeq;
+
     /// images (random access, not continous storage)
     std::deque<int> frameIds;
 
-    /// loop closure priority queue
-    std::mutex priorityQueueMtx;
-    std::priority_queue<LCMatch, std::vector<LCMatch>, LCMatch > priorityQueueLC;
+    /// loop closure priority queue (bounded, the least probable candidates are removed in O(log n))
+    putslam::Mutex priorityQueueMtx{"LoopClosure::priorityQueueMtx"};
+    MinMaxHeap<LCMatch, LCMatch> priorityQueueLC;
+
+    /// take the oldest queued frame (images/features are released), imageDataMtx has to be locked
+    void popQueuedFrame(cv::Mat& image, std::vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors) {
+        image = imagesSeq.front();
+        imagesSeq.pop_front();
+        keypoints = keypointsSeq.front();
+        keypointsSeq.pop_front();
+        descriptors = descriptorsSeq.front();
+        descriptorsSeq.pop_front();
+        queuedImagesBytes -= std::min(queuedImagesBytes, image.total() * image.elemSize()
+                + descriptors.total() * descriptors.elemSize() + keypoints.size() * sizeof(cv::KeyPoint));
+    }
+
+    /// release the oldest queued images/features if the memory limit is exceeded (frames are skipped by VPR), imageDataMtx has to be locked
+    void trimImagesQueue(void) {
+        for (size_t i = 0; maxQueuedImagesBytes > 0 && queuedImagesBytes > maxQueuedImagesBytes && i + 1 < imagesSeq.size(); i++) {
+            size_t bytes = imagesSeq[i].total() * imagesSeq[i].elemSize()
+                    + descriptorsSeq[i].total() * descriptorsSeq[i].elemSize() + keypointsSeq[i].size() * sizeof(cv::KeyPoint);
+            if (bytes == 0)
+                continue;
+            imagesSeq[i].release();
+            descriptorsSeq[i].release();
+            std::vector<cv::KeyPoint>().swap(keypointsSeq[i]);
+            queuedImagesBytes -= std::min(queuedImagesBytes, bytes);
+        }
+    }
 };
 }
 
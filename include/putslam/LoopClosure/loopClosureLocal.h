@@ -62,6 +62,15 @@ public:
 
             ///
             int maxPQSize;
+
+            /// FabMap variant (FABMAP1, FABMAPLUT, FABMAPFBO, FABMAP2)
+            std::string fabMapVersion;
+
+            /// scale of images stored for VPR (grey thumbnails)
+            double imageScale;
+
+            /// max memory used by frames waiting for VPR [MB] (0 -- unlimited)
+            int maxQueueMemoryMB;
     };
 
 private:
@@ -80,9 +89,6 @@ private:
     /// geometric loop closure method
     void updatePriorityQueue(void);
 
-    ///
-    void checkAndTrimPQSize();
-
     /// current frame
     int currentFrame;
 };
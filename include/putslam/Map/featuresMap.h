@@ -12,10 +12,12 @@
 #include "../PoseGraph/weightedGraph.h"
 #include "Utilities/observer.h"
 #include "Utilities/stopwatch.h"
+#include "Utilities/mailbox.h"
 #include <memory>
 #include <atomic>
 #include "Grabber/depthSensorModel.h"
 #include "LoopClosure/loopClosureLocal.h"
+#include "mapLog.h"
 #include <iostream>
 #include <deque>
 #include <queue>
@@ -62,6 +64,17 @@ public:
 	/// add new pose of the camera, returns id of the new pose
     int addNewPose(const Mat34& cameraPoseChange, double timestamp, cv::Mat image = cv::Mat(), cv::Mat depthImage = cv::Mat());
 
+    /// add keypoints and descriptors computed by the frontend for the pose (used by LC instead of the image)
+    void addFrameFeatures(int poseId, const std::vector<cv::KeyPoint>& keypoints, const cv::Mat& descriptors);
+
+    /// finish recording of the frontend calls (the log is closed)
+    void finishRecording(void);
+
+    /// LC uses keypoints and descriptors from the frontend
+    bool useFrontendFeaturesLC(void) const {
+        return config.useFrontendFeaturesLC;
+    }
+
     /// remove features (and measurements to them) for features of provided ids
     void removeFeatures(std::vector<int> featureIdsToRemove);
 
@@ -92,6 +105,9 @@ public:
 	/// get size of poses
 	int getPoseCounter();
 
+    /// check if the pose is a keyframe
+    bool isKeyframe(int poseId);
+
 	/// getDepthSensorModel
 	DepthSensorModel getDepthSensorModel() {
 		return sensorModel;
@@ -119,6 +135,9 @@ public:
     /// Wait for loop closure thread to finish
     void finishLoopClosureThr(void);
 
+    /// stop visualization thread
+    void finishVisualizationThr(void);
+
     /// Save map to file
     void save2file(std::string mapFilename, std::string graphFilename);
 
@@ -157,7 +176,7 @@ public:
     /// disable Robust Kernel
     void disableRobustKernel(void);
 
-    /// get n-th image and depth image from the sequence
+    /// get n-th image and depth image from the sequence (empty if the frame is not stored)
     void getImages(int poseNo, cv::Mat& image, cv::Mat& depthImage);
 
     /// Update pose
@@ -184,7 +203,7 @@ public:
     class Config{
       public:
         Config() :
-            useUncertainty(true){
+            useUncertainty(true), recordImages(false){
         }
         Config(std::string configFilename){
             tinyxml2::XMLDocument config;
@@ -232,6 +251,8 @@ public:
             model->FirstChildElement("mapCompression")->QueryDoubleAttribute("marginalizationThr", &marginalizationThr);
             model->FirstChildElement("mapCompression")->QueryIntAttribute("minFramesNo", &minFramesNo);
             model->FirstChildElement("mapCompression")->QueryIntAttribute("maxFramesNo", &maxFramesNo);
+            slidingWindow = false;
+            model->FirstChildElement("mapCompression")->QueryBoolAttribute("slidingWindow", &slidingWindow);
 
             model->FirstChildElement("EuclideanCriterion")->QueryBoolAttribute("useEuclideanCrit", &useEuclideanCrit);
             model->FirstChildElement("EuclideanCriterion")->QueryDoubleAttribute("imagePlaneDistance", &imagePlaneDistance);
@@ -247,12 +268,43 @@ public:
             model->FirstChildElement( "featuresDistribution" )->QueryUnsignedAttribute("frameNo", &frameNo);
             filenameFeatDistr = model->FirstChildElement( "featuresDistribution" )->Attribute("filenameFeatDistr");
             model->FirstChildElement( "visualization" )->QueryIntAttribute("frameNo2updatePointCloud", &frameNo2updatePointCloud);
+            visualizationRate = 10.0;
+            model->FirstChildElement( "visualization" )->QueryDoubleAttribute("publishRate", &visualizationRate);
 
             model->FirstChildElement( "loopClosure" )->QueryIntAttribute("searchPairsTypeLC", &searchPairsTypeLC);
             model->FirstChildElement( "loopClosure" )->QueryIntAttribute("waitUntilFinishedLC", &waitUntilFinishedLC);
             model->FirstChildElement( "loopClosure" )->QueryIntAttribute("minNumberOfFeaturesLC", &minNumberOfFeaturesLC);
             model->FirstChildElement( "loopClosure" )->QueryDoubleAttribute("matchingRatioThresholdLC", &matchingRatioThresholdLC);
             configFilenameLC = model->FirstChildElement( "loopClosure" )->Attribute("configFilenameLC");
+            useFrontendFeaturesLC = false;
+            model->FirstChildElement( "loopClosure" )->QueryBoolAttribute("useFrontendFeaturesLC", &useFrontendFeaturesLC);
+
+            // local graph solver (older config files do not define it)
+            linearSolver = "PCG"; blockSolver = "X"; optimizationAlgorithm = "GaussNewton";
+            tinyxml2::XMLElement * solver = model->FirstChildElement( "localGraphSolver" );
+            if (solver!=nullptr){
+                if (solver->Attribute("linearSolver")) linearSolver = solver->Attribute("linearSolver");
+                if (solver->Attribute("blockSolver")) blockSolver = solver->Attribute("blockSolver");
+                if (solver->Attribute("optimizationAlgorithm")) optimizationAlgorithm = solver->Attribute("optimizationAlgorithm");
+            }
+
+            // incremental optimization of the local graph
+            incrementalOpt = false; incrementalDepth = 3; relinearizationThr = 0.01; fullOptimizationPeriod = 20;
+            tinyxml2::XMLElement * incremental = model->FirstChildElement( "incrementalOptimization" );
+            if (incremental!=nullptr){
+                incremental->QueryBoolAttribute("enabled", &incrementalOpt);
+                incremental->QueryIntAttribute("neighbourhoodDepth", &incrementalDepth);
+                incremental->QueryDoubleAttribute("relinearizationThr", &relinearizationThr);
+                incremental->QueryIntAttribute("fullOptimizationPeriod", &fullOptimizationPeriod);
+            }
+
+            // record frontend calls for the back-end experiments (older config files do not define it)
+            recordImages = false;
+            tinyxml2::XMLElement * recording = model->FirstChildElement( "recording" );
+            if (recording!=nullptr){
+                if (recording->Attribute("log")) recordLog = recording->Attribute("log");
+                recording->QueryBoolAttribute("recordImages", &recordImages);
+            }
 
             visualize = false;
 
@@ -350,6 +402,9 @@ public:
             /// Update point cloud visualizer ever n-th frame
             int frameNo2updatePointCloud;
 
+            /// rate of sending updates to the visualizer [Hz]
+            double visualizationRate;
+
             /// use visualizer
             bool visualize;
 
@@ -368,6 +423,9 @@ public:
             /// config filename LC
             std::string configFilenameLC;
 
+            /// LC uses keypoints and descriptors from the frontend instead of images
+            bool useFrontendFeaturesLC;
+
             /// store images
             bool keepCameraFrames;
 
@@ -377,9 +435,39 @@ public:
             /// use map compression
             bool compressMap;
 
+            /// marginalize keyframes which leave the window (maxFramesNo) instead of fixing them
+            bool slidingWindow;
+
             /// add keyframe when covisibility smaler than
             double covisibilityKeyframes;
 
+            /// local graph: linear solver (PCG, CSparse, Cholmod, Eigen)
+            std::string linearSolver;
+
+            /// local graph: block solver (X - dynamic, 6_3 - fixed size)
+            std::string blockSolver;
+
+            /// local graph: optimization algorithm (GaussNewton, Levenberg)
+            std::string optimizationAlgorithm;
+
+            /// local graph: incremental optimization
+            bool incrementalOpt;
+
+            /// local graph: size of the optimized neighbourhood (number of edges from the new vertices)
+            int incrementalDepth;
+
+            /// local graph: vertices which moved more than threshold are optimized in the next step
+            double relinearizationThr;
+
+            /// local graph: optimize whole graph every n-th optimization (0 - never)
+            int fullOptimizationPeriod;
+
+            /// log of the frontend calls (empty - recording disabled)
+            std::string recordLog;
+
+            /// record images of poses in the log
+            bool recordImages;
+
             enum OptimizationErrorType {
             	EUCLIDEAN,
 				REPROJECTION
@@ -390,6 +478,9 @@ private:
     ///Configuration of the module
     Config config;
 
+    /// log of the frontend calls
+    MapLogWriter mapLog;
+
 	///camera trajectory
     std::vector<VertexSE3> camTrajectory;
 
@@ -414,8 +505,14 @@ private:
     /// Depth camera images -- sequence
     std::map<int,cv::Mat> depthSeq;
 
+    /// keypoints and descriptors computed by the frontend -- sequence (used by LC)
+    std::map<int,std::pair<std::vector<cv::KeyPoint>,cv::Mat>> frameFeaturesSeq;
+
+    /// mutex for imageSeq, depthSeq and frameFeaturesSeq
+    mutable std::mutex mtxImages;
+
     /// mutex for camera trajectory
-    mutable std::mutex mtxCamTraj;
+    mutable putslam::Mutex mtxCamTraj{"FeaturesMap::mtxCamTraj"};
 
 	///Pose graph
 	Graph * poseGraph;
@@ -447,6 +544,31 @@ private:
     /// loop closure thread flag
     std::atomic<bool> continueLoopClosure;
 
+    /// Visualization thread
+    std::unique_ptr<std::thread> visualizationThr;
+
+    /// visualization thread flag
+    std::atomic<bool> continueVisualization;
+
+    /// images of the keyframe sent to the visualizer
+    class VisualizationFrame{
+    public:
+        VisualizationFrame() : poseId(-1) {}
+        VisualizationFrame(const cv::Mat& _rgbImage, const cv::Mat& _depthImage, int _poseId) :
+            rgbImage(_rgbImage), depthImage(_depthImage), poseId(_poseId) {}
+        cv::Mat rgbImage, depthImage;
+        int poseId;
+    };
+
+    /// the latest keyframe for the visualizer (point cloud)
+    Mailbox<VisualizationFrame> keyframe2visualization;
+
+    /// measurements for the visualizer
+    std::vector<Edge3D> measurements2visualization;
+
+    /// mutex for critical section - measurements for the visualizer
+    std::mutex mtxVisualization;
+
 	/// Number of features
 	unsigned int featureIdNo;
 
@@ -457,13 +579,13 @@ private:
     std::map<int,MapFeature> featuresMapFrontend;
 
     /// mutex for critical section - map frontend
-    mutable std::recursive_mutex mtxMapFrontend;
+    mutable putslam::RecursiveMutex mtxMapFrontend{"FeaturesMap::mtxMapFrontend"};
 
     ///Set of features (map for the map management thread)
     std::map<int,MapFeature> featuresMapManagement;
 
     /// mutex for critical section - map management
-    std::recursive_mutex mtxMapManagement;
+    putslam::RecursiveMutex mtxMapManagement{"FeaturesMap::mtxMapManagement"};
 
     /// Map frontend -- buffer
     MapModifier bufferMapFrontend;
@@ -506,9 +628,12 @@ private:
     /// geometric loop closure method
     void loopClosure(int verbose, Matcher* matcher);
 
+    /// visualization thread -- sends map changes to the visualizer with the fixed rate
+    void publishVisualization(void);
+
     /// Update map
     /// Update map
-    bool updateMap(MapModifier& modifier, std::map<int,MapFeature>& featuresMap, std::recursive_mutex& mutex);
+    bool updateMap(MapModifier& modifier, std::map<int,MapFeature>& featuresMap, putslam::RecursiveMutex& mutex);
 
     /// Update feature
     void updateFeature(std::map<int,MapFeature>& featuresMap, const MapFeature& newFeature);
@@ -534,6 +659,9 @@ private:
     /// computes std and mean from float vector
     void computeMeanStd(const std::vector<double>& v, double& mean, double& std, double& max);
 
+    /// add measurements to the map (frontend and loop closure, not recorded)
+    void insertMeasurements(const std::vector<MapFeature>& features, int poseId);
+
     /// marginalize measurements between frames
     void marginalizeMeasurements(int frameBegin, int frameEnd);
 
@@ -549,6 +677,9 @@ private:
     /// fixMeasurementsFromPose
     void fixMeasurementsFromPose(int frameId);
 
+    /// marginalize keyframe and features measured only from it (dense prior on the remaining part of the graph)
+    void marginalizeKeyframe(int frameId);
+
     /// save optimization time
     void saveOptimizationTime(std::list<std::pair<double,double>>& optimizationTime, std::string filename);
 
@@ -83,6 +83,9 @@ public:
 	// get number of poses stored in map
 	virtual int getPoseCounter() = 0;
 
+    /// check if the pose is a keyframe
+    virtual bool isKeyframe(int poseId) = 0;
+
 	/// getDepthSensorModel
 	virtual DepthSensorModel getDepthSensorModel() = 0;
 
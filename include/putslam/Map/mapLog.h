@@ -0,0 +1,120 @@
+/** @file mapLog.h
+ *
+ * Record and replay of the frontend calls of FeaturesMap (addNewPose, addFeatures, addMeasurements, addMeasurement,
+ * addFrameFeatures) -- back-end experiments without detection, matching and RANSAC
+ * binary log (native byte order): header "PUTSLAMLOG" + version, then records: type (uint8) + data
+ *
+ */
+
+#ifndef _MAPLOG_H_
+#define _MAPLOG_H_
+
+#include "Defs/putslam_defs.h"
+#include "Utilities/instrumentedMutex.h"
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+class FeaturesMap;
+
+namespace putslam {
+
+/// Log of the frontend calls
+class MapLog {
+public:
+    /// types of records
+    enum RecordType {
+        RECORD_NEW_POSE = 1, RECORD_FEATURES, RECORD_MEASUREMENTS, RECORD_MEASUREMENT, RECORD_FRAME_FEATURES, RECORD_TYPES_NO
+    };
+
+    /// version of the format
+    static const uint32_t version = 1;
+
+    /// header of the file
+    static const char* header(void) {
+        return "PUTSLAMLOG";
+    }
+};
+
+/// Writes the log (the file is created with the first record)
+class MapLogWriter {
+public:
+    MapLogWriter(void) : enabled(false), recordImages(false), mtxLog("MapLogWriter::mtxLog") {
+    }
+
+    ~MapLogWriter(void) {
+        finish();
+    }
+
+    /// enable recording to the file
+    void setFile(const std::string& _filename, bool _recordImages);
+
+    /// recording is enabled
+    bool isEnabled(void) const {
+        return enabled;
+    }
+
+    /// record addNewPose (images are saved if recordImages is set)
+    void recordNewPose(const Mat34& cameraPoseChange, double timestamp, const cv::Mat& image, const cv::Mat& depthImage);
+
+    /// record addFeatures
+    void recordFeatures(const std::vector<RGBDFeature>& features, int poseId);
+
+    /// record addMeasurements
+    void recordMeasurements(const std::vector<MapFeature>& features, int poseId);
+
+    /// record addMeasurement
+    void recordMeasurement(int poseFrom, int poseTo, const Mat34& transformation);
+
+    /// record addFrameFeatures
+    void recordFrameFeatures(int poseId, const std::vector<cv::KeyPoint>& keypoints, const cv::Mat& descriptors);
+
+    /// close the log and stop recording
+    void finish(void);
+
+private:
+    /// open the file if it is the first record, returns false if recording is disabled
+    bool beginRecord(MapLog::RecordType type);
+
+    /// recording is enabled
+    bool enabled;
+    /// save images of poses
+    bool recordImages;
+    /// log filename
+    std::string filename;
+    /// log file
+    std::ofstream file;
+    /// mutex for critical section - file
+    putslam::Mutex mtxLog;
+};
+
+/// Reads the log and feeds it to the map
+class MapLogReader {
+public:
+    MapLogReader(void) : recordsNo(MapLog::RECORD_TYPES_NO, 0) {
+    }
+
+    /// open the log, returns false if the file is not a map log
+    bool open(const std::string& filename);
+
+    /// replay the next record, returns false at the end of the log (or if the record is corrupted)
+    bool replayNext(FeaturesMap& map);
+
+    /// replay all records, returns number of replayed records
+    size_t replayAll(FeaturesMap& map);
+
+    /// number of replayed records of the type
+    size_t getRecordsNo(MapLog::RecordType type) const {
+        return recordsNo[type];
+    }
+
+private:
+    /// log file
+    std::ifstream file;
+    /// number of replayed records of each type
+    std::vector<size_t> recordsNo;
+};
+}
+
+#endif // _MAPLOG_H_
@@ -12,6 +12,7 @@
 #include "../Defs/opencvCore.h"
 #include <string>
 #include <vector>
+#include <mutex>
 #include "../../3rdParty/tinyXML/tinyxml2.h"
 #include "../TransformEst/RANSAC.h"
 #include "RGBD/RGBD.h"
@@ -102,6 +103,12 @@ public:
 	/// Load features at the start of the sequence
 	void detectInitFeatures(const SensorFrame& sensorData);
 
+	/// Detect features and remove clustered ones (DBScan) -- might be called in parallel with VO (pipelined frontend)
+	std::vector<cv::KeyPoint> detectFrameFeatures(const cv::Mat& rgbImage);
+
+	/// Set features detected in advance for the image -- used instead of detection on the same image
+	void setDetectedFeatures(const cv::Mat& rgbImage, const std::vector<cv::KeyPoint>& keyPoints);
+
 	/// Get current set of features
 	Matcher::featureSet getFeatures();
 
@@ -388,6 +395,16 @@ protected:
 	// Time measurement
 	TimeMeasurement detectionTimes, trackingTimes, ransacTimes;
 
+	/// Features detected in advance and their image
+	cv::Mat detectedFeaturesImage;
+	std::vector<cv::KeyPoint> detectedFeatures;
+
+	/// Mutex for the detector (detection in the pipeline stage)
+	std::mutex mtxDetector;
+
+	/// Detected features of the image (detected in advance if available)
+	std::vector<cv::KeyPoint> getFrameFeatures(const cv::Mat& rgbImage);
+
 	//TODO: TEMPORARILY
 public:
 	/// Parameters
@@ -0,0 +1,99 @@
+/** @file KeyframeIntegrator.h
+ *
+ * Background integration of keyframes into a dense map (base of OctomapBuilder and TSDFBuilder)
+ * keyframes are integrated as they appear in the map and re-integrated when their poses are moved by the optimization
+ *
+ */
+
+#ifndef _KEYFRAMEINTEGRATOR_H_
+#define _KEYFRAMEINTEGRATOR_H_
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <map>
+#include <string>
+
+#include "Defs/putslam_defs.h"
+#include "Map/map.h"
+
+namespace putslam {
+
+/// keyframes integrated in the background thread
+class KeyframeIntegrator {
+public:
+    class Config {
+    public:
+        Config() : verbose(0), reintegrationDist(0.05), reintegrationAngle(0.05) {}
+
+        /// verbose
+        int verbose;
+        /// keyframe is re-integrated if its pose moved more than reintegrationDist [m]
+        double reintegrationDist;
+        /// keyframe is re-integrated if its pose rotated more than reintegrationAngle [rad]
+        double reintegrationAngle;
+    };
+
+    /// Construction
+    KeyframeIntegrator(const std::string& name, Map* map, const Config& config);
+
+    /// Destruction (the thread has to be stopped by the derived class)
+    virtual ~KeyframeIntegrator() {}
+
+    /// start background thread
+    void start(void);
+
+    /// stop background thread, integrate remaining keyframes and re-integrate keyframes moved by the final optimization
+    virtual void finish(void);
+
+    /// number of integrated keyframes
+    size_t getIntegratedNo(void);
+
+protected:
+    /// map
+    Map* map;
+
+    /// mutex for the integrated data
+    std::mutex mtxIntegration;
+
+    /// stop background thread
+    void stop(void);
+
+    /// integrate keyframe with the pose, returns false if its data is not available (called with mtxIntegration locked)
+    virtual bool integrateKeyframe(int poseId, const Mat34& pose) = 0;
+
+    /// remove keyframe integrated with the pose and integrate it with newPose, returns false if its data is not available (called with mtxIntegration locked)
+    virtual bool reintegrateKeyframe(int poseId, const Mat34& pose, const Mat34& newPose) = 0;
+
+private:
+    /// name used in messages
+    std::string name;
+
+    /// configuration
+    Config config;
+
+    /// poses used for integration of keyframes (pose id -> pose)
+    std::map<int, Mat34> poses;
+
+    /// next pose to check
+    int nextPoseId;
+
+    /// thread
+    std::unique_ptr<std::thread> builderThr;
+
+    /// thread flag
+    std::atomic<bool> continueBuilding;
+
+    /// thread loop
+    void build(void);
+
+    /// integrate new keyframes and re-integrate moved ones, returns true if the map was modified (final -- all remaining poses)
+    bool update(bool final);
+
+    /// check if pose moved significantly
+    bool poseChanged(const Mat34& poseA, const Mat34& poseB) const;
+};
+}
+
+#endif // _KEYFRAMEINTEGRATOR_H_
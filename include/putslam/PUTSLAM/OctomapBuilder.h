@@ -0,0 +1,85 @@
+/** @file OctomapBuilder.h
+ *
+ * Incremental (online) Octomap construction
+ * keyframes are integrated in the background thread as they appear in the map (voxel downsampling, batched ray casting)
+ * and re-integrated when their poses are moved by the optimization
+ *
+ */
+
+#ifndef _OCTOMAPBUILDER_H_
+#define _OCTOMAPBUILDER_H_
+
+#include <map>
+
+#include <octomap/octomap.h>
+#include <octomap/ColorOcTree.h>
+
+#include "PUTSLAM/KeyframeIntegrator.h"
+
+namespace putslam {
+
+/// Octomap built in the background thread
+class OctomapBuilder : public KeyframeIntegrator {
+public:
+    class Config : public KeyframeIntegrator::Config {
+    public:
+        Config() : maxRange(-1.0), downsample(true) {}
+
+        /// max range of the ray casting (-1 -- unlimited)
+        double maxRange;
+        /// voxel downsampling of point clouds (octomap resolution)
+        bool downsample;
+    };
+
+    /// Construction
+    OctomapBuilder(Map* map, octomap::ColorOcTree* tree, const cv::Mat& cameraMatrix, double depthImageScale, const Config& config);
+
+    /// Destruction
+    ~OctomapBuilder();
+
+    /// stop background thread, integrate remaining keyframes using final poses and update inner nodes
+    void finish(void);
+
+    /// add occupancy (log-odds) and colors of the partial tree to the tree (reduction of trees built in parallel)
+    static void mergeTree(const octomap::ColorOcTree& partial, octomap::ColorOcTree& tree);
+
+private:
+    /// integrated point cloud
+    class Cloud {
+    public:
+        /// points in the sensor frame (downsampled)
+        std::vector<Eigen::Vector3f> points;
+        /// colors of points (RGB)
+        std::vector<Eigen::Vector3i> colors;
+    };
+
+    /// octomap
+    octomap::ColorOcTree* tree;
+
+    /// camera matrix
+    cv::Mat cameraMatrix;
+
+    /// depth image scale
+    double depthImageScale;
+
+    /// configuration
+    Config config;
+
+    /// integrated clouds (pose id -> cloud)
+    std::map<int, Cloud> clouds;
+
+    /// integrate cloud of the keyframe, returns false if images are not available
+    bool integrateKeyframe(int poseId, const Mat34& pose);
+
+    /// remove cloud of the keyframe and integrate it with newPose
+    bool reintegrateKeyframe(int poseId, const Mat34& pose, const Mat34& newPose);
+
+    /// create downsampled cloud from images
+    bool createCloud(int poseId, Cloud& cloud);
+
+    /// insert cloud acquired from the pose to the tree (sign > 0) or remove its contribution (sign < 0)
+    void integrate(const Cloud& cloud, const Mat34& pose, int sign);
+};
+}
+
+#endif // _OCTOMAPBUILDER_H_
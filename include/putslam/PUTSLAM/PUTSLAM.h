@@ -9,6 +9,8 @@
 #include <chrono>
 #include <fstream>
 #include <mutex>
+#include <condition_variable>
+#include <deque>
 
 #include <octomap/octomap.h>
 #include <octomap/ColorOcTree.h>
@@ -24,6 +26,10 @@
 #include "Matcher/matcherOpenCV.h"
 #include "Map/featuresMap.h"
 #include "RGBD/RGBD.h"
+#include "RGBD/tsdfVolume.h"
+#include "PUTSLAM/OctomapBuilder.h"
+#include "PUTSLAM/TSDFBuilder.h"
+#include "Utilities/boundedQueue.h"
 #ifdef BUILD_PUTSLAM_VISUALIZER
 #include "Visualizer/Qvisualizer.h"
 #endif
@@ -69,13 +75,44 @@ class PUTSLAM {
 
     int verbose, onlyVO, mapManagmentThreadVersion, optimizationThreadVersion,
             loopClosureThreadVersion, octomap, octomapCloudStepSize,
-            octomapOffline;
-    double octomapResolution;bool keepCameraFrames;
+            octomapOffline, octomapOfflineThreads, octomapOnline;
+    double octomapResolution, octomapMaxRange, octomapReintegrationDist,
+            octomapReintegrationAngle;bool keepCameraFrames;
     std::string octomapFileToSave;
 
+    // TSDF dense map (integrated in the background, mesh saved at the end)
+    int tsdf;
+    double tsdfVoxelSize, tsdfTruncation, tsdfMaxDepth, tsdfReintegrationDist,
+            tsdfReintegrationAngle;
+    std::string tsdfFileToSave;
+
+    // TSDF volume and its background builder
+    std::unique_ptr<TSDFVolume> tsdfVolume;
+    std::unique_ptr<TSDFBuilder> tsdfBuilder;
+
     // Octomap pointer
     std::unique_ptr<octomap::ColorOcTree> octomapTree;
 
+    // Octomap built in the background thread (octomapOnline)
+    std::unique_ptr<OctomapBuilder> octomapBuilder;
+
+    // Pipelined frontend -- acquisition and feature detection of next frames run in separate threads
+    int frontendPipeline, frontendQueueSize;
+
+    // Profiling of stages (0 - off, 1 - histograms, 2 - histograms and trace)
+    int profile;
+    std::string profileFilename;
+
+    // Frame passed between stages of the pipeline
+    class PipelineFrame {
+    public:
+        SensorFrame frame;
+        std::vector<cv::KeyPoint> keyPoints;
+        long grabTime, detectionTime;
+    };
+    std::unique_ptr<BoundedQueue<PipelineFrame>> acquisitionQueue, detectionQueue;
+    std::unique_ptr<std::thread> acquisitionThr, detectionThr;
+
     // Save some statistics to analyze
     std::vector<int> measurementToMapSizeLog, VOFeaturesSizeLog, visibleMapFeaturesLog;
     std::vector<double> VORansacInlierRatioLog;
@@ -114,6 +151,9 @@ public:
     /// set drawing options
     void setDrawOptions(bool _draw, bool _drawImages);
 
+    /// turn off windows and debugging output of modules (benchmarking)
+    void setHeadless();
+
     /// Current Pose
     void getCurrentPose(Mat34& camPose);
 
@@ -141,12 +181,18 @@ private:
     void initialization();
 
     // Processing
+    bool getNextFrame(SensorFrame &currentSensorFrame, bool measureTime);
+    void startFrontendPipeline();
+    void finishFrontendPipeline();
+    void acquisitionStage();
+    void detectionStage();
     void processFirstFrame(SensorFrame &currentSensorFrame, int &cameraPoseId);
 
     Eigen::Matrix4f runVO(SensorFrame &currentSensorFrame,
             std::vector<cv::DMatch> &inlierMatches);
     void addPoseToMap(SensorFrame &currentSensorFrame,
             Eigen::Matrix4f &poseIncrement, int &cameraPoseId);
+    void addFrameFeaturesToMap(int cameraPoseId);
     Mat34 getMapPoseEstimate();
     Eigen::Matrix4f getPoseIncrementFromMap(int frameCounter);
 
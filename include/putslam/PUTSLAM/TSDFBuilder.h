@@ -0,0 +1,44 @@
+/** @file TSDFBuilder.h
+ *
+ * Incremental (online) TSDF dense map
+ * keyframes stored in the map are integrated in the background thread as they appear
+ * and re-integrated (removed with the previous pose, integrated with the optimized one) when the optimization moves them
+ *
+ */
+
+#ifndef _TSDFBUILDER_H_
+#define _TSDFBUILDER_H_
+
+#include "PUTSLAM/KeyframeIntegrator.h"
+#include "RGBD/tsdfVolume.h"
+
+namespace putslam {
+
+/// TSDF volume built in the background thread
+class TSDFBuilder : public KeyframeIntegrator {
+public:
+    /// Construction
+    TSDFBuilder(Map* map, TSDFVolume* volume, const cv::Mat& cameraMatrix, double depthImageScale, const Config& config);
+
+    /// Destruction
+    ~TSDFBuilder();
+
+private:
+    /// TSDF volume
+    TSDFVolume* volume;
+
+    /// camera matrix
+    cv::Mat cameraMatrix;
+
+    /// depth image scale
+    double depthImageScale;
+
+    /// integrate images of the keyframe, returns false if images are not available
+    bool integrateKeyframe(int poseId, const Mat34& pose);
+
+    /// remove images of the keyframe (taken from the map again) and integrate them with newPose
+    bool reintegrateKeyframe(int poseId, const Mat34& pose, const Mat34& newPose);
+};
+}
+
+#endif // _TSDFBUILDER_H_
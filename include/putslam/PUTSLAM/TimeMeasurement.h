@@ -9,6 +9,8 @@ class TimeMeasurement {
 public:
 	std::vector<long> voTimes, mapTimes, mapAddNewPoseTimes, mapGetSensorPoseTimes, mapGetVisibleFeaturesTimes,
 			mapFindNearestFrameTimes, mapRemoveMapFeaturesTimes, mapMoveMapFeaturesToLCSTimes, mapMatchingTimes, mapAddMeasurementTimes;
+	// frontend stages (grab, feature detection, waiting for the pipeline)
+	std::vector<long> grabTimes, detectionTimes, pipelineWaitTimes;
 
 	void saveToFile() {
 		std::ofstream file("times.txt");
@@ -24,6 +26,9 @@ public:
 				<< "mapMoveMapFeaturesToLCSTimes" << "\t"
 				<< "mapMatchingTimes" << "\t"
 				<< "mapAddMeasurementTimes" << "\t"
+				<< "grabTimes" << "\t"
+				<< "detectionTimes" << "\t"
+				<< "pipelineWaitTimes" << "\t"
 				<< std::endl;
 
 		checkAndResizeVectors();
@@ -39,7 +44,10 @@ public:
 				<< mapRemoveMapFeaturesTimes[i] << "\t"
 				<< mapMoveMapFeaturesToLCSTimes[i] << "\t"
 				<< mapMatchingTimes[i] << "\t"
-				<< mapAddMeasurementTimes[i]
+				<< mapAddMeasurementTimes[i] << "\t"
+				<< grabTimes[i] << "\t"
+				<< detectionTimes[i] << "\t"
+				<< pipelineWaitTimes[i]
 					<< "\t" << std::endl;
 //			long a = (mapAddNewPoseTimes[i] + mapGetSensorPoseTimes[i]
 //					+ mapGetVisibleFeaturesTimes[i]
@@ -59,6 +67,9 @@ public:
 				<< average(mapMoveMapFeaturesToLCSTimes) <<"\t"
 				<< average(mapMatchingTimes) << "\t"
 				<< average(mapAddMeasurementTimes) << "\t"
+				<< average(grabTimes) << "\t"
+				<< average(detectionTimes) << "\t"
+				<< average(pipelineWaitTimes) << "\t"
 				<< std::endl;
 
 		file.close();
@@ -88,6 +99,9 @@ private:
 		mapMoveMapFeaturesToLCSTimes.resize(size, -1.0);
 		mapMatchingTimes.resize(size, -1.0);
 		mapAddMeasurementTimes.resize(size, -1.0);
+		grabTimes.resize(size, -1.0);
+		detectionTimes.resize(size, -1.0);
+		pipelineWaitTimes.resize(size, -1.0);
 	}
 };
 
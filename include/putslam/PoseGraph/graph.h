@@ -167,7 +167,7 @@ namespace putslam {
             /// Graph name
             const std::string name;
             /// mutex for critical section - graph
-            std::recursive_mutex mtxGraph;
+            putslam::RecursiveMutex mtxGraph{"Graph::mtxGraph"};
 
             /// Find vertex by id
             PoseGraph::VertexSet::iterator findVertex(unsigned int id){
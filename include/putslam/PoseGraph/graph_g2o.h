@@ -170,6 +170,14 @@ class PoseGraphG2O : public Graph {
         /// marginalize measurements (pose-feature)
         bool marginalize(const std::vector<int>& keyframes, const std::set<int>& features2remove);
 
+        /**
+         * marginalize poses and features measured only from these poses (Schur complement).
+         * Features measured also from the remaining poses stay in the graph, only their measurements
+         * from the marginalized poses are removed. The information is kept in the dense prior on the
+         * remaining vertices (Markov blanket). Ids of the marginalized features are returned in 'marginalizedFeatures'.
+         */
+        bool marginalizePoses(const std::vector<int>& posesIds, std::set<int>& marginalizedFeatures);
+
         /// Fix vertex
         void fixVertex(int vertexId);
 
@@ -185,23 +193,47 @@ class PoseGraphG2O : public Graph {
         /// erase edges related to the SE3 vertex
         void eraseMeasurements(int poseId);
 
+        /**
+         * set linear solver ("PCG", "CSparse", "Cholmod", "Eigen"), block solver ("X", "6_3")
+         * and optimization algorithm ("GaussNewton", "Levenberg")
+         * returns true, on success, or false on failure (previous solver is kept).
+         */
+        bool setSolver(const std::string& linearSolverName, const std::string& blockSolverName, const std::string& algorithmName);
+
+        /// returns name of the current solver (algorithm/linear solver/block solver)
+        const std::string& getSolverName(void) const;
+
+        /// set camera parameters used by the reprojection error edges
+        void setCameraParameters(double fu, double fv, double cu, double cv);
+
+        /**
+         * set incremental optimization: only vertices closer than 'neighbourhoodDepth' (edges) to the new vertices
+         * and to vertices which moved more than 'relinearizationThr' in the previous step are optimized,
+         * the rest of the graph is fixed. The whole graph is optimized every 'fullOptimizationPeriod' calls (0 - never)
+         */
+        void setIncrementalOptimization(bool enable, int neighbourhoodDepth, double relinearizationThr, int fullOptimizationPeriod);
+
     private:
         /// Pose graph
         PoseGraph bufferGraph;
-        /// g2o linear solver
-        g2o::BlockSolverX::LinearSolverType * linearSolver;
-        /// the linear solver
-        g2o::BlockSolverX* blockSolver;
+        /// the block solver (owned by the optimization algorithm)
+        g2o::Solver* blockSolver;
         /// the algorithm to carry out the optimization
-        g2o::OptimizationAlgorithmLevenberg* optimizationAlgorithm;
+        g2o::OptimizationAlgorithm* optimizationAlgorithm;
+        /// name of the current solver
+        std::string solverName;
+        /// marginalize features (Schur complement, required by fixed-size block solver)
+        bool marginalizeFeatures;
         /// the optimizer to load the data and carry out the optimization
         g2o::SparseOptimizer optimizer;
         /// g2o factory
         g2o::Factory* factory;
         /// mutex for critical section - buffer graph
-        std::recursive_mutex mtxBuffGraph;
+        putslam::RecursiveMutex mtxBuffGraph{"PoseGraphG2O::mtxBuffGraph"};
         /// camera offset
         g2o:: ParameterSE3Offset* cameraOffset;
+        /// camera parameters (reprojection error)
+        g2o::ParameterCamera* cameraParameters;
         /// set of new vertices
         g2o::HyperGraph::VertexSet newVertices;
         /// set of new vertices (after optimization they can be fixed)
@@ -218,6 +250,20 @@ class PoseGraphG2O : public Graph {
         Eigen::MatrixXd HessianInv;
         /// features to remove
         std::set<int> features2remove;
+        /// incremental optimization enabled
+        bool incrementalOpt;
+        /// the current optimization is incremental (only active part of the graph changes), reset after the result is copied
+        bool incrementalStep;
+        /// size of the optimized neighbourhood (number of edges from the new vertices)
+        int incrementalDepth;
+        /// vertices which moved more than threshold are optimized also in the next step
+        double relinearizationThr;
+        /// optimize whole graph every n-th optimization
+        int fullOptimizationPeriod;
+        /// number of incremental optimizations since last full optimization
+        int optimizationsSinceFull;
+        /// vertices which have to be relinearized in the next step (ids)
+        std::set<int> relinearizeVertices;
 
 
         /// Removes a vertex from the graph. Returns true on success
@@ -232,6 +278,9 @@ class PoseGraphG2O : public Graph {
          */
         bool updateGraph(void);
 
+        /// select edges optimized in the incremental step and vertices which bound the active part of the graph
+        void selectIncrementalSet(g2o::HyperGraph::EdgeSet& activeEdges, g2o::HyperGraph::VertexSet& activeVertices, g2o::HyperGraph::VertexSet& boundaryVertices);
+
         /// add vertex to g2o interface
         bool addVertexG2O(uint_fast32_t id, std::stringstream& vertex, Vertex::Type type);
 
@@ -310,6 +359,10 @@ class PoseGraphG2O : public Graph {
 
         /// Get Hessian
         void getHessian(Eigen::MatrixXd& hessian, const g2o::OptimizableGraph::VertexContainer& vertices);
+
+        /// create block solver of the required structure on top of the selected linear solver
+        template <typename BlockSolverType>
+        g2o::Solver* createBlockSolver(const std::string& linearSolverName);
 };
 
 #endif // GRAPH_G2O_H_INCLUDED
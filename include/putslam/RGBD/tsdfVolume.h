@@ -0,0 +1,98 @@
+/** @file tsdfVolume.h
+ *
+ * \brief Truncated signed distance field (TSDF) stored in the spatially hashed grid of voxel blocks
+ * blocks are allocated only near the observed surfaces, depth images are fused block-parallel (OpenMP)
+ * and the surface is extracted on demand with marching cubes
+ *
+ */
+#ifndef _TSDFVOLUME_H_
+#define _TSDFVOLUME_H_
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+#include "Defs/opencvCore.h"
+#include "Defs/eigen3.h"
+#include "Defs/putslam_defs.h"
+
+namespace putslam {
+
+/// TSDF volume (voxel hashing)
+class TSDFVolume {
+public:
+    class Config {
+    public:
+        Config() : voxelSize(0.01), truncation(0.04), maxDepth(4.0), maxWeight(100.0f), verbose(0) {}
+
+        /// size of the voxel [m]
+        double voxelSize;
+        /// truncation distance of the signed distance [m]
+        double truncation;
+        /// depth measurements further than maxDepth are not integrated [m]
+        double maxDepth;
+        /// max weight of the voxel (older measurements are slowly forgotten)
+        float maxWeight;
+        /// verbose
+        int verbose;
+    };
+
+    /// number of voxels along the edge of the block
+    static const int blockSize = 8;
+    static const int blockVoxelsNo = blockSize * blockSize * blockSize;
+
+    /// Construction
+    TSDFVolume(const Config& config);
+
+    /// integrate depth (and color) image acquired from the pose (camera in the world frame)
+    /// weight < 0 removes previously integrated image (exact if the voxel weights did not reach maxWeight)
+    void integrate(const cv::Mat& rgbImage, const cv::Mat& depthImage, const cv::Mat& cameraMatrix,
+            const Mat34& pose, double depthImageScale, float weight = 1.0f);
+
+    /// extract mesh with marching cubes (colors in RGB, triangles -- indices of vertices)
+    void extractMesh(std::vector<Eigen::Vector3f>& vertices, std::vector<Eigen::Vector3i>& colors,
+            std::vector<Eigen::Vector3i>& triangles) const;
+
+    /// extract mesh and save it to the PLY file
+    bool saveMesh(const std::string& filename) const;
+
+    /// number of allocated blocks
+    size_t getBlocksNo(void) const;
+
+    /// remove all blocks
+    void clear(void);
+
+private:
+    /// block of voxels (structure of arrays -- vectorized updates)
+    class Block {
+    public:
+        Block();
+        /// truncated signed distance (normalized to [-1,1])
+        float sdf[blockVoxelsNo];
+        /// weight (0 -- not observed)
+        float weight[blockVoxelsNo];
+        /// color (RGB)
+        uint8_t color[3][blockVoxelsNo];
+    };
+
+    /// configuration
+    Config config;
+
+    /// blocks (block coordinates -> block)
+    std::unordered_map<int64_t, Block> blocks;
+
+    /// key of the block
+    static int64_t blockKey(int x, int y, int z);
+
+    /// coordinates of the block
+    static void blockCoords(int64_t key, int& x, int& y, int& z);
+
+    /// update voxels of the block
+    void integrateBlock(int64_t key, Block& block, const std::vector<float>& depth, int cols, int rows,
+            const cv::Mat& rgbImage, const Eigen::Matrix3f& camMatrix, const Eigen::Matrix3f& rotInv,
+            const Eigen::Vector3f& transInv, float weight) const;
+};
+}
+
+#endif // _TSDFVOLUME_H_
@@ -9,6 +9,7 @@
 #define _RANSAC_H_
 
 #include "Grabber/depthSensorModel.h"
+#include "TransformEst/g2oEst.h"
 #include <iostream>
 #include <vector>
 #include "opencv/cv.h"
@@ -69,6 +70,9 @@ private:
 	cv::Mat cameraMatrix;
 	parameters RANSACParams;
 
+	/// transformation solver reused in all RANSAC iterations
+	putslam::G2OEst g2oEst;
+
     //TODO move it up (it shouldn't be here. The object is created and destroyed at each iteration of the matching procedure)
     //DepthSensorModel sensorModel;
 
@@ -1,6 +1,8 @@
 /** @file g2oEst.h
  *
  * g2o 4 trans estimation interface (transformation estimation)
+ * Gauss-Newton on SE(3) in the g2o pose parametrization (x, y, z, qx, qy, qz),
+ * features are eliminated analytically so the solver works on 6x6 normal equations only
  *
  */
 
@@ -8,7 +10,6 @@
 #define _G2OEST_H_
 
 #include "transformEst.h"
-#include "../PoseGraph/graph_g2o.h"
 #include <iostream>
 #include <memory>
 
@@ -30,13 +31,16 @@ namespace putslam {
             /// Construction
             G2OEst(void);
 
+            /// Construction (max number of Gauss-Newton iterations, stop criterion: norm of the pose increment)
+            G2OEst(int maxIterations, double minIncrement);
+
             /// Name of the Transformation estimator
             const std::string& getName() const;
 
-            /// compute transformation using two set of keypoints
+            /// compute transformation using two set of keypoints (Nx3, setB = T * setA, initial guess -- identity)
             Mat34& computeTransformation(const Eigen::MatrixXd& setA, const Eigen::MatrixXd& setB);
 
-            /// compute transformation using two set of keypoints
+            /// compute transformation using two set of keypoints and their uncertainty (transformation -- initial guess)
             Mat34& computeTransformation(const Eigen::MatrixXd& setA, std::vector<Mat33>& setAUncertainty, const Eigen::MatrixXd& setB, std::vector<Mat33>& setBUncertainty, Mat34& transformation);
 
             /// Compute uncertainty matrix [6x6] (fi,psi,theta,x,y,z)
@@ -66,8 +70,23 @@ namespace putslam {
         private:
             /// Tracker name
             const std::string name;
-            /// g2o graph
-            PoseGraphG2O graph;
+            /// max number of Gauss-Newton iterations
+            int maxIterations;
+            /// stop criterion (norm of the pose increment)
+            double minIncrement;
+            /// information matrices of the residuals (buffer reused between calls)
+            std::vector<Mat33> residualInfo;
+            /// hessian of the last iteration (pose increment x, y, z, qx, qy, qz)
+            Mat66 hessian;
+
+            /// compute information matrices of the residuals T*a_i - b_i (identity if uncertainty is not provided)
+            void computeResidualInfo(size_t pointsNo, const std::vector<Mat33>* setAUncertainty, const std::vector<Mat33>* setBUncertainty, const Mat34& pose);
+
+            /// compute hessian and gradient of the cost function, returns cost
+            double computeNormalEquations(const Eigen::MatrixXd& setA, const Eigen::MatrixXd& setB, const Mat34& pose, Mat66& H, Eigen::Matrix<double,6,1>& g) const;
+
+            /// Gauss-Newton iterations, returns false if the normal equations are singular
+            bool optimize(const Eigen::MatrixXd& setA, const std::vector<Mat33>* setAUncertainty, const Eigen::MatrixXd& setB, const std::vector<Mat33>* setBUncertainty, Mat34& pose);
     };
 };
 
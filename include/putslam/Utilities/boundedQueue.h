@@ -0,0 +1,75 @@
+/** @file boundedQueue.h
+ *
+ * Bounded blocking FIFO queue -- connects stages of the pipeline
+ * push blocks if the queue is full, pop blocks if the queue is empty, close wakes up all waiting threads
+ *
+ */
+
+#ifndef _BOUNDEDQUEUE_H_
+#define _BOUNDEDQUEUE_H_
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+/// Bounded blocking queue
+template<typename T>
+class BoundedQueue {
+public:
+    BoundedQueue(size_t _capacity = 1) : capacity(_capacity > 0 ? _capacity : 1), closed(false) {
+    }
+
+    /// insert element (waits for free space), returns false if the queue is closed
+    bool push(const T& element) {
+        std::unique_lock<std::mutex> lock(mtx);
+        notFull.wait(lock, [this]() {return queue.size() < capacity || closed;});
+        if (closed)
+            return false;
+        queue.push_back(element);
+        lock.unlock();
+        notEmpty.notify_one();
+        return true;
+    }
+
+    /// take the first element (waits for element), returns false if the queue is closed and empty
+    bool pop(T& element) {
+        std::unique_lock<std::mutex> lock(mtx);
+        notEmpty.wait(lock, [this]() {return !queue.empty() || closed;});
+        if (queue.empty())
+            return false;
+        element = queue.front();
+        queue.pop_front();
+        lock.unlock();
+        notFull.notify_one();
+        return true;
+    }
+
+    /// no more elements will be inserted (remaining elements can be taken)
+    void close() {
+        mtx.lock();
+        closed = true;
+        mtx.unlock();
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return queue.size();
+    }
+
+private:
+    /// max number of elements
+    size_t capacity;
+    /// queue is closed
+    bool closed;
+    /// elements
+    std::deque<T> queue;
+    /// mutex for the queue
+    std::mutex mtx;
+    /// queue events
+    std::condition_variable notEmpty, notFull;
+};
+
+#endif // _BOUNDEDQUEUE_H_
@@ -0,0 +1,185 @@
+/** @file instrumentedMutex.h
+ *
+ * Mutexes which collect acquisition count, wait time and hold time per named lock
+ * statistics are collected if PUTSLAM_LOCK_STATS is defined (cmake option), otherwise Mutex is std::mutex
+ *
+ */
+
+#ifndef _INSTRUMENTEDMUTEX_H_
+#define _INSTRUMENTEDMUTEX_H_
+
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+
+namespace putslam {
+
+/// Statistics of the lock [ns]
+class LockStats {
+public:
+    LockStats(const std::string& _name) : name(_name), acquisitions(0), contended(0), waitTime(0), holdTime(0),
+        maxWaitTime(0), maxHoldTime(0) {
+    }
+
+    /// update max value
+    static void updateMax(std::atomic<uint64_t>& max, uint64_t value) {
+        uint64_t current = max.load(std::memory_order_relaxed);
+        while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed));
+    }
+
+    /// name of the lock
+    std::string name;
+    /// number of acquisitions and acquisitions which had to wait
+    std::atomic<uint64_t> acquisitions, contended;
+    /// total and max wait/hold time
+    std::atomic<uint64_t> waitTime, holdTime, maxWaitTime, maxHoldTime;
+};
+
+/// Statistics of all instrumented locks
+class LockStatsRegistry {
+public:
+    /// the instance
+    static LockStatsRegistry& get(void) {
+        static LockStatsRegistry registry;
+        return registry;
+    }
+
+    /// statistics of the lock (locks with the same name share statistics)
+    LockStats* getStats(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto& lockStats : stats) {
+            if (lockStats->name == name)
+                return lockStats.get();
+        }
+        stats.push_back(std::unique_ptr<LockStats>(new LockStats(name)));
+        return stats.back().get();
+    }
+
+    /// print statistics (times in ms)
+    void print(std::ostream& os) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        os << "Locks: name, acquisitions, contended, wait total, wait max, hold total, hold max [ms]\n";
+        for (auto& lockStats : stats) {
+            os << lockStats->name << "\t" << lockStats->acquisitions << "\t" << lockStats->contended << "\t"
+                    << (double) lockStats->waitTime / 1e6 << "\t" << (double) lockStats->maxWaitTime / 1e6 << "\t"
+                    << (double) lockStats->holdTime / 1e6 << "\t" << (double) lockStats->maxHoldTime / 1e6 << "\n";
+        }
+    }
+
+    /// save statistics to the CSV file (times in us)
+    bool saveCSV(const std::string& filename) const {
+        std::ofstream file(filename);
+        if (!file.is_open()) {
+            std::cerr << "LockStatsRegistry: unable to open " << filename << "\n";
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        file << "lock,acquisitions,contended,wait_us,max_wait_us,hold_us,max_hold_us\n";
+        for (auto& lockStats : stats) {
+            file << lockStats->name << "," << lockStats->acquisitions << "," << lockStats->contended << ","
+                    << (double) lockStats->waitTime / 1e3 << "," << (double) lockStats->maxWaitTime / 1e3 << ","
+                    << (double) lockStats->holdTime / 1e3 << "," << (double) lockStats->maxHoldTime / 1e3 << "\n";
+        }
+        return true;
+    }
+
+private:
+    /// statistics of locks
+    std::vector<std::unique_ptr<LockStats>> stats;
+    /// mutex for critical section - stats
+    mutable std::mutex mtx;
+};
+
+#ifdef PUTSLAM_LOCK_STATS
+/// Mutex which collects statistics (MutexT -- std::mutex or std::recursive_mutex)
+template<typename MutexT>
+class InstrumentedMutex {
+public:
+    InstrumentedMutex(const char* name = "unnamed") : stats(LockStatsRegistry::get().getStats(name)), depth(0), lockTime(0) {
+    }
+
+    /// set name of the lock (before the lock is used)
+    void setName(const char* name) {
+        stats = LockStatsRegistry::get().getStats(name);
+    }
+
+    void lock() {
+        if (!mutex.try_lock()) {
+            uint64_t start = now();
+            mutex.lock();
+            uint64_t wait = now() - start;
+            stats->contended.fetch_add(1, std::memory_order_relaxed);
+            stats->waitTime.fetch_add(wait, std::memory_order_relaxed);
+            LockStats::updateMax(stats->maxWaitTime, wait);
+        }
+        acquired();
+    }
+
+    bool try_lock() {
+        if (!mutex.try_lock())
+            return false;
+        acquired();
+        return true;
+    }
+
+    void unlock() {
+        // hold time of the outermost lock (recursive mutex), depth and lockTime are used only by the owner
+        if (--depth == 0) {
+            uint64_t hold = now() - lockTime;
+            stats->holdTime.fetch_add(hold, std::memory_order_relaxed);
+            LockStats::updateMax(stats->maxHoldTime, hold);
+        }
+        mutex.unlock();
+    }
+
+private:
+    /// the lock was taken (nested locks of the recursive mutex are not counted)
+    void acquired() {
+        if (depth++ == 0) {
+            stats->acquisitions.fetch_add(1, std::memory_order_relaxed);
+            lockTime = now();
+        }
+    }
+
+    /// time [ns]
+    static uint64_t now() {
+        return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /// mutex
+    MutexT mutex;
+    /// statistics
+    LockStats* stats;
+    /// number of nested locks (recursive mutex)
+    int depth;
+    /// time of the outermost lock
+    uint64_t lockTime;
+};
+#else
+/// Mutex without statistics (names are ignored)
+template<typename MutexT>
+class InstrumentedMutex : public MutexT {
+public:
+    InstrumentedMutex(const char* = "") {
+    }
+
+    void setName(const char*) {
+    }
+};
+#endif
+
+/// mutex (instrumented if PUTSLAM_LOCK_STATS is defined)
+typedef InstrumentedMutex<std::mutex> Mutex;
+
+/// recursive mutex (instrumented if PUTSLAM_LOCK_STATS is defined)
+typedef InstrumentedMutex<std::recursive_mutex> RecursiveMutex;
+}
+
+#endif // _INSTRUMENTEDMUTEX_H_
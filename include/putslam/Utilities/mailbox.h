@@ -0,0 +1,47 @@
+/** @file mailbox.h
+ *
+ * Latest-value mailbox -- connects a producer with a slower consumer
+ * publish overwrites the previous (not taken) value, the producer never waits for the consumer
+ *
+ */
+
+#ifndef _MAILBOX_H_
+#define _MAILBOX_H_
+
+#include <mutex>
+
+/// Latest-value mailbox
+template<typename T>
+class Mailbox {
+public:
+    Mailbox() : full(false) {
+    }
+
+    /// put the value (replaces the value which was not taken)
+    void publish(const T& _value) {
+        mtx.lock();
+        value = _value;
+        full = true;
+        mtx.unlock();
+    }
+
+    /// take the latest value, returns false if nothing new was published
+    bool take(T& _value) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!full)
+            return false;
+        _value = value;
+        full = false;
+        return true;
+    }
+
+private:
+    /// the latest value
+    T value;
+    /// new value is waiting
+    bool full;
+    /// mutex for the value
+    std::mutex mtx;
+};
+
+#endif // _MAILBOX_H_
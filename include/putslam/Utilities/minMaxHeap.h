@@ -0,0 +1,156 @@
+/** @file minMaxHeap.h
+ *
+ * Bounded min-max heap (Atkinson et al.) -- double-ended priority queue
+ * the largest and the smallest element are accessible in O(1), push and pop in O(log n)
+ * if the capacity is reached the smallest element is removed, so the heap keeps the best 'capacity' elements
+ *
+ */
+
+#ifndef _MINMAXHEAP_H_
+#define _MINMAXHEAP_H_
+
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <cstddef>
+
+/// Bounded min-max heap (capacity 0 -- unbounded), Compare is 'less than'
+template<typename T, typename Compare = std::less<T>>
+class MinMaxHeap {
+public:
+    MinMaxHeap(size_t _capacity = 0, const Compare& _less = Compare()) : capacity(_capacity), less(_less) {
+    }
+
+    /// set max number of elements (the smallest elements are removed)
+    void setCapacity(size_t _capacity) {
+        capacity = _capacity;
+        while (capacity > 0 && heap.size() > capacity)
+            popMin();
+    }
+
+    /// max number of elements (0 -- unbounded)
+    size_t getCapacity() const {return capacity;}
+
+    size_t size() const {return heap.size();}
+
+    bool empty() const {return heap.empty();}
+
+    void clear() {heap.clear();}
+
+    /// insert element, returns false if the heap is full and the element is not larger than the smallest one
+    bool push(const T& element) {
+        if (capacity > 0 && heap.size() >= capacity) {
+            if (!less(heap[0], element))
+                return false;
+            popMin();
+        }
+        heap.push_back(element);
+        bubbleUp(heap.size() - 1);
+        return true;
+    }
+
+    /// the largest element
+    const T& top() const {return heap[maxIndex()];}
+
+    /// the smallest element
+    const T& bottom() const {return heap[0];}
+
+    /// remove the largest element
+    void pop() {
+        size_t idx = maxIndex();
+        heap[idx] = heap.back();
+        heap.pop_back();
+        if (idx < heap.size())
+            trickleDown(idx);
+    }
+
+    /// remove the smallest element
+    void popMin() {
+        heap[0] = heap.back();
+        heap.pop_back();
+        if (!heap.empty())
+            trickleDown(0);
+    }
+
+private:
+    /// max number of elements
+    size_t capacity;
+    /// comparison
+    Compare less;
+    /// elements (even levels -- min levels, odd levels -- max levels)
+    std::vector<T> heap;
+
+    /// is element on a min level
+    static bool isMinLevel(size_t idx) {
+        size_t level = 0;
+        for (idx++; idx > 1; idx >>= 1)
+            level++;
+        return (level % 2) == 0;
+    }
+
+    /// index of the largest element
+    size_t maxIndex() const {
+        if (heap.size() < 3)
+            return heap.size() - 1;
+        return less(heap[1], heap[2]) ? 2 : 1;
+    }
+
+    void bubbleUp(size_t idx) {
+        if (idx == 0)
+            return;
+        size_t parent = (idx - 1) / 2;
+        if (isMinLevel(idx)) {
+            if (less(heap[parent], heap[idx])) {
+                std::swap(heap[idx], heap[parent]);
+                bubbleUpLevel(parent, true);
+            }
+            else
+                bubbleUpLevel(idx, false);
+        }
+        else {
+            if (less(heap[idx], heap[parent])) {
+                std::swap(heap[idx], heap[parent]);
+                bubbleUpLevel(parent, false);
+            }
+            else
+                bubbleUpLevel(idx, true);
+        }
+    }
+
+    /// move element up through grandparents (max levels if maxLevel is set)
+    void bubbleUpLevel(size_t idx, bool maxLevel) {
+        while (idx > 2) {
+            size_t grandparent = ((idx - 1) / 2 - 1) / 2;
+            bool swap = maxLevel ? less(heap[grandparent], heap[idx]) : less(heap[idx], heap[grandparent]);
+            if (!swap)
+                break;
+            std::swap(heap[idx], heap[grandparent]);
+            idx = grandparent;
+        }
+    }
+
+    void trickleDown(size_t idx) {
+        bool maxLevel = !isMinLevel(idx);
+        while (2 * idx + 1 < heap.size()) {
+            // the smallest (largest on max level) of children and grandchildren
+            size_t best = 2 * idx + 1;
+            size_t candidates[5] = {2 * idx + 2, 4 * idx + 3, 4 * idx + 4, 4 * idx + 5, 4 * idx + 6};
+            for (size_t i = 0; i < 5 && candidates[i] < heap.size(); i++)
+                if (maxLevel ? less(heap[best], heap[candidates[i]]) : less(heap[candidates[i]], heap[best]))
+                    best = candidates[i];
+            if (!(maxLevel ? less(heap[idx], heap[best]) : less(heap[best], heap[idx])))
+                break;
+            std::swap(heap[idx], heap[best]);
+            // child -- done
+            if (best <= 2 * idx + 2)
+                break;
+            // grandchild -- restore order with its parent and continue
+            size_t parent = (best - 1) / 2;
+            if (maxLevel ? less(heap[best], heap[parent]) : less(heap[parent], heap[best]))
+                std::swap(heap[best], heap[parent]);
+            idx = best;
+        }
+    }
+};
+
+#endif // _MINMAXHEAP_H_
@@ -11,7 +11,7 @@ class Observer
 public:
     virtual void update(putslam::MapModifier& mapModifier) = 0;
     virtual void update(const cv::Mat& color, const cv::Mat& depth, int frameNo) = 0;
-    virtual void update(std::vector<putslam::Edge>& features) = 0;
+    virtual void update(std::vector<putslam::Edge3D>& features) = 0;
 };
 
 class Subject
@@ -24,7 +24,7 @@ public:
     void detach(Observer *observer);
     void notify(putslam::MapModifier& mapModifier);
     void notify(const cv::Mat& color, const cv::Mat& depth, int frameNo);
-    void notify(std::vector<putslam::Edge>& features);
+    void notify(std::vector<putslam::Edge3D>& features);
 };
 
 #endif // OBSERVER_H_
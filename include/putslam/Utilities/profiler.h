@@ -0,0 +1,175 @@
+/** @file profiler.h
+ *
+ * Low-overhead instrumentation of processing stages
+ * scoped timers can be used in any thread, latencies are stored in lock-free histograms (p50/p95/p99 available live)
+ * and optionally as events in per-thread buffers (export to CSV and Chrome trace JSON -- chrome://tracing, Perfetto)
+ *
+ */
+
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <atomic>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <iostream>
+#include <cstdint>
+
+namespace putslam {
+
+/// Profiler (single instance shared by all subsystems)
+class Profiler {
+public:
+    /// max number of registered stages
+    static const int maxStagesNo = 256;
+
+    /// histogram: linear buckets below 8 us, then 8 buckets per octave (relative error < 6.25%)
+    static const int bucketsNo = 8 + 37 * 8;
+
+    /// statistics of the stage [us]
+    class Stats {
+    public:
+        std::string name;
+        uint64_t count;
+        double mean, p50, p95, p99, max;
+    };
+
+    /// the instance
+    static Profiler& get(void);
+
+    /// register stage (the same name -- the same id)
+    int registerStage(const std::string& name);
+
+    /// enable recording (histograms), trace -- store events for the trace export too
+    void setEnabled(bool enabled, bool trace = false, size_t eventsPerThread = 1 << 18);
+
+    /// recording enabled?
+    inline bool isEnabled(void) const {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    /// name of the current thread (trace)
+    void setThreadName(const std::string& name);
+
+    /// time since the start of the profiler [us]
+    inline int64_t now(void) const {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    /// record the stage executed in [start, end] [us]
+    void record(int stageId, int64_t start, int64_t end);
+
+    /// percentile of the stage duration (p in [0,1]) [us]
+    double percentile(int stageId, double p) const;
+
+    /// statistics of stages
+    std::vector<Stats> getStats(void) const;
+
+    /// print statistics
+    void printStats(std::ostream& os) const;
+
+    /// save statistics (stage, count, mean, p50, p95, p99, max [us])
+    bool saveCSV(const std::string& filename) const;
+
+    /// save events in the Chrome trace format
+    bool saveTrace(const std::string& filename) const;
+
+private:
+    /// Construction
+    Profiler(void);
+
+    /// latency histogram of the stage (updated concurrently)
+    class Histogram {
+    public:
+        Histogram();
+        std::atomic<uint64_t> buckets[bucketsNo];
+        std::atomic<uint64_t> count, sum, max;
+    };
+
+    /// executed stage
+    class Event {
+    public:
+        int stageId;
+        int64_t start, end;
+    };
+
+    /// events of the thread (written only by the owner, size is published after the event is stored,
+    /// the buffer is allocated when the first event is stored)
+    class ThreadEvents {
+    public:
+        ThreadEvents(int _threadNo);
+        int threadNo;
+        std::string name;
+        std::unique_ptr<Event[]> events;
+        size_t capacity;
+        std::atomic<size_t> size;
+        std::atomic<uint64_t> dropped;
+    };
+
+    /// bucket of the duration
+    static int bucket(uint64_t duration);
+
+    /// mean duration of the bucket
+    static double bucketValue(int bucketNo);
+
+    /// events of the current thread
+    ThreadEvents* threadEvents(void);
+
+    /// percentile computed from the histogram
+    double percentile(const Histogram& histogram, double p) const;
+
+    /// recording flags
+    std::atomic<bool> enabled, trace;
+
+    /// size of the event buffer of the thread (allocated on the first stored event)
+    size_t eventsPerThread;
+
+    /// time reference
+    std::chrono::steady_clock::time_point startTime;
+
+    /// histograms of stages
+    std::unique_ptr<Histogram[]> histograms;
+
+    /// names of stages
+    std::vector<std::string> stagesNames;
+
+    /// mutex for critical section - stages
+    mutable std::mutex mtxStages;
+
+    /// buffers of threads (kept after the thread finished)
+    std::vector<std::unique_ptr<ThreadEvents>> threads;
+
+    /// mutex for critical section - threads
+    mutable std::mutex mtxThreads;
+};
+
+/// Scoped timer -- records the stage when the scope ends
+class ProfileScope {
+public:
+    ProfileScope(int _stageId) : stageId(_stageId),
+        start(Profiler::get().isEnabled() ? Profiler::get().now() : -1) {
+    }
+
+    ~ProfileScope() {
+        if (start >= 0)
+            Profiler::get().record(stageId, start, Profiler::get().now());
+    }
+
+private:
+    int stageId;
+    int64_t start;
+};
+}
+
+#define PUTSLAM_PROFILE_CONCAT_(a, b) a##b
+#define PUTSLAM_PROFILE_CONCAT(a, b) PUTSLAM_PROFILE_CONCAT_(a, b)
+
+/// measure the rest of the scope as the stage 'name' (the stage is registered once)
+#define PUTSLAM_PROFILE(name) \
+    static const int PUTSLAM_PROFILE_CONCAT(profileStage, __LINE__) = putslam::Profiler::get().registerStage(name); \
+    putslam::ProfileScope PUTSLAM_PROFILE_CONCAT(profileScope, __LINE__)(PUTSLAM_PROFILE_CONCAT(profileStage, __LINE__))
+
+#endif // _PROFILER_H_
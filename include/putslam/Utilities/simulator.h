@@ -6,6 +6,7 @@
 
 #include <iostream>
 #include <vector>
+#include <random>
 #include "Defs/putslam_defs.h"
 #include "Grabber/depthSensorModel.h"
 
@@ -15,7 +16,22 @@ class Simulator
 {
 public:
 
+    /// Parameters of the synthetic sequence (generateSequence)
+    class SequenceConfig {
+    public:
+        SequenceConfig(void) : odometryNoiseTrans(0.005), odometryNoiseRot(0.002), threadsNo(0), batchSize(64) {
+        }
+        /// noise of the odometry between consecutive poses [m], [rad] (std dev)
+        double odometryNoiseTrans, odometryNoiseRot;
+        /// number of threads (0 - number of cores)
+        int threadsNo;
+        /// number of poses generated in parallel before they are saved
+        size_t batchSize;
+    };
+
     Simulator(void);
+    /// construction with fixed seed (repeatable sequences)
+    Simulator(unsigned int seed);
     ~Simulator(){}
 
     /// create environment -- room(walls,floor, ceiling)
@@ -24,8 +40,14 @@ public:
     void createEnvironment(size_t pointsNo, double width, double length, double height);
     /// load environment from file
     void loadEnvironment(std::string filename);
-    /// run experiment and return a sequence of point clouds
-    void moveCamera(const std::vector<Mat34>& robotTrajectory, const Mat34 sensorPose, DepthSensorModel& sensorModel, std::vector<PointCloud>& cloudSeq, std::vector< std::vector<int> >& setIds, std::vector< std::vector<Mat33> >& uncertaintySet);
+    /// build spatial index of the environment (uniform grid), getCloud checks only cells inside the view frustum
+    void buildIndex(double cellSize = 0.5);
+    /// run experiment and return a sequence of point clouds (poses are processed in parallel, threadsNo = 0 - number of cores)
+    void moveCamera(const std::vector<Mat34>& robotTrajectory, const Mat34 sensorPose, DepthSensorModel& sensorModel, std::vector<PointCloud>& cloudSeq, std::vector< std::vector<int> >& setIds, std::vector< std::vector<Mat33> >& uncertaintySet, int threadsNo = 0);
+    /// generate measurements along the trajectory and save the measurement stream and the graph (g2o format, PoseGraphG2O::load)
+    bool generateSequence(const std::vector<Mat34>& robotTrajectory, const Mat34& sensorPose, const DepthSensorModel& sensorModel, const std::string& measurementsFilename, const std::string& graphFilename, const SequenceConfig& sequenceConfig = SequenceConfig());
+    /// save environment (feature id, x, y, z)
+    bool saveEnvironment(const std::string& filename) const;
     /// get environment
     PointCloud& getEnvironment(void);
     /// match point clouds
@@ -40,11 +62,38 @@ public:
     std::vector<Mat34>& getTrajectory(void);
 
 private:
+    /// Uniform grid over the environment, ids of points are sorted by cells
+    class SpatialIndex {
+    public:
+        SpatialIndex(void) : cellSize(0) {
+        }
+        /// min corner of the grid
+        Eigen::Vector3d origin;
+        /// size of the cell [m]
+        double cellSize;
+        /// number of cells along x, y, z
+        int cellsNo[3];
+        /// ids of points of the cell i: pointIds[cellStart[i]] ... pointIds[cellStart[i+1]-1]
+        std::vector<size_t> cellStart;
+        std::vector<int> pointIds;
+    };
+
     /// samples from multivariate gaussian
-    Point3D sampleFromMultivariateGaussian(Eigen::Vector3d mean, Eigen::MatrixXd cov);
+    Point3D sampleFromMultivariateGaussian(Eigen::Vector3d mean, Eigen::MatrixXd cov, std::default_random_engine& randomEngine);
+
+    /// get point cloud from current camera view using the given random engine
+    std::vector<int> getCloud(const Mat34& sensorPose, DepthSensorModel& sensorModel, PointCloud& setPoints, std::vector<Mat33>& setUncertainty, std::default_random_engine& randomEngine);
+
+    /// ids of points which are potentially visible (sorted), all points if the index is not built
+    void getCandidates(const Mat34& sensorPose, const Mat34& sensorPoseInv, const DepthSensorModel& sensorModel, std::vector<int>& candidates) const;
+
+    /// get point clouds from sensor poses in parallel (random engine of the pose is initialized with the seed of the pose)
+    void getClouds(const std::vector<Mat34>& sensorPoses, const DepthSensorModel& sensorModel, const std::vector<unsigned int>& seeds, std::vector<PointCloud>& cloudSeq, std::vector< std::vector<int> >& setIds, std::vector< std::vector<Mat33> >& uncertaintySet, int threadsNo);
 
     /// simulation environment
     PointCloud environment;
+    /// spatial index of the environment
+    SpatialIndex index;
     ///random engine
     std::default_random_engine generator;
     /// trajectory
@@ -0,0 +1,128 @@
+/** @file trajectoryEvaluation.h
+ *
+ * Trajectory accuracy -- ATE and RPE computed as in the TUM RGB-D benchmark (evaluate_ate.py, evaluate_rpe.py)
+ * timestamps association, alignment of trajectories (Umeyama), relative pose errors computed in parallel
+ *
+ */
+
+#ifndef _TRAJECTORYEVALUATION_H_
+#define _TRAJECTORYEVALUATION_H_
+
+#include "Defs/putslam_defs.h"
+#include <string>
+#include <vector>
+#include <iostream>
+
+namespace putslam {
+
+/// Evaluation of the estimated trajectory
+class TrajectoryEvaluator {
+public:
+    /// Pose with timestamp
+    class StampedPose {
+    public:
+        StampedPose(void) : timestamp(0), pose(Mat34::Identity()) {
+        }
+        StampedPose(double _timestamp, const Mat34& _pose) : timestamp(_timestamp), pose(_pose) {
+        }
+        double timestamp;
+        Mat34 pose;
+    };
+
+    /// Trajectory (sorted by timestamps)
+    typedef std::vector<StampedPose> Trajectory;
+
+    /// Statistics of errors
+    class ErrorStats {
+    public:
+        ErrorStats(void) : count(0), rmse(0), mean(0), median(0), stdDev(0), min(0), max(0) {
+        }
+        /// compute statistics (errors are sorted)
+        static ErrorStats compute(std::vector<double>& errors);
+
+        size_t count;
+        double rmse, mean, median, stdDev, min, max;
+    };
+
+    /// Absolute trajectory error
+    class ATEResult {
+    public:
+        /// translational errors after alignment [m]
+        ErrorStats translational;
+        /// transformation which aligns the estimated trajectory to the ground truth
+        Mat34 alignment;
+        /// associated poses (ground truth id, estimated pose id)
+        std::vector<std::pair<size_t, size_t>> associations;
+    };
+
+    /// Relative pose error
+    class RPEResult {
+    public:
+        /// translational errors [m]
+        ErrorStats translational;
+        /// rotational errors [rad]
+        ErrorStats rotational;
+    };
+
+    /// Evaluation parameters (defaults as in the TUM scripts)
+    class Config {
+    public:
+        Config(void) : maxDifference(0.02), offset(0.0), scale(1.0), delta(1.0), deltaUnit('s'),
+            fixedDelta(false), maxPairs(10000), threadsNo(0) {
+        }
+        /// max time difference of associated poses [s]
+        double maxDifference;
+        /// time offset added to the estimated trajectory [s]
+        double offset;
+        /// scale of the estimated trajectory
+        double scale;
+        /// RPE: delta between poses
+        double delta;
+        /// RPE: unit of delta ('s' - seconds, 'm' - meters, 'r' - radians, 'f' - frames)
+        char deltaUnit;
+        /// RPE: only pairs of poses separated by delta (otherwise all pairs)
+        bool fixedDelta;
+        /// RPE: max number of pairs (randomly sampled, 0 - all pairs)
+        size_t maxPairs;
+        /// number of threads (0 - number of cores)
+        int threadsNo;
+    };
+
+    /// Construction
+    TrajectoryEvaluator(void);
+
+    /// Construction
+    TrajectoryEvaluator(const Config& _config);
+
+    /// load trajectory (Freiburg format: timestamp x y z qx qy qz qw)
+    static bool loadTrajectory(const std::string& filename, Trajectory& trajectory);
+
+    /// associate timestamps (the closest pairs first), returns pairs of ids sorted by the first trajectory
+    std::vector<std::pair<size_t, size_t>> associate(const Trajectory& first, const Trajectory& second) const;
+
+    /// compute ATE (translational error after alignment)
+    bool computeATE(const Trajectory& groundtruth, const Trajectory& estimated, ATEResult& result) const;
+
+    /// compute RPE
+    bool computeRPE(const Trajectory& groundtruth, const Trajectory& estimated, RPEResult& result) const;
+
+    /// print ATE (format of evaluate_ate.py --verbose)
+    static void printATE(std::ostream& os, const ATEResult& result);
+
+    /// print RPE (format of evaluate_rpe.py --verbose)
+    static void printRPE(std::ostream& os, const RPEResult& result);
+
+    /// evaluate trajectory from file and save ATE and RPE to files
+    bool evaluate(const Trajectory& groundtruth, const std::string& estimatedFilename, const std::string& ateFilename,
+            const std::string& rpeFilename) const;
+
+    /// parameters
+    Config config;
+
+private:
+    /// number of threads
+    int getThreadsNo(void) const;
+};
+}
+
+#endif // _TRAJECTORYEVALUATION_H_
@@ -0,0 +1,68 @@
+/** @file chowliutreebuilder.hpp
+ *
+ * Out-of-core Chow-Liu tree training for FAB-MAP
+ * BOW descriptors are added in chunks and only word occurrence and pairwise co-occurrence counts are kept
+ * (memory does not depend on the number of training images), counts are accumulated in parallel
+ * the maximum spanning tree is found with Prim's algorithm on the dense mutual information graph
+ * (mutual information is computed on the fly, the edge list is not stored)
+ * output is the same as of2::ChowLiuTree::make (4 x |v| matrix loaded by generateFABMAPInstance)
+ *
+ */
+
+#ifndef CHOWLIUTREEBUILDER_H_
+#define CHOWLIUTREEBUILDER_H_
+
+#include "opencv2/core/core.hpp"
+
+#include <vector>
+#include <cstdint>
+
+namespace of2 {
+
+class CV_EXPORTS ChowLiuTreeBuilder {
+public:
+    /// wordsNo - size of the vocabulary, co-occurrence table needs wordsNo * (wordsNo - 1) / 2 counters
+    ChowLiuTreeBuilder(int wordsNo);
+    virtual ~ChowLiuTreeBuilder();
+
+    /// add chunk of BOW descriptors (#imgs x #words, word is observed if value > 0)
+    void add(const cv::Mat& imgDescriptors);
+
+    /// number of images added so far
+    uint64_t getImagesNo() const {return imagesNo;}
+
+    /// build the Chow-Liu tree, returns 4 x |v| matrix, where (0,q) is parent (p) index,
+    /// (1,q) is P(q), (2,q) is P(q|p), (3,q) is P(q|~p)
+    cv::Mat make() const;
+
+private:
+    /// number of words
+    int wordsNo;
+    /// number of images
+    uint64_t imagesNo;
+    /// number of images in which the word was observed
+    std::vector<uint64_t> occurrences;
+    /// number of images in which both words were observed (upper triangle, row-major)
+    std::vector<uint32_t> cooccurrences;
+
+    /// index of the pair (word1 < word2) in the co-occurrence table
+    inline size_t pairIndex(int word1, int word2) const {
+        return (size_t)word1 * (size_t)(2 * wordsNo - word1 - 1) / 2 + (size_t)(word2 - word1 - 1);
+    }
+
+    /// number of images in which both words were observed
+    uint64_t cooccurrence(int word1, int word2) const;
+
+    /// smoothed marginal probability P(z_a)
+    double P(int word, bool observed) const;
+
+    /// mutual information between words
+    double mutualInfo(int word1, int word2) const;
+
+    /// smoothed conditional probability P(z_a | z_b)
+    double CP(int wordA, bool observedA, int wordB, bool observedB) const;
+};
+
+} // namespace of2
+
+#endif /* CHOWLIUTREEBUILDER_H_ */
@@ -169,6 +169,9 @@ public:
     const std::vector<cv::Mat>& getTestImgDescriptors() const;
     //@}
 
+    /// Size of the vocabulary (number of words in the Chow Liu tree)
+    int vocabSize() const {return clTree->cols;}
+
     //@{ Image comparisons
     ///
     /// \brief FabMap image comparison (not full localization).
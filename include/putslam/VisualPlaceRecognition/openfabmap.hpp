@@ -58,6 +58,8 @@
 #include "fabmap.hpp"
 #include "bowmsctrainer.hpp"
 #include "chowliutree.hpp"
+#include "chowliutreebuilder.hpp"
+#include "vocabularytree.hpp"
 // TODO: Integrate MSC KD-Tree trainer
 //#include "msckd.h"
 
@@ -3,8 +3,10 @@
 #include <VisualPlaceRecognition/openfabmap.hpp>
 
 
-of2::FabMap *generateFABMAPInstance(cv::FileStorage &settings);
+/// create FabMap, version (FABMAP1, FABMAPLUT, FABMAPFBO, FABMAP2) overrides openFabMapOptions/FabMapVersion, FABMAP2 by default
+of2::FabMap *generateFABMAPInstance(cv::FileStorage &settings, const std::string& version = "");
 int openFABMAP(std::string testPath, of2::FabMap *fabmap, std::string vocabPath, std::string resultsPath, bool addNewOnly);
 
 cv::Ptr<cv::DescriptorExtractor> generateExtractor(cv::FileStorage &fs);
 cv::Ptr<cv::FeatureDetector> generateDetector(cv::FileStorage &fs);
+cv::Ptr<cv::ORB> generateORB(cv::FileStorage &fs);
@@ -19,12 +19,18 @@ public:
     // minimum probability to declare successful loop closure
     // if the probability value for the query frame is below this threshold, it is added as a new, unvisited place
     double_t minNewPlaceProb;
-    // constructor/initializer
-    VisualPlaceRecognition(uint32_t minFeatures, uint32_t tailFramesToSkip, double_t minNewPlaceProb);
+    // constructor/initializer, fabMapVersion (FABMAP1, FABMAPLUT, FABMAPFBO, FABMAP2) overrides settings file
+    VisualPlaceRecognition(uint32_t minFeatures, uint32_t tailFramesToSkip, double_t minNewPlaceProb, const std::string& fabMapVersion = "");
     // destructor
     ~VisualPlaceRecognition();
     // find most similar place, return pairs of Ids and probabilities (if prob is above threshold), add new point (forced or based on criteria)
     std::vector<std::pair<int, double>> findAddPlace(cv::Mat frame, int32_t inputID, bool addFrame);
+    // the same as above, but uses keypoints and descriptors already computed by the frontend (no detection on the image)
+    std::vector<std::pair<int, double>> findAddPlace(const std::vector<cv::KeyPoint>& kpts, const cv::Mat& descriptors, int32_t inputID, bool addFrame);
+    // the same as above, but uses precomputed BOW descriptor of the frame
+    std::vector<std::pair<int, double>> findAddPlaceBOW(const cv::Mat& bow, int32_t inputID, bool addFrame);
+    // check if descriptors can be assigned to words of the loaded vocabulary (the same size and type)
+    bool isDescriptorCompatible(const cv::Mat& descriptors) const;
 
 private:
 
@@ -33,7 +39,10 @@ private:
     std::map<int32_t, int32_t> indexMap;
 
     cv::Ptr<cv::FeatureDetector> detector;
+    cv::Ptr<cv::DescriptorExtractor> extractor;
     cv::Ptr<cv::BOWImgDescriptorExtractor> bide;
+    // hierarchical vocabulary, used instead of bide if provided in settings (FilePaths/VocabularyTree)
+    cv::Ptr<of2::VocabularyTree> vocabTree;
     cv::Ptr<of2::FabMap> fabMap;
 
 
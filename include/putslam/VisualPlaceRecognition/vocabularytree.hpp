@@ -0,0 +1,103 @@
+/** @file vocabularytree.hpp
+ *
+ * Hierarchical k-means vocabulary tree (Nister and Stewenius) for BOW quantisation
+ * words are found in O(branching * depth) instead of comparing with every word of the flat vocabulary
+ * float descriptors are clustered with k-means (L2), binary descriptors (CV_8U: ORB, LDB)
+ * with k-majority (Hamming distance, bitwise majority vote centres)
+ *
+ */
+
+#ifndef VOCABULARYTREE_H_
+#define VOCABULARYTREE_H_
+
+#include "opencv2/core/core.hpp"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace of2 {
+
+class CV_EXPORTS VocabularyTree {
+public:
+    /// tree node
+    struct Node {
+        /// index of the first child (children are stored contiguously), -1 for leaves
+        int firstChild;
+        /// number of children
+        int childrenNo;
+        /// word id (leaves only, -1 otherwise)
+        int wordId;
+    };
+
+    VocabularyTree(int branching = 10, int depth = 5);
+    virtual ~VocabularyTree();
+
+    /// build the tree from descriptors (one descriptor per row, CV_8U binary or CV_32F)
+    void train(const cv::Mat& descriptors, int maxIterations = 10);
+
+    /// compute IDF weights from BOW descriptors of training images (one image per row, output of transform)
+    void computeWeights(const cv::Mat& imageBOWs);
+
+    /// compute IDF weights from the number of images in which each word was observed
+    void computeWeights(const std::vector<uint64_t>& occurrences, uint64_t imagesNo);
+
+    /// find word for the descriptor
+    int quantize(const cv::Mat& descriptor) const;
+
+    /// compute BOW descriptor of the image (1 x wordsNo, CV_32F, L1 normalized), term frequencies are weighted by IDF if tfidf is set
+    void transform(const cv::Mat& descriptors, cv::Mat& bow, bool tfidf = false) const;
+
+    /// vocabulary (words) as a matrix (one word per row)
+    cv::Mat getVocabulary() const;
+
+    /// IDF weights of words
+    const std::vector<float>& getWeights() const {return weights;}
+
+    /// number of words
+    int getWordsNo() const {return (int)weights.size();}
+
+    /// size of the descriptor
+    int descriptorSize() const {return centres.cols;}
+
+    /// type of the descriptor
+    int descriptorType() const {return centres.type();}
+
+    bool empty() const {return nodes.empty();}
+
+    /// save tree to the binary file
+    bool save(const std::string& filename) const;
+
+    /// load tree from the binary file
+    bool load(const std::string& filename);
+
+protected:
+
+    /// branching factor
+    int branching;
+    /// max depth of the tree
+    int depth;
+
+    /// nodes of the tree (root is the first one)
+    std::vector<Node> nodes;
+    /// centres of the nodes (one per row, the same order as nodes)
+    cv::Mat centres;
+    /// IDF weights of words (1 if not computed)
+    std::vector<float> weights;
+
+    /// distance between two descriptors (Hamming for CV_8U, squared L2 otherwise)
+    float distance(const uchar* descA, const uchar* descB) const;
+
+    /// split node into 'branching' clusters
+    void buildNode(int nodeId, const cv::Mat& descriptors, std::vector<int>& indices, int level, int maxIterations, std::vector<cv::Mat>& nodeCentres);
+
+    /// k-means (k-means++ seeding), k-majority for binary descriptors, returns number of clusters
+    int kmeans(const cv::Mat& descriptors, const std::vector<int>& indices, int k, int maxIterations, cv::Mat& clusterCentres, std::vector<int>& labels) const;
+
+    /// k-majority update of binary centres
+    void updateMajorityCentres(const cv::Mat& descriptors, const std::vector<int>& indices, const std::vector<int>& labels, int k, cv::Mat& clusterCentres) const;
+};
+
+} // namespace of2
+
+#endif /* VOCABULARYTREE_H_ */
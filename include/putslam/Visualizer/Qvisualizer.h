@@ -18,6 +18,8 @@
 
 using namespace putslam;
 
+class SolidSphere;
+
 /// Map implementation
 class QGLVisualizer: public QGLViewer, public Observer{
 public:
@@ -79,6 +81,12 @@ public:
             model->FirstChildElement( "camera" )->QueryBoolAttribute("flyingCamera", &flyingCamera);
             model->FirstChildElement( "pointCloud" )->QueryBoolAttribute("drawPointClouds", &drawPointClouds);
             model->FirstChildElement( "pointCloud" )->QueryIntAttribute("cloudPointSize", &cloudPointSize);
+            cloudVoxelSize = 0.01; cloudLODLevels = 4; cloudLODDistance = 2.0; cloudsPerFrame = 5; animationPeriod = 40;
+            model->FirstChildElement( "pointCloud" )->QueryDoubleAttribute("voxelSize", &cloudVoxelSize);
+            model->FirstChildElement( "pointCloud" )->QueryIntAttribute("LODLevels", &cloudLODLevels);
+            model->FirstChildElement( "pointCloud" )->QueryDoubleAttribute("LODDistance", &cloudLODDistance);
+            model->FirstChildElement( "pointCloud" )->QueryIntAttribute("cloudsPerFrame", &cloudsPerFrame);
+            model->FirstChildElement( "camera" )->QueryIntAttribute("animationPeriod", &animationPeriod);
             // measurements
             model->FirstChildElement( "measurements" )->QueryBoolAttribute("drawMeasurements", &drawMeasurements);
             model->FirstChildElement( "measurements" )->QueryDoubleAttribute("red", &rgba[0]);
@@ -156,6 +164,21 @@ public:
         /// point size
         int cloudPointSize;
 
+        /// voxel size of the most detailed level of point clouds (0 -- no downsampling, single level) [m]
+        double cloudVoxelSize;
+
+        /// number of levels of detail (voxel size is doubled on each level)
+        int cloudLODLevels;
+
+        /// clouds closer than LODDistance are drawn with the most detailed level, the next level every doubled distance [m]
+        double cloudLODDistance;
+
+        /// max number of point clouds converted and uploaded to the GPU per frame
+        int cloudsPerFrame;
+
+        /// redraw period [ms]
+        int animationPeriod;
+
         /// Draw measured feature positions
         bool drawMeasurements;
 
@@ -200,7 +223,7 @@ public:
     void update(const cv::Mat& color, const cv::Mat& depth, int frameNo);
 
     /// Observer update
-    void update(std::vector<Edge>& features);
+    void update(std::vector<Edge3D>& features);
 
     /// Set depth sensor model
     inline void setDepthSensorModel(const DepthSensorModel& model){ sensorModel = model;};
@@ -220,13 +243,79 @@ private:
     /// mutex for critical section - cam trajectory
     std::recursive_mutex mtxCamTrajectory;
 
+    /// camera poses copied once per frame (drawing does not block the map update)
+    std::vector<Mat34> posesSnapshot;
+
     /// Map visualization -- buffer
     MapModifier bufferMapVisualization;
 
-    //pair -- pose id and point cloud
-    std::vector<std::pair<int,PointCloud>> pointClouds;
+    /// Point cloud stored on the GPU (interleaved xyz/rgb floats, levels of detail stored one after another)
+    class CloudBuffer{
+    public:
+        /// pose id
+        int poseId;
+        /// vertex buffer object
+        GLuint vbo;
+        /// first vertex and number of vertices of each level
+        std::vector<std::pair<GLint,GLsizei>> levels;
+        /// centroid in the sensor frame
+        Eigen::Vector3f centroid;
+    };
+
+    /// point clouds on the GPU
+    std::vector<CloudBuffer> pointClouds;
+
+    /// Array of fixed size elements on the GPU (CPU copy, modified range is uploaded before drawing)
+    class DynamicBuffer{
+    public:
+        DynamicBuffer(size_t _elementSize) : elementSize(_elementSize), vbo(0), capacity(0), dirtyBegin(0), dirtyEnd(0) {}
+        /// set element (idx == size() appends the element)
+        void set(size_t idx, const GLfloat* values);
+        /// upload modified elements
+        void upload(void);
+        /// number of elements
+        inline size_t size(void) const {return data.size()/elementSize;}
+        /// number of floats per element
+        size_t elementSize;
+        /// vertex buffer object
+        GLuint vbo;
+        /// CPU copy
+        std::vector<GLfloat> data;
+        /// number of elements allocated on the GPU
+        size_t capacity;
+        /// modified elements [dirtyBegin, dirtyEnd)
+        size_t dirtyBegin, dirtyEnd;
+    };
+
+    /// shared unit sphere mesh
+    std::unique_ptr<SolidSphere> unitSphere;
+
+    /// shader program -- per-instance transformation of the unit sphere
+    GLuint instancingProgram;
 
-    std::vector<GLuint> cloudsList;
+    /// feature instances (rotation/scale columns and position)
+    DynamicBuffer featureInstances;
+
+    /// feature id -> instance
+    std::map<int,size_t> featureInstancesIds;
+
+    /// trajectory point instances (instance == pose id)
+    DynamicBuffer trajectoryInstances;
+
+    /// ellipsoid instances
+    DynamicBuffer ellipsoidInstances;
+
+    /// pose id -> ellipsoids of measurements from the pose
+    std::map<int,std::vector<size_t>> poseEllipsoids;
+
+    /// pose to feature links (pairs of vertices)
+    DynamicBuffer links;
+
+    /// pose id and feature id of the link
+    std::vector<std::pair<int,int>> linksIds;
+
+    /// pose id -> links, feature id -> links
+    std::map<int,std::vector<size_t>> poseLinks, featureLinks;
 
     /// mutex for critical section - point clouds
     std::mutex mtxPointClouds;
@@ -280,14 +369,26 @@ private:
     /// Draw point clouds
     void drawPointClouds(void);
 
-    /// Create point cloud List
-    GLuint createCloudList(const std::pair<int,PointCloud>& pointCloud);
+    /// Downsample point cloud and upload it to the GPU
+    CloudBuffer createCloudBuffer(int poseId, const PointCloud& pointCloud) const;
+
+    /// Create shader program for instanced drawing
+    GLuint createInstancingProgram(void) const;
+
+    /// Draw unit sphere instances
+    void drawInstances(DynamicBuffer& instances);
+
+    /// Set transformation of the instance of the unit sphere
+    void setInstance(DynamicBuffer& instances, size_t idx, const Mat33& transform, const Eigen::Vector3d& position);
+
+    /// Set ellipsoid instance of the measurement
+    void setEllipsoid(size_t idx);
 
-    /// Draw ellipsoid
-    void drawEllipsoid(unsigned int uiStacks, unsigned int uiSlices, double fA, double fB, double fC) const;
+    /// Set vertices of the pose to feature link
+    void setLink(size_t idx);
 
-    /// Draw ellipsoid
-    void drawEllipsoid(const Vec3& pos, const Mat33& covariance) const;
+    /// Update instances and links after the pose was added or moved
+    void updatePoseInstances(int poseId);
 };
 
 #endif // QVISUALIZER_H_INCLUDED
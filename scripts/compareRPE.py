@@ -0,0 +1,42 @@
+#!/usr/bin/python
+# Checks putslam_eval against the reference evaluate_rpe.py (TUM RGB-D benchmark)
+# both tools evaluate the same trajectories with fixed pose pairs (no random sampling), RMSE have to agree
+#
+# usage: python compareRPE.py groundtruth.txt estimated.txt [putslam_eval (default: ../build/bin/putslam_eval)]
+
+import subprocess
+import sys
+import os
+
+def readResults(output):
+	results = {}
+	for line in output.splitlines():
+		values = line.split()
+		if len(values) >= 2:
+			results[values[0]] = float(values[1])
+	return results
+
+if len(sys.argv) < 3:
+	print("usage: python compareRPE.py groundtruth.txt estimated.txt [putslam_eval]")
+	sys.exit(1)
+
+scriptsDir = os.path.dirname(os.path.abspath(__file__))
+putslamEval = sys.argv[3] if len(sys.argv) > 3 else os.path.join(scriptsDir, "../build/bin/putslam_eval")
+keys = ["compared_pose_pairs", "translational_error.rmse", "rotational_error.rmse"]
+settings = [["--fixed_delta", "--delta", "1", "--delta_unit", "f"],
+	["--fixed_delta", "--delta", "10", "--delta_unit", "f"],
+	["--fixed_delta", "--delta", "0.5", "--delta_unit", "m"]]
+
+failed = 0
+for setting in settings:
+	reference = readResults(subprocess.check_output([sys.executable, os.path.join(scriptsDir, "evaluate_rpe.py"),
+		sys.argv[1], sys.argv[2], "--verbose"] + setting).decode())
+	native = readResults(subprocess.check_output([putslamEval, sys.argv[1], sys.argv[2], "--rpe_only"] + setting).decode())
+	for key in keys:
+		# evaluate_rpe.py prints 6 decimal places
+		ok = key in reference and key in native and abs(reference[key] - native[key]) <= 1e-6 + 1e-4 * abs(reference[key])
+		print("%s %s: evaluate_rpe.py %s, putslam_eval %s %s" % (" ".join(setting), key, reference.get(key), native.get(key), "ok" if ok else "MISMATCH"))
+		if not ok:
+			failed += 1
+
+sys.exit(1 if failed > 0 else 0)
@@ -12,8 +12,11 @@ LoopClosureLocal::LoopClosureLocal(void) : LoopClosure("Local Loop Closure", LC_
 /// Construction
 LoopClosureLocal::LoopClosureLocal(std::string configFilename) : LoopClosure("Local Loop Closure", LC_LOCAL), config(configFilename) {
     currentFrame = 0;
+    imageScale = config.imageScale;
+    maxQueuedImagesBytes = (size_t)config.maxQueueMemoryMB * 1024 * 1024;
+    priorityQueueLC.setCapacity(config.maxPQSize);
 
-    vpr.reset(new VisualPlaceRecognition(config.minFeatures, config.tailFramesToSkip, config.minNewPlaceProb));
+    vpr.reset(new VisualPlaceRecognition(config.minFeatures, config.tailFramesToSkip, config.minNewPlaceProb, config.fabMapVersion));
 }
 
 /// Destruction
@@ -33,6 +36,13 @@ LoopClosureLocal::Config::Config(std::string configFilename){
     model->FirstChildElement( "parameters" )->QueryIntAttribute("tailFramesToSkip", &tailFramesToSkip);
     model->FirstChildElement( "parameters" )->QueryDoubleAttribute("minNewPlaceProb", &minNewPlaceProb);
     model->FirstChildElement( "parameters" )->QueryIntAttribute("maxPQSize", &maxPQSize);
+    fabMapVersion = "FABMAP2";
+    if (model->FirstChildElement( "parameters" )->Attribute("fabMapVersion"))
+        fabMapVersion = model->FirstChildElement( "parameters" )->Attribute("fabMapVersion");
+    imageScale = 1.0;
+    model->FirstChildElement( "parameters" )->QueryDoubleAttribute("imageScale", &imageScale);
+    maxQueueMemoryMB = 0;
+    model->FirstChildElement( "parameters" )->QueryIntAttribute("maxQueueMemoryMB", &maxQueueMemoryMB);
 }
 
 /// start loop closure thread (thread updates priority queue)
@@ -66,11 +76,19 @@ void LoopClosureLocal::updatePriorityQueue(void){
 
 			// We use FABMAP to find all potentially promissing match to current frame to analyze
 			imageDataMtx.lock();
-			cv::Mat frame = imagesSeq.front();
-			imagesSeq.pop_front();
+			cv::Mat frame;
+			std::vector<cv::KeyPoint> keypoints;
+			cv::Mat descriptors;
+			popQueuedFrame(frame, keypoints, descriptors);
 			imageDataMtx.unlock();
 
-            std::vector<std::pair<int, double>> candidates = vpr.get()->findAddPlace(frame, currentFrame, true);
+			// features from the frontend are used if provided (no detection on the image)
+			// frames released because of the memory limit are skipped
+            std::vector<std::pair<int, double>> candidates;
+            if (!frame.empty())
+                candidates = vpr.get()->findAddPlace(frame, currentFrame, true);
+            else if (!descriptors.empty())
+                candidates = vpr.get()->findAddPlace(keypoints, descriptors, currentFrame, true);
 
 			// For each candidate (int -> id, double -> probability)
 			for (std::pair<int, double> candidate : candidates) {
@@ -100,30 +118,11 @@ void LoopClosureLocal::updatePriorityQueue(void){
 			}
 
 
-            // Keep priority size reasonable - if it is more than 100, we trim to 50
-			checkAndTrimPQSize();
-
             currentFrame++;
         }
     }
 }
 
-void LoopClosureLocal::checkAndTrimPQSize() {
-	priorityQueueMtx.lock();
-	size_t size = priorityQueueLC.size();
-	if (size > config.maxPQSize) {
-		std::priority_queue<LCMatch, std::vector<LCMatch>, LCMatch> trimmedPQ;
-
-		for (uint i = 0; i < config.maxPQSize / 2; i++) {
-			LCMatch element = priorityQueueLC.top();
-			trimmedPQ.push(element);
-			priorityQueueLC.pop();
-		}
-		priorityQueueLC = trimmedPQ;
-	}
-	priorityQueueMtx.unlock();
-}
-
 putslam::LoopClosure* putslam::createLoopClosureLocal(void) {
     localLC.reset(new LoopClosureLocal());
     return localLC.get();
@@ -8,9 +8,11 @@
 #include "PoseGraph/graph.h"
 #include "Grabber/xtionGrabber.h"
 #include "TransformEst/g2oEst.h"
+#include "Utilities/profiler.h"
 #include <memory>
 #include <stdexcept>
 #include <chrono>
+#include <algorithm>
 
 using namespace putslam;
 
@@ -25,6 +27,10 @@ FeaturesMap::FeaturesMap(void) :
 
 	poseGraph = createPoseGraphG2O();
     continueLoopClosure = false;
+    continueVisualization = false;
+    bufferMapFrontend.mtxBuffer.setName("FeaturesMap::bufferMapFrontend");
+    bufferMapManagement.mtxBuffer.setName("FeaturesMap::bufferMapManagement");
+    bufferMapVisualization.mtxBuffer.setName("FeaturesMap::bufferMapVisualization");
 }
 
 /// Construction
@@ -37,6 +43,10 @@ FeaturesMap::FeaturesMap(std::string configMap, std::string sensorConfig) :
 	std::cout << "FeaturesMap" << std::endl;
 
 	poseGraph = createPoseGraphG2O();
+    if (!((PoseGraphG2O*) poseGraph)->setSolver(config.linearSolver, config.blockSolver, config.optimizationAlgorithm))
+        std::cout << "FeaturesMap: could not set local graph solver, using " << ((PoseGraphG2O*) poseGraph)->getSolverName() << "\n";
+    ((PoseGraphG2O*) poseGraph)->setCameraParameters(sensorModel.config.focalLength[0], sensorModel.config.focalLength[1], sensorModel.config.focalAxis[0], sensorModel.config.focalAxis[1]);
+    ((PoseGraphG2O*) poseGraph)->setIncrementalOptimization(config.incrementalOpt, config.incrementalDepth, config.relinearizationThr, config.fullOptimizationPeriod);
 	if (config.searchPairsTypeLC == 0)
 		localLC = createLoopClosureLocal(config.configFilenameLC);
 	//else if (config.searchPairsTypeLC==1)
@@ -46,11 +56,24 @@ FeaturesMap::FeaturesMap(std::string configMap, std::string sensorConfig) :
 	loopClosureSuccess = false;
 	updateMapSuccess = true;
     continueLoopClosure = false;
+    continueVisualization = false;
+    bufferMapFrontend.mtxBuffer.setName("FeaturesMap::bufferMapFrontend");
+    bufferMapManagement.mtxBuffer.setName("FeaturesMap::bufferMapManagement");
+    bufferMapVisualization.mtxBuffer.setName("FeaturesMap::bufferMapVisualization");
+    if (!config.recordLog.empty())
+        mapLog.setFile(config.recordLog, config.recordImages);
 }
 
 
 /// Destruction
 FeaturesMap::~FeaturesMap(void) {
+    finishVisualizationThr();
+    finishRecording();
+}
+
+/// finish recording of the frontend calls (the log is closed)
+void FeaturesMap::finishRecording(void) {
+    mapLog.finish();
 }
 
 const std::string& FeaturesMap::getName() const {
@@ -60,11 +83,11 @@ const std::string& FeaturesMap::getName() const {
 /// Add NEW features to the map
 /// Position of features in relation to camera pose
 void FeaturesMap::addFeatures(const std::vector<RGBDFeature>& features, int poseId) {
+    mapLog.recordFeatures(features, poseId);
 
     Mat34 cameraPose = getSensorPose(poseId);
     int camTrajSize = getPoseCounter();
     if (poseId==-1) poseId = camTrajSize - 1;
-    std::vector<Edge> features2visualization;
 	for (std::vector<RGBDFeature>::const_iterator it = features.begin();
             it != features.end(); it++) { // update the graph
 
@@ -127,8 +150,11 @@ void FeaturesMap::addFeatures(const std::vector<RGBDFeature>& features, int pose
         	Edge3D e((*it).position, info, poseId, featureIdNo);
         	poseGraph->addEdge3D(e);
 
-		    if (config.visualize)
-		            features2visualization.push_back(e);
+		    if (config.visualize){
+		        mtxVisualization.lock();
+		        measurements2visualization.push_back(e);
+		        mtxVisualization.unlock();
+		    }
 		}
         else if ( config.optimizationErrorType == Config::OptimizationErrorType::REPROJECTION) {
 			//std::cout<<"Edge 3DReproj -- Reprojection error" << std::endl;
@@ -148,25 +174,25 @@ void FeaturesMap::addFeatures(const std::vector<RGBDFeature>& features, int pose
     updateMaps();
 
     emptyMap = false;
-    if (config.visualize){
-        notify(bufferMapVisualization);
-        notify(features2visualization);
-    }
 }
 
 /// add new pose of the camera, returns id of the new pose
 int FeaturesMap::addNewPose(const Mat34& cameraPoseChange, double timestamp, cv::Mat image, cv::Mat depthImage) {
+    mapLog.recordNewPose(cameraPoseChange, timestamp, image, depthImage);
     int trajSize = getPoseCounter();
 
     // When keepCameraFrames:
     // - true 	- we store all images in map
     // - false 	- we store only the images from new pose for LC purposes
+    mtxImages.lock();
     if (!config.keepCameraFrames){
         imageSeq.clear();
         depthSeq.clear();
+        frameFeaturesSeq.clear();
     }
     imageSeq.insert(std::make_pair(trajSize,image));
     depthSeq.insert(std::make_pair(trajSize,depthImage));
+    mtxImages.unlock();
 
     Mat34 cameraPose(cameraPoseChange);
 	if (trajSize == 0) {
@@ -178,7 +204,7 @@ int FeaturesMap::addNewPose(const Mat34& cameraPoseChange, double timestamp, cv:
         mtxCamTraj.unlock();
 
         if (config.visualize){
-            bufferMapVisualization.mtxBuffer.unlock();
+            bufferMapVisualization.mtxBuffer.lock();
             bufferMapVisualization.poses2add.push_back(camPose);
             bufferMapVisualization.mtxBuffer.unlock();
         }
@@ -199,7 +225,7 @@ int FeaturesMap::addNewPose(const Mat34& cameraPoseChange, double timestamp, cv:
         mtxCamTraj.unlock();
 
         if (config.visualize){
-            bufferMapVisualization.mtxBuffer.unlock();
+            bufferMapVisualization.mtxBuffer.lock();
             bufferMapVisualization.poses2add.push_back(camPose);
             bufferMapVisualization.mtxBuffer.unlock();
         }
@@ -207,18 +233,26 @@ int FeaturesMap::addNewPose(const Mat34& cameraPoseChange, double timestamp, cv:
         //add camera pose to the graph
         poseGraph->addVertexPose(camPose);
     }
+    // the latest selected keyframe is sent to the visualizer by the publishing thread
     if (config.visualize){
-        if (config.frameNo2updatePointCloud>=0){
+        if (config.frameNo2updatePointCloud>0){
             if (trajSize%config.frameNo2updatePointCloud==0){
-                this->notify(image, depthImage, trajSize);
+                keyframe2visualization.publish(VisualizationFrame(image, depthImage, trajSize));
             }
         }
-        notify(bufferMapVisualization);
     }
 
 	return trajSize;
 }
 
+/// add keypoints and descriptors computed by the frontend for the pose (used by LC instead of the image)
+void FeaturesMap::addFrameFeatures(int poseId, const std::vector<cv::KeyPoint>& keypoints, const cv::Mat& descriptors) {
+    mapLog.recordFrameFeatures(poseId, keypoints, descriptors);
+    mtxImages.lock();
+    frameFeaturesSeq[poseId] = std::make_pair(keypoints, descriptors);
+    mtxImages.unlock();
+}
+
 void FeaturesMap::removeFeatures(std::vector<int> featureIdsToRemove) {
 	// TODO: DB
 
@@ -240,18 +274,31 @@ void FeaturesMap::removeFeatures(std::vector<int> featureIdsToRemove) {
 
 /// get n-th image and depth image from the sequence
 void FeaturesMap::getImages(int poseNo, cv::Mat& image, cv::Mat& depthImage){
+	image.release();
+	depthImage.release();
 	if (config.keepCameraFrames){
-	  image = imageSeq.at(poseNo);
-	  depthImage = depthSeq.at(poseNo);
+	  // frames that are not keyframes are removed from the sequence by the map management
+	  mtxImages.lock();
+	  auto rgb = imageSeq.find(poseNo);
+	  auto depth = depthSeq.find(poseNo);
+	  if (rgb!=imageSeq.end()&&depth!=depthSeq.end()){
+	    image = rgb->second;
+	    depthImage = depth->second;
+	  }
+	  mtxImages.unlock();
 	}
-	//check if poseNo is keyframe!!!
 }
 
 /// add measurements (features measured from the last camera pose)
 void FeaturesMap::addMeasurements(const std::vector<MapFeature>& features, int poseId) {
+    mapLog.recordMeasurements(features, poseId);
+    insertMeasurements(features, poseId);
+}
+
+/// add measurements to the map (frontend and loop closure, not recorded)
+void FeaturesMap::insertMeasurements(const std::vector<MapFeature>& features, int poseId) {
     int camTrajSize = getPoseCounter();
     unsigned int _poseId = (poseId >= 0) ? poseId : (camTrajSize - 1);
-    std::vector<Edge> features2visualization;
     for (std::vector<MapFeature>::const_iterator it = features.begin(); it != features.end(); it++) {
         mtxCamTraj.lock();
         camTrajectory[_poseId].featuresIds.insert(it->id);
@@ -280,8 +327,11 @@ void FeaturesMap::addMeasurements(const std::vector<MapFeature>& features, int p
 
         Edge3D e((*it).position, info, _poseId, (*it).id);
         poseGraph->addEdge3D(e);
-        if (config.visualize)
-            features2visualization.push_back(e);
+        if (config.visualize){
+            mtxVisualization.lock();
+            measurements2visualization.push_back(e);
+            mtxVisualization.unlock();
+        }
     }
 
     // TODO: Czy to nie powinno byc updateMap dla takze cech z frontendu?
@@ -309,7 +359,22 @@ void FeaturesMap::addMeasurements(const std::vector<MapFeature>& features, int p
             mtxCamTraj.unlock();
 
             if (continueLoopClosure){
-                localLC->addPose(this->getSensorPose(lastKeyframeId),imageSeq.at(lastKeyframeId), lastKeyframeId);
+                mtxImages.lock();
+                auto frameFeatures = frameFeaturesSeq.find(lastKeyframeId);
+                bool useFeatures = config.useFrontendFeaturesLC&&frameFeatures!=frameFeaturesSeq.end()&&!frameFeatures->second.second.empty();
+                std::vector<cv::KeyPoint> keypoints;
+                cv::Mat descriptors, image;
+                if (useFeatures){
+                    keypoints = frameFeatures->second.first;
+                    descriptors = frameFeatures->second.second;
+                }
+                else
+                    image = imageSeq.at(lastKeyframeId);
+                mtxImages.unlock();
+                if (useFeatures)
+                    localLC->addPose(this->getSensorPose(lastKeyframeId), keypoints, descriptors, lastKeyframeId);
+                else
+                    localLC->addPose(this->getSensorPose(lastKeyframeId), image, lastKeyframeId);
             }
             covisibilityGraph.addVertex(lastKeyframeId);
             for (auto covKey : covisibilityKeyframes){
@@ -331,8 +396,6 @@ void FeaturesMap::addMeasurements(const std::vector<MapFeature>& features, int p
             mtxCamTraj.unlock();
         }
     }
-    if (config.visualize)
-        notify(features2visualization);
 }
 
 /// update maps (frontend, loop closure, management)
@@ -376,6 +439,7 @@ double FeaturesMap::computeCovisibility(const std::vector<MapFeature>& features,
 
 /// add measurement between two poses
 void FeaturesMap::addMeasurement(int poseFrom, int poseTo, Mat34 transformation){
+    mapLog.recordMeasurement(poseFrom, poseTo, transformation);
     EdgeSE3 e(transformation, Mat66::Identity(), poseFrom, poseTo);
     poseGraph->addEdgeSE3(e);
     //std::chrono::steady_clock::time_point end= std::chrono::steady_clock::now();
@@ -633,6 +697,14 @@ int FeaturesMap::getPoseCounter() {
 	return size;
 }
 
+/// check if the pose is a keyframe
+bool FeaturesMap::isKeyframe(int poseId) {
+    mtxCamTraj.lock();
+    bool keyframe = poseId >= 0 && poseId < (int) camTrajectory.size() && camTrajectory[poseId].isKeyframe;
+    mtxCamTraj.unlock();
+    return keyframe;
+}
+
 /// start optimization thread
 void FeaturesMap::startOptimizationThread(unsigned int iterNo, int verbose,
         std::string RobustKernelName, double kernelDelta) {
@@ -696,6 +768,7 @@ void FeaturesMap::finishLoopClosureThr(void){
 void FeaturesMap::manage(int verbose){
     // graph optimization
     continueManagement = true;
+    Profiler::get().setThreadName("management");
 
     // Wait for some information in map
     while (continueManagement && featuresMapManagement.size()==0) {
@@ -704,6 +777,7 @@ void FeaturesMap::manage(int verbose){
 
     // Wait for some information in map
     while (continueManagement) {
+        PUTSLAM_PROFILE("map.management");
         auto start = std::chrono::system_clock::now();
         if (verbose>0){
             std::cout << "Graph management: start new iteration\n";
@@ -733,6 +807,7 @@ void FeaturesMap::manage(int verbose){
 void FeaturesMap::loopClosure(int verbose, Matcher* matcher){
 	  // graph optimization
     continueLoopClosure = true;
+    Profiler::get().setThreadName("loopClosure");
 
     // Wait for some information in map
     mtxMapFrontend.lock();
@@ -753,6 +828,7 @@ void FeaturesMap::loopClosure(int verbose, Matcher* matcher){
 		// Is there any pair that we should check?
 		LoopClosure::LCMatch lcMatch;
 		if (localLC->getLCPair(lcMatch)) {
+			PUTSLAM_PROFILE("map.loopClosure");
 
 
 			// Variables to store data and resultss
@@ -854,7 +930,7 @@ void FeaturesMap::loopClosure(int verbose, Matcher* matcher){
 
 					}
 				}
-				addMeasurements(measuredFeatures, frameIds[1]);
+				insertMeasurements(measuredFeatures, frameIds[1]);
 				std::sort(featureIdsToRemove.begin(), featureIdsToRemove.end(),
 						std::greater<int>());
 				removeFeatures(featureIdsToRemove);
@@ -882,6 +958,7 @@ void FeaturesMap::optimize(unsigned int iterNo, int verbose,
         std::string RobustKernelName, double kernelDelta) {
 	// graph optimization
 	continueOpt = true;
+	Profiler::get().setThreadName("optimization");
 
 	// Wait for some information in map
 	while (continueOpt && emptyMap) {
@@ -891,6 +968,7 @@ void FeaturesMap::optimize(unsigned int iterNo, int verbose,
     /// optimization clock
     Stopwatch<std::chrono::microseconds> clockTimestamp;
 	while (continueOpt) {
+        PUTSLAM_PROFILE("map.optimization");
         Stopwatch<std::chrono::microseconds> clockOpt;
 		if (verbose)
 			std::cout << "start optimization\n";
@@ -961,7 +1039,10 @@ void FeaturesMap::optimize(unsigned int iterNo, int verbose,
                     mtxCamTraj.lock();
                     if (camTrajectory[lastFullyMarginalizedFrame].isKeyframe){
                         mtxCamTraj.unlock();
-                        fixMeasurementsFromPose(lastFullyMarginalizedFrame);
+                        if (config.slidingWindow)
+                            marginalizeKeyframe(lastFullyMarginalizedFrame);
+                        else
+                            fixMeasurementsFromPose(lastFullyMarginalizedFrame);
                         activeKeyframesNo--;
                     }
                     else
@@ -989,6 +1070,8 @@ void FeaturesMap::optimize(unsigned int iterNo, int verbose,
     if (config.fixVertices)
         ((PoseGraphG2O*)poseGraph)->releaseFixedVertices();
     //poseGraph->optimize(-1, verbose, 0.0001);
+    // final optimization of the whole graph
+    ((PoseGraphG2O*)poseGraph)->setIncrementalOptimization(false, config.incrementalDepth, config.relinearizationThr, config.fullOptimizationPeriod);
 
     if (config.edges3DPrunningThreshold>0)
         ((PoseGraphG2O*) poseGraph)->prune3Dedges(config.edges3DPrunningThreshold);//pruning
@@ -1028,6 +1111,7 @@ void FeaturesMap::optimize(unsigned int iterNo, int verbose,
 /// save optimization time
 void FeaturesMap::saveOptimizationTime(std::list<std::pair<double,double>>& optimizationTime, std::string filename){
     std::ofstream file(filename);
+    file << "% local graph solver: " << ((PoseGraphG2O*) poseGraph)->getSolverName() << "\n";
     file << "close all;\nclear all;\nhold on;\n";
     file << "x=[];\ny=[];\n";
     for (const auto time : optimizationTime){
@@ -1036,6 +1120,7 @@ void FeaturesMap::saveOptimizationTime(std::list<std::pair<double,double>>& opti
     file << "plot(x,y,'-or', 'LineWidth',3);\n";
     file << "xlabel('Time [s]');\n";
     file << "ylabel('Optimization time [s]');\n";
+    file << "title('" << ((PoseGraphG2O*) poseGraph)->getSolverName() << "');\n";
     file.close();
 }
 
@@ -1052,6 +1137,13 @@ void FeaturesMap::fixMeasurementsFromPose(int frameId){
     //std::cout << "fix pose " << frameId << "\n";
 }
 
+/// marginalize keyframe and features measured only from it
+void FeaturesMap::marginalizeKeyframe(int frameId){
+    std::set<int> marginalizedFeatures;
+    ((PoseGraphG2O*)poseGraph)->marginalizePoses(std::vector<int>(1,frameId), marginalizedFeatures);
+    removeFeatures(std::vector<int>(marginalizedFeatures.begin(), marginalizedFeatures.end()));
+}
+
 /// marginalize measurements between frames
 void FeaturesMap::marginalizeMeasurements(int frameBegin, int frameEnd){
     std::vector<int> keyframes;
@@ -1073,8 +1165,11 @@ void FeaturesMap::marginalizeMeasurements(int frameBegin, int frameEnd){
         featuresAll.insert(camTrajectory[frameNo].featuresIds.begin(), camTrajectory[frameNo].featuresIds.end());
         mtxCamTraj.unlock();
         if (config.keepCameraFrames&&!camTrajectory[frameNo].isKeyframe){
+            mtxImages.lock();
             imageSeq.erase(frameNo);
             depthSeq.erase(frameNo);
+            frameFeaturesSeq.erase(frameNo);
+            mtxImages.unlock();
         }
     }
     //std::set<int> featuresFullOpt;
@@ -1105,7 +1200,7 @@ void FeaturesMap::marginalizeMeasurements(int frameBegin, int frameEnd){
 
 
 /// Update map
-bool FeaturesMap::updateMap(MapModifier& modifier, std::map<int,MapFeature>& featuresMap, std::recursive_mutex& mutex) {
+bool FeaturesMap::updateMap(MapModifier& modifier, std::map<int,MapFeature>& featuresMap, putslam::RecursiveMutex& mutex) {
 	if (mutex.try_lock()) {    //try to lock graph
 		modifier.mtxBuffer.lock();
 		if (modifier.addFeatures()) {
@@ -1586,6 +1681,60 @@ void FeaturesMap::setRobustKernel(std::string name, double delta) {
 /// set drawing options
 void FeaturesMap::setDrawOptions(bool _draw){
     config.visualize = _draw;
+    if (_draw && !visualizationThr){
+        continueVisualization = true;
+        visualizationThr.reset(new std::thread(&FeaturesMap::publishVisualization, this));
+    }
+    else if (!_draw)
+        finishVisualizationThr();
+}
+
+/// stop visualization thread
+void FeaturesMap::finishVisualizationThr(void){
+    if (visualizationThr){
+        continueVisualization = false;
+        visualizationThr->join();
+        visualizationThr.reset();
+    }
+}
+
+/// visualization thread -- sends map changes to the visualizer with the fixed rate
+void FeaturesMap::publishVisualization(void){
+    auto period = std::chrono::microseconds((long)(1e6/std::max(config.visualizationRate, 0.1)));
+    // swapped with the buffers filled by SLAM threads (capacity of vectors is reused)
+    MapModifier mapModifier;
+    std::vector<Edge3D> measurements;
+    Profiler::get().setThreadName("visualization");
+    auto publishTime = std::chrono::steady_clock::now();
+    while (continueVisualization){
+        // fixed rate (a late update is not followed by a burst)
+        publishTime = std::max(publishTime + period, std::chrono::steady_clock::now());
+        std::this_thread::sleep_until(publishTime);
+        PUTSLAM_PROFILE("map.visualizationPublish");
+
+        bufferMapVisualization.mtxBuffer.lock();
+        mapModifier.features2add.swap(bufferMapVisualization.features2add);
+        mapModifier.features2update.swap(bufferMapVisualization.features2update);
+        mapModifier.poses2add.swap(bufferMapVisualization.poses2add);
+        mapModifier.poses2update.swap(bufferMapVisualization.poses2update);
+        bufferMapVisualization.mtxBuffer.unlock();
+        mtxVisualization.lock();
+        measurements.swap(measurements2visualization);
+        mtxVisualization.unlock();
+
+        // only this thread waits for the visualizer
+        if (mapModifier.addFeatures()||mapModifier.updateFeatures()||mapModifier.addPoses()||mapModifier.updatePoses())
+            notify(mapModifier);
+        if (measurements.size()>0)
+            notify(measurements);
+        VisualizationFrame frame;
+        if (keyframe2visualization.take(frame))
+            notify(frame.rgbImage, frame.depthImage, frame.poseId);
+
+        mapModifier.features2add.clear(); mapModifier.features2update.clear();
+        mapModifier.poses2add.clear(); mapModifier.poses2update.clear();
+        measurements.clear();
+    }
 }
 
 /// use uncertainty
@@ -0,0 +1,354 @@
+/** @file mapLog.cpp
+ *
+ * Record and replay of the frontend calls of FeaturesMap
+ *
+ */
+
+#include "Map/mapLog.h"
+#include "Map/featuresMap.h"
+#include <cstring>
+
+using namespace putslam;
+
+/// write value
+template<typename T>
+static void write(std::ostream& os, const T& value) {
+    os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+/// read value
+template<typename T>
+static bool read(std::istream& is, T& value) {
+    return bool(is.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+static void write(std::ostream& os, const Vec3& vec) {
+    write(os, vec.x()); write(os, vec.y()); write(os, vec.z());
+}
+
+static bool read(std::istream& is, Vec3& vec) {
+    return read(is, vec.x()) && read(is, vec.y()) && read(is, vec.z());
+}
+
+static void write(std::ostream& os, const Mat34& pose) {
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 4; j++)
+            write(os, pose(i, j));
+}
+
+static bool read(std::istream& is, Mat34& pose) {
+    pose.setIdentity();
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 4; j++)
+            if (!read(is, pose(i, j)))
+                return false;
+    return true;
+}
+
+/// cv::Mat: rows, cols, type, data
+static void write(std::ostream& os, const cv::Mat& mat) {
+    int32_t rows = mat.rows, cols = mat.cols, type = mat.type();
+    write(os, rows); write(os, cols); write(os, type);
+    if (mat.empty())
+        return;
+    cv::Mat continuous = mat.isContinuous() ? mat : mat.clone();
+    os.write(reinterpret_cast<const char*>(continuous.data), (std::streamsize) (continuous.total() * continuous.elemSize()));
+}
+
+static bool read(std::istream& is, cv::Mat& mat) {
+    int32_t rows, cols, type;
+    if (!read(is, rows) || !read(is, cols) || !read(is, type))
+        return false;
+    mat.release();
+    if (rows <= 0 || cols <= 0)
+        return true;
+    mat.create(rows, cols, type);
+    return bool(is.read(reinterpret_cast<char*>(mat.data), (std::streamsize) (mat.total() * mat.elemSize())));
+}
+
+static void write(std::ostream& os, const cv::KeyPoint& keypoint) {
+    write(os, keypoint.pt.x); write(os, keypoint.pt.y); write(os, keypoint.size); write(os, keypoint.angle);
+    write(os, keypoint.response); write(os, (int32_t) keypoint.octave); write(os, (int32_t) keypoint.class_id);
+}
+
+static bool read(std::istream& is, cv::KeyPoint& keypoint) {
+    int32_t octave, classId;
+    if (!read(is, keypoint.pt.x) || !read(is, keypoint.pt.y) || !read(is, keypoint.size) || !read(is, keypoint.angle)
+            || !read(is, keypoint.response) || !read(is, octave) || !read(is, classId))
+        return false;
+    keypoint.octave = octave;
+    keypoint.class_id = classId;
+    return true;
+}
+
+static void write(std::ostream& os, const RGBDFeature& feature) {
+    write(os, feature.position); write(os, feature.u); write(os, feature.v);
+    write(os, feature.normal); write(os, feature.RGBgradient);
+    write(os, (uint32_t) feature.descriptors.size());
+    for (auto& descriptor : feature.descriptors) {
+        write(os, (uint32_t) descriptor.first);
+        write(os, descriptor.second.point2D.x); write(os, descriptor.second.point2D.y);
+        write(os, descriptor.second.point2DUndist.x); write(os, descriptor.second.point2DUndist.y);
+        write(os, descriptor.second.point3D);
+        write(os, descriptor.second.descriptor);
+        write(os, (int32_t) descriptor.second.octave);
+        write(os, descriptor.second.detDist);
+    }
+}
+
+static bool read(std::istream& is, RGBDFeature& feature) {
+    uint32_t descriptorsNo;
+    if (!read(is, feature.position) || !read(is, feature.u) || !read(is, feature.v) || !read(is, feature.normal)
+            || !read(is, feature.RGBgradient) || !read(is, descriptorsNo))
+        return false;
+    feature.descriptors.clear();
+    for (uint32_t i = 0; i < descriptorsNo; i++) {
+        uint32_t poseId;
+        int32_t octave;
+        ExtendedDescriptor descriptor;
+        if (!read(is, poseId) || !read(is, descriptor.point2D.x) || !read(is, descriptor.point2D.y)
+                || !read(is, descriptor.point2DUndist.x) || !read(is, descriptor.point2DUndist.y)
+                || !read(is, descriptor.point3D) || !read(is, descriptor.descriptor) || !read(is, octave)
+                || !read(is, descriptor.detDist))
+            return false;
+        descriptor.octave = octave;
+        feature.descriptors[poseId] = descriptor;
+    }
+    return true;
+}
+
+static void write(std::ostream& os, const MapFeature& feature) {
+    write(os, static_cast<const RGBDFeature&>(feature));
+    write(os, (uint32_t) feature.id);
+    write(os, (uint32_t) feature.lifeValue);
+    write(os, (uint32_t) feature.posesIds.size());
+    for (auto poseId : feature.posesIds)
+        write(os, (uint32_t) poseId);
+    write(os, (uint32_t) feature.imageCoordinates.size());
+    for (auto& coordinates : feature.imageCoordinates) {
+        write(os, (uint32_t) coordinates.first);
+        write(os, coordinates.second.u); write(os, coordinates.second.v); write(os, coordinates.second.depth);
+    }
+}
+
+static bool read(std::istream& is, MapFeature& feature) {
+    uint32_t id, lifeValue, posesNo, coordinatesNo;
+    if (!read(is, static_cast<RGBDFeature&>(feature)) || !read(is, id) || !read(is, lifeValue) || !read(is, posesNo))
+        return false;
+    feature.id = id;
+    feature.lifeValue = lifeValue;
+    feature.posesIds.resize(posesNo);
+    for (auto& poseId : feature.posesIds) {
+        uint32_t value;
+        if (!read(is, value))
+            return false;
+        poseId = value;
+    }
+    if (!read(is, coordinatesNo))
+        return false;
+    feature.imageCoordinates.clear();
+    for (uint32_t i = 0; i < coordinatesNo; i++) {
+        uint32_t frameId;
+        ImageFeature coordinates;
+        if (!read(is, frameId) || !read(is, coordinates.u) || !read(is, coordinates.v) || !read(is, coordinates.depth))
+            return false;
+        feature.imageCoordinates[frameId] = coordinates;
+    }
+    return true;
+}
+
+/// enable recording to the file
+void MapLogWriter::setFile(const std::string& _filename, bool _recordImages) {
+    mtxLog.lock();
+    filename = _filename;
+    recordImages = _recordImages;
+    enabled = !filename.empty();
+    mtxLog.unlock();
+}
+
+/// open the file if it is the first record (called with locked mtxLog)
+bool MapLogWriter::beginRecord(MapLog::RecordType type) {
+    if (!enabled)
+        return false;
+    if (!file.is_open()) {
+        file.open(filename, std::ios::binary);
+        if (!file.is_open()) {
+            std::cout << "MapLogWriter: unable to open " << filename << ", recording disabled\n";
+            enabled = false;
+            return false;
+        }
+        uint32_t logVersion = MapLog::version;
+        file.write(MapLog::header(), (std::streamsize) strlen(MapLog::header()));
+        write(file, logVersion);
+    }
+    write(file, (uint8_t) type);
+    return true;
+}
+
+/// record addNewPose
+void MapLogWriter::recordNewPose(const Mat34& cameraPoseChange, double timestamp, const cv::Mat& image, const cv::Mat& depthImage) {
+    mtxLog.lock();
+    if (beginRecord(MapLog::RECORD_NEW_POSE)) {
+        write(file, cameraPoseChange);
+        write(file, timestamp);
+        write(file, recordImages ? image : cv::Mat());
+        write(file, recordImages ? depthImage : cv::Mat());
+    }
+    mtxLog.unlock();
+}
+
+/// record addFeatures
+void MapLogWriter::recordFeatures(const std::vector<RGBDFeature>& features, int poseId) {
+    mtxLog.lock();
+    if (beginRecord(MapLog::RECORD_FEATURES)) {
+        write(file, (int32_t) poseId);
+        write(file, (uint32_t) features.size());
+        for (auto& feature : features)
+            write(file, feature);
+    }
+    mtxLog.unlock();
+}
+
+/// record addMeasurements
+void MapLogWriter::recordMeasurements(const std::vector<MapFeature>& features, int poseId) {
+    mtxLog.lock();
+    if (beginRecord(MapLog::RECORD_MEASUREMENTS)) {
+        write(file, (int32_t) poseId);
+        write(file, (uint32_t) features.size());
+        for (auto& feature : features)
+            write(file, feature);
+    }
+    mtxLog.unlock();
+}
+
+/// record addMeasurement
+void MapLogWriter::recordMeasurement(int poseFrom, int poseTo, const Mat34& transformation) {
+    mtxLog.lock();
+    if (beginRecord(MapLog::RECORD_MEASUREMENT)) {
+        write(file, (int32_t) poseFrom);
+        write(file, (int32_t) poseTo);
+        write(file, transformation);
+    }
+    mtxLog.unlock();
+}
+
+/// record addFrameFeatures
+void MapLogWriter::recordFrameFeatures(int poseId, const std::vector<cv::KeyPoint>& keypoints, const cv::Mat& descriptors) {
+    mtxLog.lock();
+    if (beginRecord(MapLog::RECORD_FRAME_FEATURES)) {
+        write(file, (int32_t) poseId);
+        write(file, (uint32_t) keypoints.size());
+        for (auto& keypoint : keypoints)
+            write(file, keypoint);
+        write(file, descriptors);
+    }
+    mtxLog.unlock();
+}
+
+/// close the log and stop recording
+void MapLogWriter::finish(void) {
+    mtxLog.lock();
+    if (file.is_open())
+        file.close();
+    enabled = false;
+    mtxLog.unlock();
+}
+
+/// open the log
+bool MapLogReader::open(const std::string& filename) {
+    file.open(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "MapLogReader: unable to open " << filename << "\n";
+        return false;
+    }
+    std::vector<char> header(strlen(MapLog::header()));
+    uint32_t logVersion;
+    if (!file.read(header.data(), (std::streamsize) header.size()) || !read(file, logVersion)
+            || std::string(header.begin(), header.end()) != MapLog::header()) {
+        std::cout << "MapLogReader: " << filename << " is not a map log\n";
+        return false;
+    }
+    if (logVersion != MapLog::version) {
+        std::cout << "MapLogReader: unsupported version " << logVersion << " of " << filename << "\n";
+        return false;
+    }
+    return true;
+}
+
+/// replay the next record
+bool MapLogReader::replayNext(FeaturesMap& map) {
+    uint8_t type;
+    if (!read(file, type))
+        return false;
+    switch (type) {
+    case MapLog::RECORD_NEW_POSE: {
+        Mat34 cameraPoseChange;
+        double timestamp;
+        cv::Mat image, depthImage;
+        if (!read(file, cameraPoseChange) || !read(file, timestamp) || !read(file, image) || !read(file, depthImage))
+            return false;
+        map.addNewPose(cameraPoseChange, timestamp, image, depthImage);
+        break;
+    }
+    case MapLog::RECORD_FEATURES: {
+        int32_t poseId;
+        uint32_t featuresNo;
+        if (!read(file, poseId) || !read(file, featuresNo))
+            return false;
+        std::vector<RGBDFeature> features(featuresNo);
+        for (auto& feature : features)
+            if (!read(file, feature))
+                return false;
+        map.addFeatures(features, poseId);
+        break;
+    }
+    case MapLog::RECORD_MEASUREMENTS: {
+        int32_t poseId;
+        uint32_t featuresNo;
+        if (!read(file, poseId) || !read(file, featuresNo))
+            return false;
+        std::vector<MapFeature> features(featuresNo);
+        for (auto& feature : features)
+            if (!read(file, feature))
+                return false;
+        map.addMeasurements(features, poseId);
+        break;
+    }
+    case MapLog::RECORD_MEASUREMENT: {
+        int32_t poseFrom, poseTo;
+        Mat34 transformation;
+        if (!read(file, poseFrom) || !read(file, poseTo) || !read(file, transformation))
+            return false;
+        map.addMeasurement(poseFrom, poseTo, transformation);
+        break;
+    }
+    case MapLog::RECORD_FRAME_FEATURES: {
+        int32_t poseId;
+        uint32_t keypointsNo;
+        if (!read(file, poseId) || !read(file, keypointsNo))
+            return false;
+        std::vector<cv::KeyPoint> keypoints(keypointsNo);
+        for (auto& keypoint : keypoints)
+            if (!read(file, keypoint))
+                return false;
+        cv::Mat descriptors;
+        if (!read(file, descriptors))
+            return false;
+        map.addFrameFeatures(poseId, keypoints, descriptors);
+        break;
+    }
+    default:
+        std::cout << "MapLogReader: unknown record type " << (int) type << "\n";
+        return false;
+    }
+    recordsNo[type]++;
+    return true;
+}
+
+/// replay all records
+size_t MapLogReader::replayAll(FeaturesMap& map) {
+    size_t replayed = 0;
+    while (replayNext(map))
+        replayed++;
+    return replayed;
+}
@@ -7,6 +7,7 @@
 
 #include "Matcher/matcher.h"
 #include "Matcher/dbscan.h"
+#include "Utilities/profiler.h"
 
 #include <chrono>
 #include <assert.h>
@@ -14,19 +15,42 @@
 using namespace putslam;
 
 // Initial feature detection
-void Matcher::detectInitFeatures(const SensorFrame &sensorData) {
+/// Detect features and remove clustered ones (DBScan)
+std::vector<cv::KeyPoint> Matcher::detectFrameFeatures(const cv::Mat& rgbImage) {
+	PUTSLAM_PROFILE("matcher.detection");
 	// Detect salient features
-	prevKeyPoints = detectFeatures(sensorData.rgbImage);
+	mtxDetector.lock();
+	std::vector<cv::KeyPoint> keyPoints = detectFeatures(rgbImage);
+	mtxDetector.unlock();
 
 	if (matcherParameters.verbose > 2)
-		std::cout << "Before dbScan: " << prevKeyPoints.size() << std::endl;
+		std::cout << "Before dbScan: " << keyPoints.size() << std::endl;
 
 	// DBScan
 	DBScan dbscan(matcherParameters.OpenCVParams.DBScanEps);
-	dbscan.run(prevKeyPoints);
+	dbscan.run(keyPoints);
 
 	if (matcherParameters.verbose > 2)
-			std::cout << "After dbScan: " << prevKeyPoints.size() << std::endl;
+			std::cout << "After dbScan: " << keyPoints.size() << std::endl;
+	return keyPoints;
+}
+
+/// Set features detected in advance for the image
+void Matcher::setDetectedFeatures(const cv::Mat& rgbImage, const std::vector<cv::KeyPoint>& keyPoints) {
+	detectedFeaturesImage = rgbImage;
+	detectedFeatures = keyPoints;
+}
+
+/// Detected features of the image (detected in advance if available)
+std::vector<cv::KeyPoint> Matcher::getFrameFeatures(const cv::Mat& rgbImage) {
+	if (!detectedFeaturesImage.empty() && detectedFeaturesImage.data == rgbImage.data)
+		return detectedFeatures;
+	return detectFrameFeatures(rgbImage);
+}
+
+void Matcher::detectInitFeatures(const SensorFrame &sensorData) {
+	// Detect salient features
+	prevKeyPoints = getFrameFeatures(sensorData.rgbImage);
 
 	// Show detected features
 	if (matcherParameters.verbose > 2)
@@ -133,6 +157,7 @@ void Matcher::mergeTrackedFeatures(
 double Matcher::trackKLT(const SensorFrame& sensorData,
 		Eigen::Matrix4f &estimatedTransformation,
 		std::vector<cv::DMatch> &inlierMatches) {
+	PUTSLAM_PROFILE("matcher.trackKLT");
 
 	// Current 2D positions, 3D positions and found matches
 	//std::vector<cv::Point2f> undistortedFeatures2D(prevFeaturesUndistorted), distortedFeatures2D;
@@ -214,14 +239,10 @@ double Matcher::trackKLT(const SensorFrame& sensorData,
 	if ((int)undistortedFeatures2D.size()
 			< matcherParameters.OpenCVParams.minimalTrackedFeatures) {
 
-		// Detect new salient features
-		std::vector<cv::KeyPoint> keyPointsSandbox = detectFeatures(
+		// Detect new salient features (DBScan on detected features to remove groups of points)
+		std::vector<cv::KeyPoint> keyPointsSandbox = getFrameFeatures(
 				sensorData.rgbImage);
 
-		// DBScan on detected features to remove groups of points
-		DBScan dbscan(matcherParameters.OpenCVParams.DBScanEps);
-		dbscan.run(keyPointsSandbox);
-
 		// Extract 2D points from keypoints
 		std::vector<cv::Point2f> featuresSandBoxDistorted;
 		cv::KeyPoint::convert(keyPointsSandbox, featuresSandBoxDistorted);
@@ -452,13 +473,10 @@ double Matcher::trackKLT(const SensorFrame& sensorData,
 double Matcher::match(const SensorFrame& sensorData,
 		Eigen::Matrix4f &estimatedTransformation,
 		std::vector<cv::DMatch> &inlierMatches) {
+	PUTSLAM_PROFILE("matcher.match");
 
-	// Detect salient features
-	std::vector<cv::KeyPoint> keyPoints = detectFeatures(sensorData.rgbImage);
-
-	// DBScan
-	DBScan dbscan(matcherParameters.OpenCVParams.DBScanEps);
-	dbscan.run(keyPoints);
+	// Detect salient features (and DBScan)
+	std::vector<cv::KeyPoint> keyPoints = getFrameFeatures(sensorData.rgbImage);
 
 	if (matcherParameters.verbose > 1)
 		showFeatures(sensorData.rgbImage, keyPoints);
@@ -555,12 +573,8 @@ double Matcher::matchXYZ(std::vector<MapFeature> mapFeatures, int sensorPoseId,
 						prevDetDists,
 						frameIds, computationNumber);
 
-	// Detect salient features
-	prevKeyPoints = detectFeatures(prevRgbImage);
-
-	// DBScan
-	DBScan dbscan(matcherParameters.OpenCVParams.DBScanEps);
-	dbscan.run(prevKeyPoints);
+	// Detect salient features (and DBScan)
+	prevKeyPoints = getFrameFeatures(prevRgbImage);
 
 	// Show detected features
 	if (matcherParameters.verbose > 2)
@@ -613,6 +627,7 @@ double Matcher::matchXYZ(std::vector<MapFeature> mapFeatures, int sensorPoseId,
 		std::vector<int> frameIds,
 		int computationNumber)
 {
+	PUTSLAM_PROFILE("matcher.matchXYZ");
 
 	double matchingXYZSphereRadius = matcherParameters.OpenCVParams.matchingXYZSphereRadius;
 	double matchingXYZacceptRatioOfBestMatch = matcherParameters.OpenCVParams.matchingXYZacceptRatioOfBestMatch;
@@ -0,0 +1,104 @@
+#include "PUTSLAM/KeyframeIntegrator.h"
+
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+using namespace putslam;
+
+/// Construction
+KeyframeIntegrator::KeyframeIntegrator(const std::string& _name, Map* _map, const Config& _config) :
+    map(_map), name(_name), config(_config), nextPoseId(0), continueBuilding(false) {
+}
+
+/// start background thread
+void KeyframeIntegrator::start(void) {
+    continueBuilding = true;
+    builderThr.reset(new std::thread(&KeyframeIntegrator::build, this));
+}
+
+/// stop background thread
+void KeyframeIntegrator::stop(void) {
+    if (builderThr) {
+        continueBuilding = false;
+        builderThr->join();
+        builderThr.reset();
+    }
+}
+
+/// stop background thread, integrate remaining keyframes and re-integrate keyframes moved by the final optimization
+void KeyframeIntegrator::finish(void) {
+    stop();
+    update(true);
+}
+
+/// number of integrated keyframes
+size_t KeyframeIntegrator::getIntegratedNo(void) {
+    mtxIntegration.lock();
+    size_t size = poses.size();
+    mtxIntegration.unlock();
+    return size;
+}
+
+/// thread loop
+void KeyframeIntegrator::build(void) {
+    while (continueBuilding) {
+        if (!update(false))
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+}
+
+/// integrate new keyframes and re-integrate moved ones, returns true if the map was modified
+bool KeyframeIntegrator::update(bool final) {
+    bool modified = false;
+
+    // poses moved by the optimization -- the keyframe is removed with the pose used for integration
+    // and integrated again with the optimized pose
+    size_t reintegratedNo = 0;
+    mtxIntegration.lock();
+    for (auto& pose : poses) {
+        Mat34 newPose = map->getSensorPose(pose.first);
+        if (!poseChanged(pose.second, newPose))
+            continue;
+        if (reintegrateKeyframe(pose.first, pose.second, newPose)) {
+            pose.second = newPose;
+            reintegratedNo++;
+        }
+    }
+    mtxIntegration.unlock();
+    if (reintegratedNo > 0) {
+        modified = true;
+        if (config.verbose > 0)
+            std::cout << name << ": re-integrated " << reintegratedNo << " keyframes\n";
+    }
+
+    // new keyframes (the last pose is skipped while SLAM is running -- the keyframe is not selected yet)
+    // a few keyframes at once, so moved poses are checked frequently
+    int posesNo = final ? map->getPoseCounter() : map->getPoseCounter() - 1;
+    for (int keyframesNo = 0; nextPoseId < posesNo && (final || keyframesNo < 10); nextPoseId++) {
+        // images of other frames are removed by the map management
+        if (!map->isKeyframe(nextPoseId))
+            continue;
+        keyframesNo++;
+        Mat34 pose = map->getSensorPose(nextPoseId);
+        mtxIntegration.lock();
+        bool integrated = integrateKeyframe(nextPoseId, pose);
+        if (integrated)
+            poses[nextPoseId] = pose;
+        mtxIntegration.unlock();
+        if (!integrated)
+            continue;
+        modified = true;
+        if (config.verbose > 0)
+            std::cout << name << ": integrated keyframe with id = " << nextPoseId << "\n";
+    }
+    return modified;
+}
+
+/// check if pose moved significantly
+bool KeyframeIntegrator::poseChanged(const Mat34& poseA, const Mat34& poseB) const {
+    if ((poseA.translation() - poseB.translation()).norm() > config.reintegrationDist)
+        return true;
+    Eigen::AngleAxisd rotDiff(poseA.rotation().transpose() * poseB.rotation());
+    return std::fabs(rotDiff.angle()) > config.reintegrationAngle;
+}
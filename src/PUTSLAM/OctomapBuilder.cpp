@@ -0,0 +1,158 @@
+#include "PUTSLAM/OctomapBuilder.h"
+#include "RGBD/RGBD.h"
+
+#include <unordered_map>
+#include <cmath>
+
+using namespace putslam;
+
+/// Construction
+OctomapBuilder::OctomapBuilder(Map* _map, octomap::ColorOcTree* _tree, const cv::Mat& _cameraMatrix, double _depthImageScale, const Config& _config) :
+    KeyframeIntegrator("OctomapBuilder", _map, _config),
+    tree(_tree), cameraMatrix(_cameraMatrix.clone()), depthImageScale(_depthImageScale), config(_config) {
+}
+
+/// Destruction
+OctomapBuilder::~OctomapBuilder() {
+    stop();
+}
+
+/// stop background thread, integrate remaining keyframes using final poses and update inner nodes
+void OctomapBuilder::finish(void) {
+    KeyframeIntegrator::finish();
+    mtxIntegration.lock();
+    tree->updateInnerOccupancy();
+    mtxIntegration.unlock();
+}
+
+/// add occupancy (log-odds) and colors of the partial tree to the tree (reduction of trees built in parallel)
+void OctomapBuilder::mergeTree(const octomap::ColorOcTree& partial, octomap::ColorOcTree& tree) {
+    // log-odds updates are additive, so the sum of partial trees equals the sequential result (up to clamping)
+    const unsigned int treeDepth = partial.getTreeDepth();
+    const double resolution = partial.getResolution();
+    for (auto it = partial.begin_leafs(), end = partial.end_leafs(); it != end; ++it) {
+        octomap::ColorOcTreeNode::Color color = it->getColor();
+        if (it.getDepth() == treeDepth) {
+            tree.updateNode(it.getKey(), it->getLogOdds(), true);
+            tree.integrateNodeColor(it.getKey(), color.r, color.g, color.b);
+            continue;
+        }
+        // pruned leaf -- every voxel inside
+        octomap::point3d center = it.getCoordinate();
+        double halfSize = it.getSize() / 2.0;
+        for (double x = center.x() - halfSize + resolution / 2.0; x < center.x() + halfSize; x += resolution)
+            for (double y = center.y() - halfSize + resolution / 2.0; y < center.y() + halfSize; y += resolution)
+                for (double z = center.z() - halfSize + resolution / 2.0; z < center.z() + halfSize; z += resolution) {
+                    octomap::OcTreeKey key = tree.coordToKey(octomap::point3d((float) x, (float) y, (float) z));
+                    tree.updateNode(key, it->getLogOdds(), true);
+                    tree.integrateNodeColor(key, color.r, color.g, color.b);
+                }
+    }
+}
+
+/// integrate cloud of the keyframe, returns false if images are not available
+bool OctomapBuilder::integrateKeyframe(int poseId, const Mat34& pose) {
+    Cloud cloud;
+    if (!createCloud(poseId, cloud))
+        return false;
+    integrate(cloud, pose, 1);
+    clouds[poseId] = cloud;
+    return true;
+}
+
+/// remove cloud of the keyframe and integrate it with newPose
+bool OctomapBuilder::reintegrateKeyframe(int poseId, const Mat34& pose, const Mat34& newPose) {
+    const Cloud& cloud = clouds.at(poseId);
+    integrate(cloud, pose, -1);
+    integrate(cloud, newPose, 1);
+    return true;
+}
+
+/// create downsampled cloud from images
+bool OctomapBuilder::createCloud(int poseId, Cloud& cloud) {
+    cv::Mat rgbImage, depthImage;
+    map->getImages(poseId, rgbImage, depthImage);
+    if (rgbImage.empty() || depthImage.empty())
+        return false;
+
+    // cloud in the sensor frame
+    std::vector<std::pair<Eigen::Vector3f, Eigen::Vector3i>> colorPointCloud =
+            RGBD::imageToColorPointCloud(rgbImage, depthImage, cameraMatrix, Eigen::Matrix4f::Identity(), depthImageScale);
+
+    if (!config.downsample) {
+        cloud.points.reserve(colorPointCloud.size());
+        cloud.colors.reserve(colorPointCloud.size());
+        for (auto& point : colorPointCloud) {
+            cloud.points.push_back(point.first);
+            cloud.colors.push_back(point.second);
+        }
+        return true;
+    }
+
+    // voxel grid (octomap resolution) -- mean position and color of points in the voxel
+    const double resolution = tree->getResolution();
+    std::unordered_map<int64_t, std::pair<int, int>> voxels; // voxel -> (index, points no)
+    std::vector<Eigen::Vector3f> sumPoints;
+    std::vector<Eigen::Vector3i> sumColors;
+    for (auto& point : colorPointCloud) {
+        if (config.maxRange > 0 && point.first.norm() > config.maxRange)
+            continue;
+        int64_t x = (int64_t) std::floor(point.first.x() / resolution);
+        int64_t y = (int64_t) std::floor(point.first.y() / resolution);
+        int64_t z = (int64_t) std::floor(point.first.z() / resolution);
+        int64_t key = ((x & 0x1FFFFF) << 42) | ((y & 0x1FFFFF) << 21) | (z & 0x1FFFFF);
+        auto voxel = voxels.find(key);
+        if (voxel == voxels.end()) {
+            voxels[key] = std::make_pair((int) sumPoints.size(), 1);
+            sumPoints.push_back(point.first);
+            sumColors.push_back(point.second);
+        }
+        else {
+            sumPoints[voxel->second.first] += point.first;
+            sumColors[voxel->second.first] += point.second;
+            voxel->second.second++;
+        }
+    }
+    cloud.points.resize(sumPoints.size());
+    cloud.colors.resize(sumPoints.size());
+    for (auto& voxel : voxels) {
+        int idx = voxel.second.first;
+        cloud.points[idx] = sumPoints[idx] / (float) voxel.second.second;
+        cloud.colors[idx] = sumColors[idx] / voxel.second.second;
+    }
+    return true;
+}
+
+/// insert cloud acquired from the pose to the tree (sign > 0) or remove its contribution (sign < 0)
+void OctomapBuilder::integrate(const Cloud& cloud, const Mat34& pose, int sign) {
+    Eigen::Matrix3f rot = pose.rotation().cast<float>();
+    Eigen::Vector3f trans = pose.translation().cast<float>();
+    octomap::Pointcloud scan;
+    scan.reserve(cloud.points.size());
+    for (auto& point : cloud.points) {
+        Eigen::Vector3f pointWorld = rot * point + trans;
+        scan.push_back(pointWorld.x(), pointWorld.y(), pointWorld.z());
+    }
+    octomap::point3d origin(trans.x(), trans.y(), trans.z());
+
+    if (sign > 0) {
+        // batched ray casting, every voxel is updated once per scan
+        tree->insertPointCloud(scan, origin, config.maxRange, true, true);
+        for (size_t i = 0; i < cloud.points.size(); i++) {
+            Eigen::Vector3f pointWorld = rot * cloud.points[i] + trans;
+            tree->integrateNodeColor(pointWorld.x(), pointWorld.y(), pointWorld.z(),
+                    (uint8_t) cloud.colors[i].x(), (uint8_t) cloud.colors[i].y(), (uint8_t) cloud.colors[i].z());
+        }
+    }
+    else {
+        // the same cells as in insertPointCloud, inverse log-odds updates (approximate if clamping was reached)
+        octomap::KeySet freeCells, occupiedCells;
+        tree->computeDiscreteUpdate(scan, origin, freeCells, occupiedCells, config.maxRange);
+        for (auto& key : freeCells) {
+            if (occupiedCells.find(key) == occupiedCells.end())
+                tree->updateNode(key, -tree->getProbMissLog(), true);
+        }
+        for (auto& key : occupiedCells)
+            tree->updateNode(key, -tree->getProbHitLog(), true);
+    }
+}
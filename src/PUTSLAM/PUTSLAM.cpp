@@ -1,6 +1,8 @@
 #include "PUTSLAM/PUTSLAM.h"
 #include "Utilities/simulator.h"
 #include "Utilities/stopwatch.h"
+#include "Utilities/profiler.h"
+#include "Utilities/trajectoryEvaluation.h"
 #include "MotionModel/decayingVelocityModel.h"
 
 
@@ -253,13 +255,73 @@ void PUTSLAM::createAndSaveOctomap(double depthImageScale) {
 void PUTSLAM::createAndSaveOctomapOffline(double depthImageScale) {
 	std::ifstream reconstructStr("reconstruction.res");
 
+	int threadsNo = octomapOfflineThreads;
+	if (threadsNo < 1)
+		threadsNo = std::max(1, (int) std::thread::hardware_concurrency());
+	// partial tree is merged when it has more nodes (bounds memory of workers)
+	const size_t maxPartialTreeSize = 2000000;
+	// frames waiting for workers (frames are streamed from disk)
+	const size_t maxQueueSize = 2 * threadsNo;
+
+	std::deque<std::pair<Eigen::Matrix4f, SensorFrame>> frameQueue;
+	std::mutex mtxQueue, mtxTree;
+	std::condition_variable queueNotEmpty, queueNotFull;
+	bool endOfSequence = false;
+
+	// each worker integrates its frames into a partial tree, partial trees are merged into octomapTree
+	auto worker = [&]() {
+		octomap::ColorOcTree partialTree(octomapResolution);
+		while (1) {
+			std::unique_lock<std::mutex> lock(mtxQueue);
+			queueNotEmpty.wait(lock, [&]() {return !frameQueue.empty() || endOfSequence;});
+			if (frameQueue.empty())
+				break;
+			std::pair<Eigen::Matrix4f, SensorFrame> frame = frameQueue.front();
+			frameQueue.pop_front();
+			lock.unlock();
+			queueNotFull.notify_one();
+
+			std::vector<std::pair<Eigen::Vector3f, Eigen::Vector3i>> colorPointCloud =
+					RGBD::imageToColorPointCloud(frame.second.rgbImage,
+							frame.second.depthImage,
+							matcher->matcherParameters.cameraMatrixMat, frame.first,
+							depthImageScale);
+
+			// lazy evaluation -- inner nodes are updated once, after the merge
+			for (unsigned int k = 0; k < colorPointCloud.size(); k++) {
+				partialTree.updateNode((float) colorPointCloud[k].first.x(),
+						(float) colorPointCloud[k].first.y(),
+						(float) colorPointCloud[k].first.z(), true, true);
+				partialTree.integrateNodeColor(
+						(float) colorPointCloud[k].first.x(),
+						(float) colorPointCloud[k].first.y(),
+						(float) colorPointCloud[k].first.z(),
+						(uint8_t) colorPointCloud[k].second.x(),
+						(uint8_t) colorPointCloud[k].second.y(),
+						(uint8_t) colorPointCloud[k].second.z());
+			}
+
+			if (partialTree.size() > maxPartialTreeSize) {
+				mtxTree.lock();
+				OctomapBuilder::mergeTree(partialTree, *octomapTree.get());
+				mtxTree.unlock();
+				partialTree.clear();
+			}
+		}
+		mtxTree.lock();
+		OctomapBuilder::mergeTree(partialTree, *octomapTree.get());
+		mtxTree.unlock();
+	};
+	std::vector<std::thread> workers;
+	for (int j = 0; j < threadsNo; j++)
+		workers.push_back(std::thread(worker));
+
 	int i = 0;
 	while (1) {
 		bool middleOfSequence = grabber->grab(); // grab frame
 		if (!middleOfSequence)
 			break;
 
-		SensorFrame currentSensorFrame = grabber->getSensorFrame();
 		float timeS, tx, ty, tz, qw, qx, qy, qz;
 		reconstructStr >> timeS >> tx >> ty >> tz >> qx >> qy >> qz >> qw;
 
@@ -274,32 +336,25 @@ void PUTSLAM::createAndSaveOctomapOffline(double depthImageScale) {
 			tmpPose(1, 3) = ty;
 			tmpPose(2, 3) = tz;
 
-			// Save for octomap
-			std::vector<std::pair<Eigen::Vector3f, Eigen::Vector3i>> colorPointCloud =
-					RGBD::imageToColorPointCloud(currentSensorFrame.rgbImage,
-							currentSensorFrame.depthImage,
-							matcher->matcherParameters.cameraMatrixMat, tmpPose,
-							depthImageScale);
-
-			for (unsigned int k = 0; k < colorPointCloud.size(); k++) {
-				octomap::point3d endpoint((float) colorPointCloud[k].first.x(),
-						(float) colorPointCloud[k].first.y(),
-						(float) colorPointCloud[k].first.z());
-				octomap::ColorOcTreeNode* n = octomapTree.get()->updateNode(
-						endpoint, true);
-
-				octomapTree.get()->integrateNodeColor(
-						(float) colorPointCloud[k].first.x(),
-						(float) colorPointCloud[k].first.y(),
-						(float) colorPointCloud[k].first.z(),
-						(uint8_t) colorPointCloud[k].second.x(),
-						(uint8_t) colorPointCloud[k].second.y(),
-						(uint8_t) colorPointCloud[k].second.z());
-			}
+			// images are copied -- the grabber might reuse its buffers
+			SensorFrame currentSensorFrame = grabber->getSensorFrame();
+			currentSensorFrame.rgbImage = currentSensorFrame.rgbImage.clone();
+			currentSensorFrame.depthImage = currentSensorFrame.depthImage.clone();
 
+			std::unique_lock<std::mutex> lock(mtxQueue);
+			queueNotFull.wait(lock, [&]() {return frameQueue.size() < maxQueueSize;});
+			frameQueue.push_back(std::make_pair(tmpPose, currentSensorFrame));
+			lock.unlock();
+			queueNotEmpty.notify_one();
 		}
 		i++;
 	}
+	mtxQueue.lock();
+	endOfSequence = true;
+	mtxQueue.unlock();
+	queueNotEmpty.notify_all();
+	for (auto& workerThr : workers)
+		workerThr.join();
 
 	// set inner node colors
 	std::cout << "Updating tree color" << std::endl;
@@ -324,6 +379,7 @@ void PUTSLAM::processFirstFrame(SensorFrame &currentSensorFrame,
 	if (!onlyVO) {
 		cameraPoseId = map->addNewPose(cameraPose, currentSensorFrame.timestamp,
 				currentSensorFrame.rgbImage, currentSensorFrame.depthImage);
+		addFrameFeaturesToMap(cameraPoseId);
 	}
 
 	// Correct motionModel
@@ -399,6 +455,16 @@ void PUTSLAM::setDrawOptions(bool _draw, bool _drawImages) {
 	map->setDrawOptions(visualize);
 }
 
+void PUTSLAM::setHeadless() {
+	setDrawOptions(false, false);
+	verbose = 0;
+	// matchers show features and matches in windows if verbose > 0
+	matcher->matcherParameters.verbose = 0;
+	matcher->matcherParameters.RANSACParams.verbose = 0;
+	loopClosureMatcher->matcherParameters.verbose = 0;
+	loopClosureMatcher->matcherParameters.RANSACParams.verbose = 0;
+}
+
 // At beggining
 void PUTSLAM::readingSomeParameters() {
 
@@ -445,6 +511,36 @@ void PUTSLAM::initialization() {
 	if (octomap > 0)
 		octomapTree.reset(new octomap::ColorOcTree(octomapResolution));
 
+	// Octomap integrated in the background as keyframes appear
+	if (octomap > 0 && octomapOnline > 0 && octomapOffline == 0) {
+		OctomapBuilder::Config builderConfig;
+		builderConfig.verbose = verbose;
+		builderConfig.maxRange = octomapMaxRange;
+		builderConfig.reintegrationDist = octomapReintegrationDist;
+		builderConfig.reintegrationAngle = octomapReintegrationAngle;
+		octomapBuilder.reset(new OctomapBuilder(map, octomapTree.get(),
+				matcher->matcherParameters.cameraMatrixMat, depthImageScale,
+				builderConfig));
+		octomapBuilder->start();
+	}
+
+	// TSDF integrated in the background as keyframes appear, re-integrated when the optimization moves them
+	if (tsdf > 0) {
+		TSDFVolume::Config tsdfConfig;
+		tsdfConfig.voxelSize = tsdfVoxelSize;
+		tsdfConfig.truncation = tsdfTruncation;
+		tsdfConfig.maxDepth = tsdfMaxDepth;
+		tsdfVolume.reset(new TSDFVolume(tsdfConfig));
+		TSDFBuilder::Config builderConfig;
+		builderConfig.verbose = verbose;
+		builderConfig.reintegrationDist = tsdfReintegrationDist;
+		builderConfig.reintegrationAngle = tsdfReintegrationAngle;
+		tsdfBuilder.reset(new TSDFBuilder(map, tsdfVolume.get(),
+				matcher->matcherParameters.cameraMatrixMat, depthImageScale,
+				builderConfig));
+		tsdfBuilder->start();
+	}
+
 	if (octomapOffline > 0) {
 		createAndSaveOctomapOffline(depthImageScale);
 		exit(0);
@@ -470,6 +566,59 @@ void PUTSLAM::loadConfigs() {
 			"octomapFileToSave");
 	config.FirstChildElement("PUTSLAM")->QueryIntAttribute("octomapOffline",
 			&octomapOffline);
+	frontendPipeline = 0;
+	frontendQueueSize = 2;
+	config.FirstChildElement("PUTSLAM")->QueryIntAttribute("frontendPipeline",
+			&frontendPipeline);
+	config.FirstChildElement("PUTSLAM")->QueryIntAttribute("frontendQueueSize",
+			&frontendQueueSize);
+	profile = 0;
+	profileFilename = "putslamProfile";
+	config.FirstChildElement("PUTSLAM")->QueryIntAttribute("profile", &profile);
+	if (config.FirstChildElement("PUTSLAM")->Attribute("profileFilename"))
+		profileFilename = config.FirstChildElement("PUTSLAM")->Attribute(
+				"profileFilename");
+	Profiler::get().setEnabled(profile > 0, profile > 1);
+	tsdf = 0;
+	tsdfVoxelSize = 0.01;
+	tsdfTruncation = 0.04;
+	tsdfMaxDepth = 4.0;
+	tsdfReintegrationDist = 0.05;
+	tsdfReintegrationAngle = 0.05;
+	tsdfFileToSave = "putslamMesh.ply";
+	config.FirstChildElement("PUTSLAM")->QueryIntAttribute("tsdf", &tsdf);
+	config.FirstChildElement("PUTSLAM")->QueryDoubleAttribute("tsdfVoxelSize",
+			&tsdfVoxelSize);
+	config.FirstChildElement("PUTSLAM")->QueryDoubleAttribute("tsdfTruncation",
+			&tsdfTruncation);
+	config.FirstChildElement("PUTSLAM")->QueryDoubleAttribute("tsdfMaxDepth",
+			&tsdfMaxDepth);
+	config.FirstChildElement("PUTSLAM")->QueryDoubleAttribute(
+			"tsdfReintegrationDist", &tsdfReintegrationDist);
+	config.FirstChildElement("PUTSLAM")->QueryDoubleAttribute(
+			"tsdfReintegrationAngle", &tsdfReintegrationAngle);
+	if (config.FirstChildElement("PUTSLAM")->Attribute("tsdfFileToSave"))
+		tsdfFileToSave = config.FirstChildElement("PUTSLAM")->Attribute(
+				"tsdfFileToSave");
+	if (!keepCameraFrames && tsdf)
+		throw std::runtime_error(
+				std::string(
+						"Camera frames are not used (keepCameraFrames==false). TSDF is not available.\nModify config files.\n"));
+	octomapOfflineThreads = 0;
+	config.FirstChildElement("PUTSLAM")->QueryIntAttribute(
+			"octomapOfflineThreads", &octomapOfflineThreads);
+	octomapOnline = 0;
+	octomapMaxRange = -1.0;
+	octomapReintegrationDist = 0.05;
+	octomapReintegrationAngle = 0.05;
+	config.FirstChildElement("PUTSLAM")->QueryIntAttribute("octomapOnline",
+			&octomapOnline);
+	config.FirstChildElement("PUTSLAM")->QueryDoubleAttribute("octomapMaxRange",
+			&octomapMaxRange);
+	config.FirstChildElement("PUTSLAM")->QueryDoubleAttribute(
+			"octomapReintegrationDist", &octomapReintegrationDist);
+	config.FirstChildElement("PUTSLAM")->QueryDoubleAttribute(
+			"octomapReintegrationAngle", &octomapReintegrationAngle);
 	if (!keepCameraFrames && octomap)
 		throw std::runtime_error(
 				std::string(
@@ -576,6 +725,7 @@ void PUTSLAM::loadConfigs() {
 }
 
 Eigen::Matrix4f PUTSLAM::runVO(SensorFrame &currentSensorFrame, std::vector<cv::DMatch> &inlierMatches) {
+	PUTSLAM_PROFILE("frontend.VO");
 	Stopwatch<> voTime;
 	Eigen::Matrix4f transformation;
 	double inlierRatio = matcher->Matcher::runVO(currentSensorFrame,
@@ -598,10 +748,19 @@ void PUTSLAM::addPoseToMap(SensorFrame &currentSensorFrame, Eigen::Matrix4f &pos
 	cameraPoseId = map->addNewPose(cameraPoseIncrement,
 			currentSensorFrame.timestamp, currentSensorFrame.rgbImage,
 			currentSensorFrame.depthImage);
+	addFrameFeaturesToMap(cameraPoseId);
 	tmp.stop();
 	timeMeasurement.mapAddNewPoseTimes.push_back((long int)tmp.elapsed());
 }
 
+/// pass keypoints and descriptors of the current frame to the map (LC uses them instead of images)
+void PUTSLAM::addFrameFeaturesToMap(int cameraPoseId) {
+	if (loopClosureThreadVersion == LCTHREAD_ON && ((FeaturesMap*) map)->useFrontendFeaturesLC()) {
+		Matcher::featureSet features = matcher->getFeatures();
+		((FeaturesMap*) map)->addFrameFeatures(cameraPoseId, features.feature2D, features.descriptors);
+	}
+}
+
 Mat34 PUTSLAM::getMapPoseEstimate() {
 	Stopwatch<> tmp;
 	tmp.start();
@@ -673,14 +832,114 @@ std::vector<double> &angles ) {
 	return mapFeatures;
 }
 
+/// Next frame to process (from the grabber or the pipeline)
+bool PUTSLAM::getNextFrame(SensorFrame &currentSensorFrame, bool measureTime) {
+	Stopwatch<> waitTime;
+	waitTime.start();
+	if (frontendPipeline > 0) {
+		PipelineFrame pipelineFrame;
+		bool middleOfSequence = detectionQueue->pop(pipelineFrame);
+		waitTime.stop();
+		if (!middleOfSequence)
+			return false;
+		currentSensorFrame = pipelineFrame.frame;
+		matcher->setDetectedFeatures(currentSensorFrame.rgbImage, pipelineFrame.keyPoints);
+		if (measureTime) {
+			timeMeasurement.grabTimes.push_back(pipelineFrame.grabTime);
+			timeMeasurement.detectionTimes.push_back(pipelineFrame.detectionTime);
+			timeMeasurement.pipelineWaitTimes.push_back((long int) waitTime.elapsed());
+		}
+		return true;
+	}
+
+	bool middleOfSequence;
+	{
+		PUTSLAM_PROFILE("frontend.grab");
+		middleOfSequence = grabber->grab();
+		if (middleOfSequence)
+			currentSensorFrame = grabber->getSensorFrame();
+	}
+	if (!middleOfSequence)
+		return false;
+	waitTime.stop();
+	if (measureTime)
+		timeMeasurement.grabTimes.push_back((long int) waitTime.elapsed());
+	return true;
+}
+
+/// Start acquisition and detection stages
+void PUTSLAM::startFrontendPipeline() {
+	acquisitionQueue.reset(new BoundedQueue<PipelineFrame>(frontendQueueSize));
+	detectionQueue.reset(new BoundedQueue<PipelineFrame>(frontendQueueSize));
+	acquisitionThr.reset(new std::thread(&PUTSLAM::acquisitionStage, this));
+	detectionThr.reset(new std::thread(&PUTSLAM::detectionStage, this));
+}
+
+/// Stop acquisition and detection stages
+void PUTSLAM::finishFrontendPipeline() {
+	acquisitionQueue->close();
+	detectionQueue->close();
+	acquisitionThr->join();
+	detectionThr->join();
+	acquisitionThr.reset();
+	detectionThr.reset();
+}
+
+/// Pipeline stage: grabbing frames
+void PUTSLAM::acquisitionStage() {
+	Profiler::get().setThreadName("acquisition");
+	while (true) {
+		PipelineFrame pipelineFrame;
+		Stopwatch<> grabTime;
+		grabTime.start();
+		{
+			// the blocking push to the full queue is not a part of the stage
+			PUTSLAM_PROFILE("frontend.grab");
+			if (!grabber->grab())
+				break;
+			// images are copied -- the grabber might reuse its buffers while the frame is queued
+			pipelineFrame.frame = grabber->getSensorFrame();
+			pipelineFrame.frame.rgbImage = pipelineFrame.frame.rgbImage.clone();
+			pipelineFrame.frame.depthImage = pipelineFrame.frame.depthImage.clone();
+		}
+		grabTime.stop();
+		pipelineFrame.grabTime = (long int) grabTime.elapsed();
+		pipelineFrame.detectionTime = 0;
+		if (!acquisitionQueue->push(pipelineFrame))
+			break;
+	}
+	acquisitionQueue->close();
+}
+
+/// Pipeline stage: feature detection (the same detection as in VO, so results do not change)
+void PUTSLAM::detectionStage() {
+	Profiler::get().setThreadName("detection");
+	PipelineFrame pipelineFrame;
+	while (acquisitionQueue->pop(pipelineFrame)) {
+		Stopwatch<> detectionTime;
+		detectionTime.start();
+		pipelineFrame.keyPoints = matcher->detectFrameFeatures(pipelineFrame.frame.rgbImage);
+		detectionTime.stop();
+		pipelineFrame.detectionTime = (long int) detectionTime.elapsed();
+		if (!detectionQueue->push(pipelineFrame))
+			break;
+	}
+	detectionQueue->close();
+}
+
 // Processing
 void PUTSLAM::startProcessing() {
     getFrameEvent.lock();
 	readingSomeParameters();
 	initialization();
 
+	// Frames are grabbed and features detected while the current frame is processed
+	if (frontendPipeline > 0)
+		startFrontendPipeline();
+
 	int frameCounter = 0;
 	auto startMainLoop = std::chrono::system_clock::now();
+	Profiler::get().setThreadName("frontend");
 	SensorFrame lastSensorFrame;
 
 	// Main loop
@@ -693,12 +952,10 @@ void PUTSLAM::startProcessing() {
 
 
 		// Get the frame to processing
-		bool middleOfSequence = grabber->grab();
-		if (!middleOfSequence)
+		SensorFrame currentSensorFrame;
+		if (!getNextFrame(currentSensorFrame, frameCounter > 0))
 			break;
-
-
-        SensorFrame currentSensorFrame = grabber->getSensorFrame();
+		PUTSLAM_PROFILE("frontend.frame");
 
 		if (drawImages) {
 			cv::imshow("PUTSLAM RGB frame", currentSensorFrame.rgbImage);
@@ -740,6 +997,7 @@ void PUTSLAM::startProcessing() {
 			VOPoseEstimate = VOPoseEstimate * poseIncrement;
 
 			if (!onlyVO) {
+				PUTSLAM_PROFILE("frontend.map");
 
 				Stopwatch<> mapTime;
 				mapTime.start();
@@ -920,6 +1178,9 @@ void PUTSLAM::startProcessing() {
         depthImgimg=currentSensorFrame.depthImage;
         getFrameEvent.unlock();
 	}
+	if (frontendPipeline > 0)
+		finishFrontendPipeline();
+
 	auto elapsed = std::chrono::duration_cast < std::chrono::milliseconds
 			> (std::chrono::system_clock::now() - startMainLoop);
 	saveFPS(double(frameCounter) / ((double)elapsed.count() / 1000.0));
@@ -953,6 +1214,8 @@ void PUTSLAM::removeMapFeaturesWithoutGoodObservationAngle(
 
 void PUTSLAM::saveStatistics() {
 std::cout << "save2file\n";
+	// close the log of frontend calls (the process may exit without destroying the map)
+	((FeaturesMap*) map)->finishRecording();
 	//map->save2file("createdMapFile.map", "preOptimizedGraphFile.g2o");
 
 	// Wait for management thread to finish
@@ -983,6 +1246,16 @@ std::cout << "save2file\n";
 	// Save times
 	std::cout << "Saving times" << std::endl;
 	timeMeasurement.saveToFile();
+	if (profile > 0) {
+		Profiler::get().printStats(std::cout);
+		Profiler::get().saveCSV(profileFilename + ".csv");
+		if (profile > 1)
+			Profiler::get().saveTrace(profileFilename + ".json");
+	}
+#ifdef PUTSLAM_LOCK_STATS
+	LockStatsRegistry::get().print(std::cout);
+	LockStatsRegistry::get().saveCSV("lockStats.csv");
+#endif
 
 	// Save statistics
 	std::cout << "Saving logs to file" << std::endl;
@@ -999,8 +1272,24 @@ std::cout << "save2file\n";
 
 	// Save map
 	std::cout << "Saving to octomap" << std::endl;
-	if (octomap > 0)
+	if (octomapBuilder) {
+		// only keyframes moved by the final optimization are re-integrated
+		octomapBuilder->finish();
+		octomapBuilder.reset();
+		octomapTree.get()->write(std::string(octomapFileToSave));
+	}
+	else if (octomap > 0)
 		createAndSaveOctomap(depthImageScale);
+
+	// Save dense mesh
+	if (tsdfBuilder) {
+		// only frames moved by the final optimization are re-integrated
+		tsdfBuilder->finish();
+		tsdfBuilder.reset();
+		std::cout << "Writing TSDF mesh to " << tsdfFileToSave << std::endl;
+		tsdfVolume->saveMesh(tsdfFileToSave);
+		tsdfVolume.reset();
+	}
 }
 
 void PUTSLAM::saveTrajectoryFreiburgFormat(Eigen::Matrix4f transformation,
@@ -1244,6 +1533,18 @@ void PUTSLAM::evaluateResults(std::string basePath, std::string datasetName) {
 	datasetNameStream << fullPath;
 	datasetNameStream.close();
 
+	// Trajectory accuracy (files in the format of evaluate_ate.py/evaluate_rpe.py --verbose)
+	TrajectoryEvaluator::Trajectory groundtruth;
+	if (TrajectoryEvaluator::loadTrajectory(fullPath + "groundtruth.txt", groundtruth)) {
+		TrajectoryEvaluator::Config evaluationConfig;
+		evaluationConfig.fixedDelta = true;
+		evaluationConfig.deltaUnit = 'f';
+		TrajectoryEvaluator evaluator(evaluationConfig);
+		evaluator.evaluate(groundtruth, "VO_trajectory.res", "VOAte.res", "VORpe.res");
+		if (optimizationThreadVersion != OPTTHREAD_OFF)
+			evaluator.evaluate(groundtruth, "graph_trajectory.res", "g2oAte.res", "g2oRpe.res");
+	}
+
 }
 
 void PUTSLAM::showMapFeatures(cv::Mat rgbImage,
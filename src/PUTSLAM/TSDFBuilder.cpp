@@ -0,0 +1,36 @@
+#include "PUTSLAM/TSDFBuilder.h"
+
+using namespace putslam;
+
+/// Construction
+TSDFBuilder::TSDFBuilder(Map* _map, TSDFVolume* _volume, const cv::Mat& _cameraMatrix, double _depthImageScale, const Config& _config) :
+    KeyframeIntegrator("TSDFBuilder", _map, _config),
+    volume(_volume), cameraMatrix(_cameraMatrix.clone()), depthImageScale(_depthImageScale) {
+}
+
+/// Destruction
+TSDFBuilder::~TSDFBuilder() {
+    stop();
+}
+
+/// integrate images of the keyframe, returns false if images are not available
+bool TSDFBuilder::integrateKeyframe(int poseId, const Mat34& pose) {
+    cv::Mat rgbImage, depthImage;
+    map->getImages(poseId, rgbImage, depthImage);
+    if (depthImage.empty())
+        return false;
+    volume->integrate(rgbImage, depthImage, cameraMatrix, pose, depthImageScale, 1.0f);
+    return true;
+}
+
+/// remove images of the keyframe (taken from the map again) and integrate them with newPose
+bool TSDFBuilder::reintegrateKeyframe(int poseId, const Mat34& pose, const Mat34& newPose) {
+    // images of keyframes are kept by the map, so the same data is removed (negative weight)
+    cv::Mat rgbImage, depthImage;
+    map->getImages(poseId, rgbImage, depthImage);
+    if (depthImage.empty())
+        return false;
+    volume->integrate(rgbImage, depthImage, cameraMatrix, pose, depthImageScale, -1.0f);
+    volume->integrate(rgbImage, depthImage, cameraMatrix, newPose, depthImageScale, 1.0f);
+    return true;
+}
@@ -5,6 +5,7 @@
  */
 
 #include "PoseGraph/graph_g2o.h"
+#include "Utilities/profiler.h"
 #include <stdexcept>
 #include <chrono>
 
@@ -29,22 +30,12 @@ putslam::Graph* putslam::createPoseGraphG2O(Mat34 cameraPose) {
     return graph_g2o.get();
 }
 
-PoseGraphG2O::PoseGraphG2O(void) : Graph("Pose Graph g2o") {
-    // create the linear solver
-    //linearSolver = new g2o::LinearSolverCSparse<g2o::BlockSolverX::PoseMatrixType>();
-    linearSolver = new g2o::LinearSolverPCG<g2o::BlockSolverX::PoseMatrixType>();
-
-    // create the block solver on top of the linear solver
-    //blockSolver = new g2o::BlockSolverX(linearSolver);
-    blockSolver = new g2o::BlockSolverX(linearSolver);
-
-    // create the algorithm to carry out the optimization
-    g2o::OptimizationAlgorithmGaussNewton* optimizationAlgorithm = new g2o::OptimizationAlgorithmGaussNewton(blockSolver);
-    //g2o::OptimizationAlgorithmWithHessian* optimizationAlgorithm = new g2o::OptimizationAlgorithmWithHessian(blockSolver);
-    //g2o::OptimizationAlgorithmLevenberg* optimizationAlgorithm = new g2o::OptimizationAlgorithmLevenberg(blockSolver);
+PoseGraphG2O::PoseGraphG2O(void) : Graph("Pose Graph g2o"), optimizationAlgorithm(nullptr), marginalizeFeatures(false),
+        incrementalOpt(false), incrementalStep(false), incrementalDepth(2), relinearizationThr(0.01), fullOptimizationPeriod(0), optimizationsSinceFull(0) {
+    // default solver: Gauss-Newton, PCG with the dynamic block solver
+    setSolver("PCG", "X", "GaussNewton");
 
     optimizer.setVerbose(true);
-    optimizer.setAlgorithm(optimizationAlgorithm);
 
     factory = g2o::Factory::instance();
 
@@ -57,11 +48,18 @@ PoseGraphG2O::PoseGraphG2O(void) : Graph("Pose Graph g2o") {
     cameraOffset->setOffset(cameraPose);
     optimizer.addParameter(cameraOffset);
 
-//	  TODO: Uncomment if it is working
-//    g2o::ParameterCamera *pc = new g2o::ParameterCamera();
-//    pc->setKcam(525.0, 525.0, 320.0, 240.0);
-//
-//    optimizer.addParameter(pc);
+    // camera parameters for the reprojection error (EDGE_3D_REPROJ)
+    cameraParameters = new g2o::ParameterCamera();
+    cameraParameters->setId(1);
+    cameraParameters->setKcam(525.0, 525.0, 320.0, 240.0);
+    optimizer.addParameter(cameraParameters);
+}
+
+/// set camera parameters used by the reprojection error edges
+void PoseGraphG2O::setCameraParameters(double fu, double fv, double cu, double cv){
+    mtxGraph.lock();
+    cameraParameters->setKcam(fu, fv, cu, cv);
+    mtxGraph.unlock();
 }
 
 PoseGraphG2O::PoseGraphG2O(Mat34& cameraPose) : PoseGraphG2O() {
@@ -81,6 +79,132 @@ const std::string& PoseGraphG2O::getName() const {
     return name;
 }
 
+/// create block solver of the required structure on top of the selected linear solver
+template <typename BlockSolverType>
+g2o::Solver* PoseGraphG2O::createBlockSolver(const std::string& linearSolverName){
+    typename BlockSolverType::LinearSolverType* linearSolver;
+    if (linearSolverName=="PCG")
+        linearSolver = new g2o::LinearSolverPCG<typename BlockSolverType::PoseMatrixType>();
+    else if (linearSolverName=="CSparse")
+        linearSolver = new g2o::LinearSolverCSparse<typename BlockSolverType::PoseMatrixType>();
+    else if (linearSolverName=="Eigen")
+        linearSolver = new g2o::LinearSolverEigen<typename BlockSolverType::PoseMatrixType>();
+#ifdef G2O_HAVE_CHOLMOD
+    else if (linearSolverName=="Cholmod")
+        linearSolver = new g2o::LinearSolverCholmod<typename BlockSolverType::PoseMatrixType>();
+#endif
+    else {
+        std::cout << "error: unknown (or unavailable) linear solver: " << linearSolverName << "\n";
+        return nullptr;
+    }
+    return new BlockSolverType(linearSolver);
+}
+
+/// set linear solver, block solver and optimization algorithm
+bool PoseGraphG2O::setSolver(const std::string& linearSolverName, const std::string& blockSolverName, const std::string& algorithmName){
+    if (algorithmName!="GaussNewton"&&algorithmName!="Levenberg"){
+        std::cout << "error: unknown optimization algorithm: " << algorithmName << "\n";
+        return false;
+    }
+    g2o::Solver* solver;
+    if (blockSolverName=="X")
+        solver = createBlockSolver<g2o::BlockSolverX>(linearSolverName);
+    else if (blockSolverName=="6_3")
+        solver = createBlockSolver<g2o::BlockSolver_6_3>(linearSolverName);
+    else {
+        std::cout << "error: unknown block solver: " << blockSolverName << "\n";
+        return false;
+    }
+    if (solver==nullptr)
+        return false;
+
+    mtxGraph.lock();
+    blockSolver = solver;
+    g2o::OptimizationAlgorithm* prevAlgorithm = optimizationAlgorithm;
+    if (algorithmName=="GaussNewton")
+        optimizationAlgorithm = new g2o::OptimizationAlgorithmGaussNewton(blockSolver);
+    else
+        optimizationAlgorithm = new g2o::OptimizationAlgorithmLevenberg(blockSolver);
+    optimizer.setAlgorithm(optimizationAlgorithm);
+    delete prevAlgorithm;
+
+    // the fixed-size block solver keeps features (3D) in the landmark part of the Hessian
+    marginalizeFeatures = (blockSolverName=="6_3");
+    for (auto it = optimizer.vertices().begin(); it != optimizer.vertices().end(); ++it) {
+        g2o::VertexPointXYZ* v = dynamic_cast<g2o::VertexPointXYZ*>(it->second);
+        if (v!=nullptr)
+            v->setMarginalized(marginalizeFeatures);
+    }
+    solverName = algorithmName + "/" + linearSolverName + "/" + blockSolverName;
+    mtxGraph.unlock();
+    return true;
+}
+
+/// returns name of the current solver (algorithm/linear solver/block solver)
+const std::string& PoseGraphG2O::getSolverName(void) const {
+    return solverName;
+}
+
+/// set incremental optimization
+void PoseGraphG2O::setIncrementalOptimization(bool enable, int neighbourhoodDepth, double _relinearizationThr, int _fullOptimizationPeriod){
+    mtxGraph.lock();
+    incrementalOpt = enable;
+    incrementalDepth = std::max(neighbourhoodDepth,1);
+    relinearizationThr = _relinearizationThr;
+    fullOptimizationPeriod = _fullOptimizationPeriod;
+    optimizationsSinceFull = 0;
+    incrementalStep = false;
+    relinearizeVertices.clear();
+    mtxGraph.unlock();
+}
+
+/// select edges optimized in the incremental step and vertices which bound the active part of the graph
+void PoseGraphG2O::selectIncrementalSet(g2o::HyperGraph::EdgeSet& activeEdges, g2o::HyperGraph::VertexSet& activeVertices, g2o::HyperGraph::VertexSet& boundaryVertices){
+    // start from the new vertices and vertices which moved in the previous step
+    g2o::HyperGraph::VertexSet frontier(newVertices);
+    for (const auto& vertexId : relinearizeVertices){
+        g2o::HyperGraph::Vertex* v = optimizer.vertex(vertexId);
+        if (v!=nullptr)
+            frontier.insert(v);
+    }
+    relinearizeVertices.clear();
+    activeVertices = frontier;
+    // breadth-first search (depth limited)
+    for (int depth=1; depth<incrementalDepth && !frontier.empty(); depth++){
+        g2o::HyperGraph::VertexSet nextFrontier;
+        for (const auto& v : frontier){
+            for (const auto& e : v->edges()){
+                if (static_cast<g2o::OptimizableGraph::Edge*>(e)->level()!=0)
+                    continue;
+                for (const auto& neighbour : e->vertices()){
+                    if (activeVertices.insert(neighbour).second)
+                        nextFrontier.insert(neighbour);
+                }
+            }
+        }
+        frontier.swap(nextFrontier);
+    }
+    // all edges of the active vertices are optimized, the vertices outside the neighbourhood are fixed
+    for (const auto& v : activeVertices){
+        for (const auto& e : v->edges()){
+            if (static_cast<g2o::OptimizableGraph::Edge*>(e)->level()!=0)
+                continue;
+            bool allVerticesFixed = true;
+            for (const auto& neighbour : e->vertices()){
+                bool fixed = static_cast<g2o::OptimizableGraph::Vertex*>(neighbour)->fixed();
+                if (activeVertices.find(neighbour)==activeVertices.end()){
+                    if (!fixed)
+                        boundaryVertices.insert(neighbour);
+                }
+                else if (!fixed)
+                    allVerticesFixed = false;
+            }
+            if (!allVerticesFixed)
+                activeEdges.insert(e);
+        }
+    }
+}
+
 /// removes vertex from the g2o graph. Returns true on success
 bool PoseGraphG2O::removeVertexG2O(unsigned int id){
     g2o::OptimizableGraph::VertexContainer vertices = optimizer.activeVertices();
@@ -100,8 +224,8 @@ PoseGraph::VertexSet::iterator PoseGraphG2O::removeVertex(unsigned int id){
     if (v != graph.vertices.end()) {
         v = graph.vertices.erase(v);
     }
-    return v;
     mtxGraph.unlock();
+    return v;
 }
 
 /// removes an edge from the g2o graph. Returns true on success
@@ -179,6 +303,8 @@ bool PoseGraphG2O::addVertexG2O(uint_fast32_t id, std::stringstream& vertex, Ver
     g2o::OptimizableGraph::Vertex* vert = static_cast<g2o::OptimizableGraph::Vertex*>(element);
     vert->read(vertex);
     vert->setId((int)id);
+    if (type==Vertex::VERTEX3D)
+        vert->setMarginalized(marginalizeFeatures);
 
 
     if (graph.vertices.size()==1){
@@ -327,11 +453,7 @@ bool PoseGraphG2O::addEdgeG2O(uint_fast32_t id, uint_fast32_t fromId, uint_fast3
     else if (type==Edge::EDGE_3D)
         element = factory->construct("EDGE_SE3_TRACKXYZ", elemBitset);
     else if (type==Edge::EDGE_3D_REPROJ) {
-    	std::cout<<"Trying to add reprojection!" << std::endl;
-    	element = new g2o::EdgeSE3PointXYZReprojectionError();//factory->construct("EDGE_SE3_REPROJECTION", elemBitset);
-    	std::cout<<"Trying to add reprojection! - succes!!" << std::endl;
-    	if ( !element )
-    		std::cout<<"NOT CREATED!" << std::endl;
+    	element = factory->construct("EDGE_SE3_REPROJECTION", elemBitset);
     }
     else if (type==Edge::EDGE_SE2)
         element = factory->construct("EDGE_SE2", elemBitset);
@@ -524,7 +646,7 @@ bool PoseGraphG2O::addEdge(Edge3DReproj& e){
         e.id = (unsigned int)graph.edges.size();
         graph.edges.push_back(std::unique_ptr<Edge>(new Edge3DReproj(e)));
         std::stringstream currentLine;
-        currentLine << e.u << ' ' << e.v << ' ' << e.info(0, 0) << ' '
+        currentLine << cameraParameters->id() << ' ' << e.u << ' ' << e.v << ' ' << e.info(0, 0) << ' '
                 << e.info(0, 1) << ' ' << e.info(1, 1);
         addEdgeG2O(e.id, e.fromVertexId, e.toVertexId, currentLine, Edge::EDGE_3D_REPROJ);
         mtxGraph.unlock();
@@ -871,6 +993,7 @@ bool PoseGraphG2O::importRGBDSLAM(const std::string filename){
 
 /// Optimize graph
 bool PoseGraphG2O::optimize(int_fast32_t maxIterations, int verbose, double minimalChi2Ratio) {
+    PUTSLAM_PROFILE("g2o.optimize");
     optimizer.setVerbose(verbose);
     if (verbose>0)
         std::cout << "start local graph optimization (t = 0s)\n";
@@ -880,10 +1003,36 @@ bool PoseGraphG2O::optimize(int_fast32_t maxIterations, int verbose, double mini
     mtxGraph.lock();
     HessianInv.resize(0,0);
 
-    optimizer.initializeOptimization();
+    g2o::HyperGraph::VertexSet activeVertices, boundaryVertices;
+    std::map<int, std::vector<double>> prevEstimates;
+    incrementalStep = incrementalOpt && (fullOptimizationPeriod<=0 || optimizationsSinceFull<fullOptimizationPeriod);
+    if (incrementalStep){
+        // optimize the neighbourhood of the modified vertices only
+        g2o::HyperGraph::EdgeSet activeEdges;
+        selectIncrementalSet(activeEdges, activeVertices, boundaryVertices);
+        optimizer.setFixed(boundaryVertices, true);
+        optimizer.initializeOptimization(activeEdges);
+        for (const auto& v : activeVertices)
+            static_cast<g2o::OptimizableGraph::Vertex*>(v)->getEstimateData(prevEstimates[v->id()]);
+        optimizationsSinceFull++;
+        if (verbose>0)
+            std::cout << "incremental step: " << optimizer.activeVertices().size() << "/" << optimizer.vertices().size() << " active vertices\n";
+    }
+    else {
+        optimizer.initializeOptimization();
+        relinearizeVertices.clear();
+        optimizationsSinceFull = 0;
+    }
     //optimizer.computeInitialGuess();
 
-    if (maxIterations >= 0)
+    // fixed-size block solver requires at least one pose in the optimized part of the graph
+    bool freePose = !marginalizeFeatures;
+    for (size_t i=0; i<optimizer.indexMapping().size()&&!freePose; i++)
+        freePose = !optimizer.indexMapping()[i]->marginalized();
+    if (optimizer.activeEdges().empty()||!freePose){
+        // nothing to optimize
+    }
+    else if (maxIterations >= 0)
         optimizer.optimize((int)maxIterations);
     else {
 		double prevChi2 = -1.0, chi2 = -1.0;
@@ -907,6 +1056,21 @@ bool PoseGraphG2O::optimize(int_fast32_t maxIterations, int verbose, double mini
 			std::cout<<"Final optimization iteration counter = " << iterationCounter << std::endl;
     }
 
+    if (incrementalStep){
+        optimizer.setFixed(boundaryVertices, false);
+        // vertices which moved significantly change linearization point of their neighbours
+        for (const auto& v : activeVertices){
+            std::vector<double> estimate;
+            static_cast<g2o::OptimizableGraph::Vertex*>(v)->getEstimateData(estimate);
+            const std::vector<double>& prevEstimate = prevEstimates[v->id()];
+            double change = 0;
+            for (size_t i=0; i<estimate.size()&&i<prevEstimate.size(); i++)
+                change += (estimate[i]-prevEstimate[i])*(estimate[i]-prevEstimate[i]);
+            if (sqrt(change)>relinearizationThr)
+                relinearizeVertices.insert(v->id());
+        }
+    }
+
     newOptimizedVertices.insert(newVertices.begin(), newVertices.end());
     newVertices.clear();
 
@@ -918,13 +1082,17 @@ bool PoseGraphG2O::optimize(int_fast32_t maxIterations, int verbose, double mini
     // Unlock the graph
     mtxGraph.unlock();
 
-    if (!std::isfinite(optimizer.chi2()))
+    if (!std::isfinite(optimizer.chi2())){
+        incrementalStep = false;
         return false;
+    }
     updateEstimate();
+    // the result of the step is copied, other callers of updateEstimate copy the whole graph
+    incrementalStep = false;
     updateGraph();//try to update graph
     if (verbose>0) {
         auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - start);
-        std::cout << "finish local graph optimization (t = " << elapsed.count() << "ms)\n";
+        std::cout << "finish local graph optimization (t = " << elapsed.count() << "ms, solver: " << solverName << ")\n";
     }
 //    std::string result1 = "graphTmpOpt" + std::to_string (graph.vertices.size()) + ".g2o";
 //    while(!updateGraph()){}
@@ -935,9 +1103,13 @@ bool PoseGraphG2O::optimize(int_fast32_t maxIterations, int verbose, double mini
 /// copy g2o optimization result to to putslam graph
 void PoseGraphG2O::updateEstimate(void){
 
-	//copy optimized graph to putslam dataset
+	//copy optimized graph to putslam dataset (only active part of the graph changed in the incremental step)
     std::set<g2o::OptimizableGraph::Vertex*, g2o::OptimizableGraph::VertexIDCompare> verticesToCopy;
-    for (g2o::HyperGraph::EdgeSet::const_iterator it = optimizer.edges().begin(); it != optimizer.edges().end(); ++it) {
+    g2o::HyperGraph::EdgeSet edgesToCopy;
+    if (incrementalStep)
+        edgesToCopy.insert(optimizer.activeEdges().begin(), optimizer.activeEdges().end());
+    const g2o::HyperGraph::EdgeSet& edges = (incrementalStep) ? edgesToCopy : optimizer.edges();
+    for (g2o::HyperGraph::EdgeSet::const_iterator it = edges.begin(); it != edges.end(); ++it) {
       g2o::OptimizableGraph::Edge* e = static_cast<g2o::OptimizableGraph::Edge*>(*it);
       if (e->level() == 0) {
         for (std::vector<g2o::HyperGraph::Vertex*>::const_iterator it = e->vertices().begin(); it != e->vertices().end(); ++it) {
@@ -1176,6 +1348,170 @@ bool PoseGraphG2O::marginalize(const std::vector<int>& keyframes, const std::set
     return true; //TODO: DB check that
 }
 
+/// marginalize poses and features measured only from these poses (Schur complement)
+bool PoseGraphG2O::marginalizePoses(const std::vector<int>& posesIds, std::set<int>& marginalizedFeatures){
+    while(!updateGraph()){}
+    mtxGraph.lock();
+    // marginalized vertices: poses and features which are not measured from the remaining poses
+    std::vector<g2o::OptimizableGraph::Vertex*> margVertices;
+    g2o::HyperGraph::VertexSet margSet;
+    for (const auto& poseId : posesIds){
+        g2o::OptimizableGraph::Vertex* pose = optimizer.vertex(poseId);
+        if (pose!=nullptr&&margSet.insert(pose).second)
+            margVertices.push_back(pose);
+    }
+    size_t posesNo = margVertices.size();
+    for (size_t poseNo=0; poseNo<posesNo; poseNo++){
+        for (const auto& e : margVertices[poseNo]->edges()){
+            for (const auto& v : e->vertices()){
+                if (dynamic_cast<g2o::VertexPointXYZ*>(v)==nullptr||margSet.find(v)!=margSet.end())
+                    continue;
+                bool measuredFromWindow = false;
+                for (const auto& featureEdge : v->edges()){
+                    // previous priors are not measurements
+                    if (dynamic_cast<g2o::EdgeMarginalizationPrior*>(featureEdge)!=nullptr)
+                        continue;
+                    for (const auto& u : featureEdge->vertices()){
+                        if (u!=v&&margSet.find(u)==margSet.end())
+                            measuredFromWindow = true;
+                    }
+                }
+                if (!measuredFromWindow){
+                    margSet.insert(v);
+                    margVertices.push_back(static_cast<g2o::OptimizableGraph::Vertex*>(v));
+                    marginalizedFeatures.insert(v->id());
+                }
+            }
+        }
+    }
+    // edges of the marginalized vertices and Markov blanket
+    // features which stay in the graph (with the Schur solver) are eliminated from the prior, because
+    // the solver can not couple landmarks -- the measurements from the removed poses are dropped then
+    g2o::HyperGraph::EdgeSet margEdges;
+    std::vector<g2o::OptimizableGraph::Vertex*> blanket, eliminated;
+    g2o::HyperGraph::VertexSet blanketSet;
+    for (const auto& v : margVertices){
+        for (const auto& e : v->edges()){
+            if (static_cast<g2o::OptimizableGraph::Edge*>(e)->level()!=0||!margEdges.insert(e).second)
+                continue;
+            for (const auto& u : e->vertices()){
+                g2o::OptimizableGraph::Vertex* vert = static_cast<g2o::OptimizableGraph::Vertex*>(u);
+                if (margSet.find(u)!=margSet.end()||vert->fixed()||!blanketSet.insert(u).second)
+                    continue;
+                if (marginalizeFeatures&&dynamic_cast<g2o::VertexPointXYZ*>(u)!=nullptr)
+                    eliminated.push_back(vert);
+                else
+                    blanket.push_back(vert);
+            }
+        }
+    }
+    // local indices of the vertices in the dense system: eliminated first, then Markov blanket
+    std::map<g2o::HyperGraph::Vertex*, int> colIdx;
+    int margDim = 0, dim = 0;
+    for (const auto& v : margVertices){
+        if (v->fixed())
+            continue;
+        colIdx[v] = dim;
+        dim += v->dimension();
+    }
+    for (const auto& v : eliminated){
+        colIdx[v] = dim;
+        dim += v->dimension();
+    }
+    margDim = dim;
+    for (const auto& v : blanket){
+        colIdx[v] = dim;
+        dim += v->dimension();
+    }
+    g2o::EdgeMarginalizationPrior* prior = nullptr;
+    if (!blanket.empty()){
+        // linearize edges and build dense system H dx = -b
+        Eigen::MatrixXd H(Eigen::MatrixXd::Zero(dim, dim));
+        Eigen::VectorXd b(Eigen::VectorXd::Zero(dim));
+        g2o::JacobianWorkspace jacobianWorkspace;
+        for (const auto& e : margEdges)
+            jacobianWorkspace.updateSize(e);
+        jacobianWorkspace.allocate();
+        for (const auto& e : margEdges){
+            g2o::OptimizableGraph::Edge* edge = static_cast<g2o::OptimizableGraph::Edge*>(e);
+            edge->computeError();
+            edge->linearizeOplus(jacobianWorkspace);
+            Eigen::Map<const Eigen::VectorXd> error(edge->errorData(), edge->dimension());
+            Eigen::Map<const Eigen::MatrixXd> information(edge->informationData(), edge->dimension(), edge->dimension());
+            double weight = 1.0;
+            if (edge->robustKernel()){
+                Eigen::Vector3d rho;
+                edge->robustKernel()->robustify(edge->chi2(), rho);
+                weight = rho[1];
+            }
+            for (size_t i=0; i<edge->vertices().size(); i++){
+                auto itI = colIdx.find(edge->vertex(i));
+                if (itI==colIdx.end())
+                    continue;
+                int dimI = static_cast<g2o::OptimizableGraph::Vertex*>(edge->vertex(i))->dimension();
+                Eigen::Map<Eigen::MatrixXd> Ji(jacobianWorkspace.workspaceForVertex((int)i), edge->dimension(), dimI);
+                Eigen::MatrixXd JiOmega = weight * Ji.transpose() * information;
+                b.segment(itI->second, dimI) += JiOmega * error;
+                for (size_t j=0; j<edge->vertices().size(); j++){
+                    auto itJ = colIdx.find(edge->vertex(j));
+                    if (itJ==colIdx.end())
+                        continue;
+                    int dimJ = static_cast<g2o::OptimizableGraph::Vertex*>(edge->vertex(j))->dimension();
+                    Eigen::Map<Eigen::MatrixXd> Jj(jacobianWorkspace.workspaceForVertex((int)j), edge->dimension(), dimJ);
+                    H.block(itI->second, itJ->second, dimI, dimJ) += JiOmega * Jj;
+                }
+            }
+        }
+        // Schur complement (pseudo-inverse of the marginalized block, it can be rank deficient)
+        int blanketDim = dim - margDim;
+        Eigen::MatrixXd Hbb = H.bottomRightCorner(blanketDim, blanketDim);
+        Eigen::VectorXd bb = b.tail(blanketDim);
+        if (margDim>0){
+            Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> eigenSolver(H.topLeftCorner(margDim, margDim));
+            Eigen::VectorXd lambdaInv(eigenSolver.eigenvalues());
+            const double eps = 1e-8 * std::max(lambdaInv.maxCoeff(), 0.0);
+            for (int i=0; i<lambdaInv.size(); i++)
+                lambdaInv(i) = (lambdaInv(i)>eps) ? 1.0/lambdaInv(i) : 0.0;
+            Eigen::MatrixXd HmmInv = eigenSolver.eigenvectors() * lambdaInv.asDiagonal() * eigenSolver.eigenvectors().transpose();
+            Eigen::MatrixXd HbmHmmInv = H.bottomLeftCorner(blanketDim, margDim) * HmmInv;
+            Hbb -= HbmHmmInv * H.topRightCorner(margDim, blanketDim);
+            bb -= HbmHmmInv * b.head(margDim);
+        }
+        prior = new g2o::EdgeMarginalizationPrior();
+        prior->resize(blanket.size());
+        for (size_t i=0; i<blanket.size(); i++)
+            prior->setVertex(i, blanket[i]);
+        if (!prior->setPrior(Hbb, bb)){
+            delete prior;
+            prior = nullptr;
+        }
+    }
+    // remove marginalized vertices (and all their edges)
+    for (const auto& v : margVertices){
+        int vertexId = v->id();
+        if (!optimizer.removeVertex(v,false))
+            std::cerr << __PRETTY_FUNCTION__ << ": Failure removing Vertex\n";
+        eraseVertex(vertexId);
+        relinearizeVertices.erase(vertexId);
+        newVertices.erase(v);
+        newOptimizedVertices.erase(v);
+    }
+    for (PoseGraph::EdgeSet::iterator it = graph.edges.begin(); it!=graph.edges.end();){
+        if (optimizer.vertex(it->get()->fromVertexId)==nullptr||optimizer.vertex(it->get()->toVertexId)==nullptr)
+            it = graph.edges.erase(it);
+        else
+            it++;
+    }
+    if (prior!=nullptr){
+        if (!optimizer.addEdge(prior)){
+            std::cerr << __PRETTY_FUNCTION__ << ": Failure adding marginalization prior\n";
+            delete prior;
+        }
+    }
+    mtxGraph.unlock();
+    return true;
+}
+
 /// erase edges related to the SE3 vertex
 void PoseGraphG2O::eraseMeasurements(int poseId){
     mtxGraph.lock();
@@ -1472,6 +1808,8 @@ bool PoseGraphG2O::prune3Dedges(double threshold){
     for (g2o::OptimizableGraph::EdgeContainer::iterator it = activeEdges.begin(); it!=activeEdges.end(); it++){
         //std::cout << "chi2: id: " << (*it)->id() << " chi2: " << (*it)->chi2() << std::endl;
         PoseGraph::EdgeSet::iterator edg = findEdge((*it)->id());
+        if (edg==graph.edges.end()) // e.g. marginalization prior
+            continue;
         PoseGraph::VertexSet::iterator vert = findVertex((unsigned int)edg->get()->toVertexId);
         if (vert->get()->type==Vertex::VERTEX3D){
             //std::cout << "id1: " << vert->get()->vertexId << "\n";
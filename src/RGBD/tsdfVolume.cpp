@@ -0,0 +1,436 @@
+/** @file tsdfVolume.cpp
+ *
+ * \brief Truncated signed distance field (TSDF) stored in the spatially hashed grid of voxel blocks
+ *
+ */
+#include "RGBD/tsdfVolume.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+using namespace putslam;
+
+namespace {
+
+/// Marching cubes triangulation of 256 cube configurations
+/// generated from the cube topology: intersections on the cube faces are connected into loops
+/// (on ambiguous faces inside corners are separated, so neighbouring cubes agree) and loops are triangulated as fans
+/// corner c is at offset (c & 1, (c >> 1) & 1, (c >> 2) & 1), bit c of the configuration is set if the corner is inside (sdf < 0)
+class MarchingCubesTable {
+public:
+    /// corners of the edge (the second corner is shifted along edgeAxis)
+    int edgeCorners[12][2];
+    /// axis of the edge
+    int edgeAxis[12];
+    /// triangles (edges with vertices) of each configuration, counterclockwise when seen from outside
+    std::vector<std::array<int, 3>> triangles[256];
+
+    MarchingCubesTable() {
+        int edgesNo = 0;
+        for (int axis = 0; axis < 3; axis++)
+            for (int corner = 0; corner < 8; corner++)
+                if (!(corner & (1 << axis))) {
+                    edgeCorners[edgesNo][0] = corner;
+                    edgeCorners[edgesNo][1] = corner | (1 << axis);
+                    edgeAxis[edgesNo] = axis;
+                    edgesNo++;
+                }
+        // edges of the faces
+        std::vector<int> faceEdges[6];
+        for (int axis = 0; axis < 3; axis++)
+            for (int side = 0; side < 2; side++)
+                for (int edge = 0; edge < 12; edge++)
+                    if (((edgeCorners[edge][0] >> axis) & 1) == side && ((edgeCorners[edge][1] >> axis) & 1) == side)
+                        faceEdges[2 * axis + side].push_back(edge);
+
+        for (int config = 0; config < 256; config++) {
+            auto inside = [config](int corner) {return (config & (1 << corner)) != 0;};
+            auto active = [&](int edge) {return inside(edgeCorners[edge][0]) != inside(edgeCorners[edge][1]);};
+            // each active edge is connected with one active edge on both of its faces
+            std::vector<int> neighbours[12];
+            for (int face = 0; face < 6; face++) {
+                std::vector<int> activeEdges;
+                for (int edge : faceEdges[face])
+                    if (active(edge))
+                        activeEdges.push_back(edge);
+                for (size_t i = 0; i < activeEdges.size(); i++)
+                    for (size_t j = i + 1; j < activeEdges.size(); j++) {
+                        int edgeA = activeEdges[i], edgeB = activeEdges[j];
+                        if (activeEdges.size() == 4) {
+                            // ambiguous face -- connect edges around the same inside corner
+                            int insideA = inside(edgeCorners[edgeA][0]) ? edgeCorners[edgeA][0] : edgeCorners[edgeA][1];
+                            int insideB = inside(edgeCorners[edgeB][0]) ? edgeCorners[edgeB][0] : edgeCorners[edgeB][1];
+                            if (insideA != insideB)
+                                continue;
+                        }
+                        neighbours[edgeA].push_back(edgeB);
+                        neighbours[edgeB].push_back(edgeA);
+                    }
+            }
+            // loops of edges
+            bool visited[12] = {false};
+            for (int start = 0; start < 12; start++) {
+                if (!active(start) || visited[start])
+                    continue;
+                std::vector<int> loop;
+                int prev = -1, current = start;
+                do {
+                    visited[current] = true;
+                    loop.push_back(current);
+                    int next = (neighbours[current][0] != prev) ? neighbours[current][0] : neighbours[current][1];
+                    prev = current;
+                    current = next;
+                } while (current != start);
+                // orientation -- normal of the loop points from inside to outside corners
+                Eigen::Vector3f normal(0, 0, 0), outward(0, 0, 0);
+                for (size_t i = 0; i < loop.size(); i++) {
+                    normal += edgeCenter(loop[i]).cross(edgeCenter(loop[(i + 1) % loop.size()]));
+                    int cornerA = edgeCorners[loop[i]][0], cornerB = edgeCorners[loop[i]][1];
+                    outward += inside(cornerA) ? Eigen::Vector3f(cornerPos(cornerB) - cornerPos(cornerA)) : Eigen::Vector3f(cornerPos(cornerA) - cornerPos(cornerB));
+                }
+                if (normal.dot(outward) < 0)
+                    std::reverse(loop.begin(), loop.end());
+                for (size_t i = 1; i + 1 < loop.size(); i++)
+                    triangles[config].push_back({{loop[0], loop[i], loop[i + 1]}});
+            }
+        }
+    }
+
+private:
+    static Eigen::Vector3f cornerPos(int corner) {
+        return Eigen::Vector3f((float) (corner & 1), (float) ((corner >> 1) & 1), (float) ((corner >> 2) & 1));
+    }
+
+    Eigen::Vector3f edgeCenter(int edge) const {
+        return (cornerPos(edgeCorners[edge][0]) + cornerPos(edgeCorners[edge][1])) / 2.0f;
+    }
+};
+
+const MarchingCubesTable marchingCubes;
+
+/// vertex of the triangle (vertices on the same voxel edge are merged)
+class MeshVertex {
+public:
+    int64_t edgeKey;
+    Eigen::Vector3f position;
+    Eigen::Vector3i color;
+};
+}
+
+/// Construction
+TSDFVolume::Block::Block() {
+    std::fill(sdf, sdf + blockVoxelsNo, 1.0f);
+    std::fill(weight, weight + blockVoxelsNo, 0.0f);
+    for (int channel = 0; channel < 3; channel++)
+        std::fill(color[channel], color[channel] + blockVoxelsNo, (uint8_t) 0);
+}
+
+/// Construction
+TSDFVolume::TSDFVolume(const Config& _config) : config(_config) {
+}
+
+/// key of the block
+int64_t TSDFVolume::blockKey(int x, int y, int z) {
+    return (((int64_t) x & 0x1FFFFF) << 42) | (((int64_t) y & 0x1FFFFF) << 21) | ((int64_t) z & 0x1FFFFF);
+}
+
+/// coordinates of the block
+void TSDFVolume::blockCoords(int64_t key, int& x, int& y, int& z) {
+    auto decode = [](int64_t value) {
+        int coord = (int) (value & 0x1FFFFF);
+        return (coord & 0x100000) ? coord - 0x200000 : coord;
+    };
+    x = decode(key >> 42);
+    y = decode(key >> 21);
+    z = decode(key);
+}
+
+/// number of allocated blocks
+size_t TSDFVolume::getBlocksNo(void) const {
+    return blocks.size();
+}
+
+/// remove all blocks
+void TSDFVolume::clear(void) {
+    blocks.clear();
+}
+
+/// integrate depth (and color) image acquired from the pose (camera in the world frame)
+void TSDFVolume::integrate(const cv::Mat& rgbImage, const cv::Mat& depthImage, const cv::Mat& cameraMatrix,
+        const Mat34& pose, double depthImageScale, float weight) {
+    const int rows = depthImage.rows, cols = depthImage.cols;
+    Eigen::Matrix3f camMatrix;
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            camMatrix(i, j) = cameraMatrix.at<float>(i, j);
+    const float fx = camMatrix(0, 0), fy = camMatrix(1, 1), cx = camMatrix(0, 2), cy = camMatrix(1, 2);
+
+    // depth in metres (0 -- no measurement)
+    std::vector<float> depth(rows * cols);
+    const float maxDepth = (float) config.maxDepth;
+#pragma omp parallel for
+    for (int v = 0; v < rows; v++) {
+        const uint16_t* depthRow = depthImage.ptr<uint16_t>(v);
+        for (int u = 0; u < cols; u++) {
+            float d = (float) ((double) depthRow[u] / depthImageScale);
+            depth[v * cols + u] = (d > 0 && d <= maxDepth) ? d : 0;
+        }
+    }
+
+    // blocks in the truncation band of measurements (pixels are subsampled, block is larger than a few pixels)
+    const Eigen::Matrix3f rot = pose.rotation().cast<float>();
+    const Eigen::Vector3f trans = pose.translation().cast<float>();
+    const float blockLength = (float) config.voxelSize * blockSize;
+    const float truncation = (float) config.truncation;
+    const int stride = std::max(1, (int) (blockLength * fx / maxDepth / 2.0f));
+    std::vector<int64_t> keys;
+#pragma omp parallel
+    {
+        std::vector<int64_t> localKeys;
+#pragma omp for nowait
+        for (int v = 0; v < rows; v += stride) {
+            for (int u = 0; u < cols; u += stride) {
+                float d = depth[v * cols + u];
+                if (d == 0)
+                    continue;
+                Eigen::Vector3f ray(((float) u - cx) / fx, ((float) v - cy) / fy, 1.0f);
+                for (float s = std::max(0.0f, d - truncation); ; s += blockLength / 2.0f) {
+                    s = std::min(s, d + truncation);
+                    Eigen::Vector3f point = rot * (ray * s) + trans;
+                    int64_t key = blockKey((int) std::floor(point.x() / blockLength), (int) std::floor(point.y() / blockLength),
+                            (int) std::floor(point.z() / blockLength));
+                    if (localKeys.empty() || localKeys.back() != key)
+                        localKeys.push_back(key);
+                    if (s >= d + truncation)
+                        break;
+                }
+            }
+        }
+        std::sort(localKeys.begin(), localKeys.end());
+        localKeys.erase(std::unique(localKeys.begin(), localKeys.end()), localKeys.end());
+#pragma omp critical
+        keys.insert(keys.end(), localKeys.begin(), localKeys.end());
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    // allocation (removal of the image updates existing blocks only)
+    std::vector<std::pair<int64_t, Block*>> visibleBlocks;
+    visibleBlocks.reserve(keys.size());
+    for (int64_t key : keys) {
+        auto block = blocks.find(key);
+        if (block == blocks.end()) {
+            if (weight <= 0)
+                continue;
+            block = blocks.emplace(key, Block()).first;
+        }
+        visibleBlocks.push_back(std::make_pair(key, &block->second));
+    }
+
+    // update of voxels (blocks are independent)
+    const Eigen::Matrix3f rotInv = rot.transpose();
+    const Eigen::Vector3f transInv = -rotInv * trans;
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int i = 0; i < (int) visibleBlocks.size(); i++)
+        integrateBlock(visibleBlocks[i].first, *visibleBlocks[i].second, depth, cols, rows, rgbImage, camMatrix, rotInv, transInv, weight);
+
+    if (config.verbose > 0)
+        std::cout << "TSDFVolume: integrated " << visibleBlocks.size() << " blocks (" << blocks.size() << " allocated)\n";
+}
+
+/// update voxels of the block
+void TSDFVolume::integrateBlock(int64_t key, Block& block, const std::vector<float>& depth, int cols, int rows,
+        const cv::Mat& rgbImage, const Eigen::Matrix3f& camMatrix, const Eigen::Matrix3f& rotInv,
+        const Eigen::Vector3f& transInv, float weight) const {
+    const float fx = camMatrix(0, 0), fy = camMatrix(1, 1), cx = camMatrix(0, 2), cy = camMatrix(1, 2);
+    const float voxelSize = (float) config.voxelSize, truncation = (float) config.truncation;
+    const bool useColor = !rgbImage.empty() && rgbImage.isContinuous() && rgbImage.rows == rows && rgbImage.cols == cols;
+    const cv::Vec3b* colorsBGR = useColor ? rgbImage.ptr<cv::Vec3b>(0) : nullptr;
+    int bx, by, bz;
+    blockCoords(key, bx, by, bz);
+    // step along x axis of the block in the camera frame
+    const Eigen::Vector3f stepX = rotInv.col(0) * voxelSize;
+
+    for (int z = 0; z < blockSize; z++) {
+        for (int y = 0; y < blockSize; y++) {
+            Eigen::Vector3f rowStart((float) (bx * blockSize) * voxelSize, (float) (by * blockSize + y) * voxelSize,
+                    (float) (bz * blockSize + z) * voxelSize);
+            Eigen::Vector3f camStart = rotInv * rowStart + transInv;
+
+            // projection of the row of voxels (vectorized)
+            float camZ[blockSize];
+            int pixel[blockSize];
+#pragma omp simd
+            for (int x = 0; x < blockSize; x++) {
+                float px = camStart.x() + (float) x * stepX.x();
+                float py = camStart.y() + (float) x * stepX.y();
+                float pz = camStart.z() + (float) x * stepX.z();
+                float u = fx * px / pz + cx + 0.5f;
+                float v = fy * py / pz + cy + 0.5f;
+                bool inside = pz > 0 && u >= 0 && v >= 0 && u < (float) cols && v < (float) rows;
+                camZ[x] = pz;
+                pixel[x] = inside ? (int) v * cols + (int) u : -1;
+            }
+
+            const int rowIdx = (z * blockSize + y) * blockSize;
+            for (int x = 0; x < blockSize; x++) {
+                if (pixel[x] < 0)
+                    continue;
+                float d = depth[pixel[x]];
+                if (d == 0)
+                    continue;
+                float distance = d - camZ[x];
+                if (distance < -truncation)
+                    continue;
+                float tsdf = std::min(1.0f, distance / truncation);
+                int idx = rowIdx + x;
+                float prevWeight = block.weight[idx];
+                float newWeight = prevWeight + weight;
+                if (newWeight <= 0) {
+                    block.weight[idx] = 0;
+                    block.sdf[idx] = 1.0f;
+                    continue;
+                }
+                block.sdf[idx] = (block.sdf[idx] * prevWeight + tsdf * weight) / newWeight;
+                if (useColor) {
+                    const cv::Vec3b& colorBGR = colorsBGR[pixel[x]];
+                    for (int channel = 0; channel < 3; channel++) {
+                        float value = ((float) block.color[channel][idx] * prevWeight + (float) colorBGR.val[2 - channel] * weight) / newWeight;
+                        block.color[channel][idx] = (uint8_t) std::max(0.0f, std::min(255.0f, value + 0.5f));
+                    }
+                }
+                block.weight[idx] = (weight > 0) ? std::min(newWeight, config.maxWeight) : newWeight;
+            }
+        }
+    }
+}
+
+/// extract mesh with marching cubes (colors in RGB, triangles -- indices of vertices)
+void TSDFVolume::extractMesh(std::vector<Eigen::Vector3f>& vertices, std::vector<Eigen::Vector3i>& colors,
+        std::vector<Eigen::Vector3i>& triangles) const {
+    std::vector<const std::pair<const int64_t, Block>*> blockList;
+    blockList.reserve(blocks.size());
+    for (auto& block : blocks)
+        blockList.push_back(&block);
+
+    // triangles of cubes with the first corner in the block (vertices of triangles in order)
+    std::vector<std::vector<MeshVertex>> blockTriangles(blockList.size());
+    const float voxelSize = (float) config.voxelSize;
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int i = 0; i < (int) blockList.size(); i++) {
+        int bx, by, bz;
+        blockCoords(blockList[i]->first, bx, by, bz);
+        // the block and its neighbours in +x, +y, +z directions
+        const Block* neighbours[8];
+        for (int n = 0; n < 8; n++) {
+            if (n == 0) {
+                neighbours[n] = &blockList[i]->second;
+                continue;
+            }
+            auto block = blocks.find(blockKey(bx + (n & 1), by + ((n >> 1) & 1), bz + ((n >> 2) & 1)));
+            neighbours[n] = (block == blocks.end()) ? nullptr : &block->second;
+        }
+        std::vector<MeshVertex>& output = blockTriangles[i];
+        for (int z = 0; z < blockSize; z++) {
+            for (int y = 0; y < blockSize; y++) {
+                for (int x = 0; x < blockSize; x++) {
+                    float values[8];
+                    Eigen::Vector3i cornerColors[8];
+                    int cubeConfig = 0;
+                    bool observed = true;
+                    for (int corner = 0; corner < 8 && observed; corner++) {
+                        int cx = x + (corner & 1), cy = y + ((corner >> 1) & 1), cz = z + ((corner >> 2) & 1);
+                        const Block* block = neighbours[(cx / blockSize) | ((cy / blockSize) << 1) | ((cz / blockSize) << 2)];
+                        int idx = ((cz % blockSize) * blockSize + (cy % blockSize)) * blockSize + (cx % blockSize);
+                        if (block == nullptr || block->weight[idx] <= 0) {
+                            observed = false;
+                            break;
+                        }
+                        values[corner] = block->sdf[idx];
+                        cornerColors[corner] = Eigen::Vector3i(block->color[0][idx], block->color[1][idx], block->color[2][idx]);
+                        if (values[corner] < 0)
+                            cubeConfig |= 1 << corner;
+                    }
+                    if (!observed || cubeConfig == 0 || cubeConfig == 255)
+                        continue;
+                    int gx = bx * blockSize + x, gy = by * blockSize + y, gz = bz * blockSize + z;
+                    for (auto& triangle : marchingCubes.triangles[cubeConfig]) {
+                        for (int edge : triangle) {
+                            int cornerA = marchingCubes.edgeCorners[edge][0], cornerB = marchingCubes.edgeCorners[edge][1];
+                            int axis = marchingCubes.edgeAxis[edge];
+                            float t = values[cornerA] / (values[cornerA] - values[cornerB]);
+                            Eigen::Vector3f cornerPos((float) (gx + (cornerA & 1)), (float) (gy + ((cornerA >> 1) & 1)), (float) (gz + ((cornerA >> 2) & 1)));
+                            cornerPos(axis) += t;
+                            MeshVertex vertex;
+                            vertex.position = cornerPos * voxelSize;
+                            vertex.color = (cornerColors[cornerA].cast<float>() * (1.0f - t) + cornerColors[cornerB].cast<float>() * t).cast<int>();
+                            int64_t ex = gx + (cornerA & 1), ey = gy + ((cornerA >> 1) & 1), ez = gz + ((cornerA >> 2) & 1);
+                            vertex.edgeKey = ((ex & 0xFFFFF) << 42) | ((ey & 0xFFFFF) << 22) | ((ez & 0xFFFFF) << 2) | axis;
+                            output.push_back(vertex);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // shared vertices
+    vertices.clear();
+    colors.clear();
+    triangles.clear();
+    std::unordered_map<int64_t, int> vertexIds;
+    for (auto& output : blockTriangles) {
+        for (size_t i = 0; i + 2 < output.size(); i += 3) {
+            int ids[3];
+            for (int k = 0; k < 3; k++) {
+                auto vertexId = vertexIds.find(output[i + k].edgeKey);
+                if (vertexId == vertexIds.end()) {
+                    vertexId = vertexIds.insert(std::make_pair(output[i + k].edgeKey, (int) vertices.size())).first;
+                    vertices.push_back(output[i + k].position);
+                    colors.push_back(output[i + k].color);
+                }
+                ids[k] = vertexId->second;
+            }
+            if (ids[0] != ids[1] && ids[1] != ids[2] && ids[0] != ids[2])
+                triangles.push_back(Eigen::Vector3i(ids[0], ids[1], ids[2]));
+        }
+    }
+    if (config.verbose > 0)
+        std::cout << "TSDFVolume: mesh with " << vertices.size() << " vertices and " << triangles.size() << " triangles\n";
+}
+
+/// extract mesh and save it to the PLY file
+bool TSDFVolume::saveMesh(const std::string& filename) const {
+    std::vector<Eigen::Vector3f> vertices;
+    std::vector<Eigen::Vector3i> colors;
+    std::vector<Eigen::Vector3i> triangles;
+    extractMesh(vertices, colors, triangles);
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "TSDFVolume: could not open file " << filename << "\n";
+        return false;
+    }
+    file << "ply\nformat binary_little_endian 1.0\n";
+    file << "element vertex " << vertices.size() << "\n";
+    file << "property float x\nproperty float y\nproperty float z\n";
+    file << "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+    file << "element face " << triangles.size() << "\n";
+    file << "property list uchar int vertex_indices\nend_header\n";
+    for (size_t i = 0; i < vertices.size(); i++) {
+        float position[3] = {vertices[i].x(), vertices[i].y(), vertices[i].z()};
+        uint8_t color[3] = {(uint8_t) colors[i].x(), (uint8_t) colors[i].y(), (uint8_t) colors[i].z()};
+        file.write((const char*) position, sizeof(position));
+        file.write((const char*) color, sizeof(color));
+    }
+    for (auto& triangle : triangles) {
+        uint8_t verticesNo = 3;
+        int32_t ids[3] = {triangle.x(), triangle.y(), triangle.z()};
+        file.write((const char*) &verticesNo, sizeof(verticesNo));
+        file.write((const char*) ids, sizeof(ids));
+    }
+    return file.good();
+}
@@ -5,6 +5,7 @@
  *
  */
 #include "TransformEst/RANSAC.h"
+#include "Utilities/profiler.h"
 #include "TransformEst/g2oEst.h"
 #include "RGBD/RGBD.h"
 
@@ -51,6 +52,7 @@ Eigen::Matrix4f RANSAC::estimateTransformation(
 		std::vector<Eigen::Vector3f> prevFeatures,
 		std::vector<Eigen::Vector3f> features, std::vector<cv::DMatch> matches,
 		std::vector<cv::DMatch> & bestInlierMatches) {
+	PUTSLAM_PROFILE("RANSAC");
 
 	if (RANSACParams.verbose > 0)
 			std::cout << "RANSAC: original matches.size() = " << matches.size() << std::endl;
@@ -225,10 +227,9 @@ bool RANSAC::computeTransformationModel(
 		transformationModel = Eigen::umeyama(featuresMatrix.transpose(),
 				prevFeaturesMatrix.transpose(), false);
 	} else if (usedType == G2O) {
-		putslam::TransformEst* g2oEst = createG2OEstimator();
-		Mat34 transformation = g2oEst->computeTransformation(
-				featuresMatrix.cast<double>().transpose(),
-				prevFeaturesMatrix.cast<double>().transpose());
+		Mat34 transformation = g2oEst.computeTransformation(
+				featuresMatrix.cast<double>(),
+				prevFeaturesMatrix.cast<double>());
 		transformationModel = transformation.cast<float>().matrix();
 	} else {
 		std::cout << "RANSAC: unrecognized transformation estimation"
@@ -1,159 +1,133 @@
 #include "TransformEst/g2oEst.h"
 #include <memory>
 #include <stdexcept>
+#include <limits>
 
 using namespace putslam;
 
 /// A single instance of G2O Estimator
 G2OEst::Ptr g2oEst;
 
-G2OEst::G2OEst(void) : name("G2O Estimator") {
+G2OEst::G2OEst(void) : name("G2O Estimator"), maxIterations(70), minIncrement(1e-8) {
+    transformation.setIdentity();
+}
 
+G2OEst::G2OEst(int _maxIterations, double _minIncrement) : name("G2O Estimator"), maxIterations(_maxIterations), minIncrement(_minIncrement) {
+    transformation.setIdentity();
 }
 
 const std::string& G2OEst::getName() const {
     return name;
 }
 
-/// compute transformation using two set of keypoints (information matrix -- identity)
-Mat34& G2OEst::computeTransformation(const Eigen::MatrixXd& setA, const Eigen::MatrixXd& setB){
-    graph.clear();
-    //add vertices - robot poses
-    Mat34 pose(Mat34::Identity());
-    VertexSE3 vertex(0, pose);
-    if (!graph.addVertexPose(vertex))
-        std::cout << "error: vertex exists!\n";
-    VertexSE3 vertex1(1, transformation);
-    if (!graph.addVertexPose(vertex1))
-        std::cout << "error: vertex exists!\n";
-
-    int featureIdx=10;
-    Mat33 unc; unc.setIdentity();
-    for (int i=0;i<setA.rows();i++){
-        Vec3 posFeature(setB(i,0), setB(i,1), setB(i,2));
-        Vertex3D vertexFeature(featureIdx, posFeature);
-        if (!graph.addVertexFeature(vertexFeature))
-            std::cout << "error: vertex exists!\n";
-//std::cout << "feature: \n" << setA(i,0) << ", " << setA(i,1) << ", " <<  setA(i,2) << "\n";
-//std::cout << "unc: \n" << setAUncertainty[i] << "\n";
-//std::cout << "feature: \n" << setB(i,0) << ", " << setB(i,1) << ", " <<  setB(i,2) << "\n";
-//std::cout << "unc: \n" << setBUncertainty[i] << "\n";
-        Vec3 pos11(setB(i,0), setB(i,1), setB(i,2));
-        Mat33 info; info.setIdentity();
-        Edge3D edge1(pos11,info, 0,featureIdx);
-
-        if (!graph.addEdge3D(edge1))
-            std::cout << "error: vertex doesn't exist!\n";
-        Vec3 pos12(setA(i,0), setA(i,1), setA(i,2));
+/// skew-symmetric matrix
+static inline Mat33 skew(const Eigen::Vector3d& v){
+    Mat33 m;
+    m << 0, -v.z(), v.y(),
+         v.z(), 0, -v.x(),
+        -v.y(), v.x(), 0;
+    return m;
+}
 
-        Edge3D edge2(pos12,info, 1,featureIdx);
-        if (!graph.addEdge3D(edge2))
-            std::cout << "error: vertex doesn't exist!\n";
+/// compute information matrices of the residuals T*a_i - b_i (identity if uncertainty is not provided)
+void G2OEst::computeResidualInfo(size_t pointsNo, const std::vector<Mat33>* setAUncertainty, const std::vector<Mat33>* setBUncertainty, const Mat34& pose){
+    // resize only -- memory is kept between calls
+    residualInfo.resize(pointsNo);
+    if (setAUncertainty==nullptr||setBUncertainty==nullptr){
+        for (size_t i=0;i<pointsNo;i++)
+            residualInfo[i].setIdentity();
+        return;
+    }
+    // feature eliminated: cov(T*a_i - b_i) = R*covA*R^T + covB
+    const Mat33 rot = pose.rotation();
+    for (size_t i=0;i<pointsNo;i++){
+        Mat33 cov = rot*(*setAUncertainty)[i]*rot.transpose() + (*setBUncertainty)[i];
+        residualInfo[i] = cov.inverse();
+    }
+}
 
-        featureIdx++;
+/// compute hessian and gradient of the cost function, returns cost
+double G2OEst::computeNormalEquations(const Eigen::MatrixXd& setA, const Eigen::MatrixXd& setB, const Mat34& pose, Mat66& H, Eigen::Matrix<double,6,1>& g) const{
+    H.setZero(); g.setZero();
+    double cost(0);
+    const Mat33 rot = pose.rotation();
+    Eigen::Matrix<double,3,6> J;
+    J.block<3,3>(0,0) = rot;
+    for (int i=0;i<setA.rows();i++){
+        Eigen::Vector3d pointA(setA(i,0), setA(i,1), setA(i,2));
+        Eigen::Vector3d residual = pose*pointA - Eigen::Vector3d(setB(i,0), setB(i,1), setB(i,2));
+        // T*exp(dx) for dx=(x, y, z, qx, qy, qz) (g2o::VertexSE3 increment)
+        J.block<3,3>(0,3) = -2.0*rot*skew(pointA);
+        Eigen::Matrix<double,6,3> JtW = J.transpose()*residualInfo[i];
+        H.noalias() += JtW*J;
+        g.noalias() += JtW*residual;
+        cost += residual.dot(residualInfo[i]*residual);
     }
+    return cost;
+}
 
-    graph.save2file("singleTr.g2o");
-    graph.optimize(70);
+/// Gauss-Newton iterations, returns false if the normal equations are singular
+bool G2OEst::optimize(const Eigen::MatrixXd& setA, const std::vector<Mat33>* setAUncertainty, const Eigen::MatrixXd& setB, const std::vector<Mat33>* setBUncertainty, Mat34& pose){
+    if (setA.rows()<3||setA.rows()!=setB.rows()){
+        std::cout << "error: G2OEst requires at least three pairs of points\n";
+        return false;
+    }
+    Eigen::Matrix<double,6,1> g;
+    computeResidualInfo(setA.rows(), setAUncertainty, setBUncertainty, pose);
+    double cost = computeNormalEquations(setA, setB, pose, hessian, g);
+    for (int iter=0;iter<maxIterations;iter++){
+        Eigen::LDLT<Mat66> ldlt(hessian);
+        if (ldlt.info()!=Eigen::Success||ldlt.vectorD().minCoeff()<=0)
+            return false;
+        Eigen::Matrix<double,6,1> dx = -ldlt.solve(g);
+        // apply increment
+        Eigen::Vector3d qv = dx.tail<3>();
+        double qvNorm = qv.squaredNorm();
+        if (qvNorm>1.0){
+            qv /= sqrt(qvNorm);
+            qvNorm = 1.0;
+        }
+        Mat34 increment(Quaternion(sqrt(1.0-qvNorm), qv.x(), qv.y(), qv.z()));
+        increment.translation() = dx.head<3>();
+        Mat34 poseNew = pose*increment;
+        if (setAUncertainty!=nullptr)
+            computeResidualInfo(setA.rows(), setAUncertainty, setBUncertainty, poseNew);
+        Mat66 hessianNew;
+        Eigen::Matrix<double,6,1> gNew;
+        double costNew = computeNormalEquations(setA, setB, poseNew, hessianNew, gNew);
+        if (costNew>cost){
+            if (setAUncertainty!=nullptr)
+                computeResidualInfo(setA.rows(), setAUncertainty, setBUncertainty, pose);
+            break;
+        }
+        pose = poseNew; hessian = hessianNew; g = gNew; cost = costNew;
+        if (dx.norm()<minIncrement)
+            break;
+    }
+    return true;
+}
 
+/// compute transformation using two set of keypoints (information matrix -- identity)
+Mat34& G2OEst::computeTransformation(const Eigen::MatrixXd& setA, const Eigen::MatrixXd& setB){
+    transformation.setIdentity();
+    if (!optimize(setA, nullptr, setB, nullptr, transformation))
+        transformation.matrix()(0,0) = std::numeric_limits<double>::quiet_NaN();
     return transformation;
 }
 
 /// compute transformation using two set of keypoints
 Mat34& G2OEst::computeTransformation(const Eigen::MatrixXd& setA, std::vector<Mat33>& setAUncertainty, const Eigen::MatrixXd& setB, std::vector<Mat33>& setBUncertainty, Mat34& transformation){
-    graph.clear();
-    //add vertices - robot poses
-    VertexSE3 vertex(0, Mat34::Identity());
-    if (!graph.addVertexPose(vertex))
-        std::cout << "error: vertex exists!\n";
-    VertexSE3 vertex1(1, transformation);
-    if (!graph.addVertexPose(vertex1))
-        std::cout << "error: vertex exists!\n";
-
-    int featureIdx=10;
-    Mat33 unc; unc.setIdentity();
-    for (int i=0;i<setA.rows();i++){
-        Vec3 posFeature(setB(i,0), setB(i,1), setB(i,2));
-        Vertex3D vertexFeature(featureIdx, posFeature);
-        if (!graph.addVertexFeature(vertexFeature))
-            std::cout << "error: vertex exists!\n";
-//std::cout << "feature: \n" << setA(i,0) << ", " << setA(i,1) << ", " <<  setA(i,2) << "\n";
-//std::cout << "unc: \n" << setAUncertainty[i] << "\n";
-//std::cout << "feature: \n" << setB(i,0) << ", " << setB(i,1) << ", " <<  setB(i,2) << "\n";
-//std::cout << "unc: \n" << setBUncertainty[i] << "\n";
-        Vec3 pos11(setB(i,0), setB(i,1), setB(i,2));
-        Mat33 info = setBUncertainty[i].inverse();
-        Edge3D edge1(pos11,info, 0,featureIdx);
-
-        if (!graph.addEdge3D(edge1))
-            std::cout << "error: vertex doesn't exist!\n";
-        Vec3 pos12(setA(i,0), setA(i,1), setA(i,2));
-        info = setAUncertainty[i].inverse();
-        Edge3D edge2(pos12,info, 1,featureIdx);
-        if (!graph.addEdge3D(edge2))
-            std::cout << "error: vertex doesn't exist!\n";
-
-        featureIdx++;
-    }
-
-//    graph.save2file("singleTr.g2o");
-    graph.optimize(70);
-    transformation = graph.getTransform(1);
-
+    if (!optimize(setA, &setAUncertainty, setB, &setBUncertainty, transformation))
+        transformation.matrix()(0,0) = std::numeric_limits<double>::quiet_NaN();
     return transformation;
 }
 
 /// Compute uncertainty matrix [6x6] (fi,psi,theta,x,y,z)
 const Mat66& G2OEst::computeUncertainty(const Eigen::MatrixXd& setA, std::vector<Mat33>& setAUncertainty, const Eigen::MatrixXd& setB, std::vector<Mat33>& setBUncertainty, Mat34& transformation) {
-
-    graph.clear();
-    //add vertices - robot poses
-    VertexSE3 vertex(0, Mat34::Identity());
-    if (!graph.addVertexPose(vertex))
-        std::cout << "error: vertex exists!\n";
-    VertexSE3 vertex1(1, transformation);
-    if (!graph.addVertexPose(vertex1))
-        std::cout << "error: vertex exists!\n";
-
-    int featureIdx=10;
-    Mat33 unc; unc.setIdentity();
-    for (int i=0;i<setA.rows();i++){
-        Vec3 posFeature(setB(i,0), setB(i,1), setB(i,2));
-        Vertex3D vertexFeature(featureIdx, posFeature);
-        if (!graph.addVertexFeature(vertexFeature))
-            std::cout << "error: vertex exists!\n";
-//std::cout << "feature: \n" << setA(i,0) << ", " << setA(i,1) << ", " <<  setA(i,2) << "\n";
-//std::cout << "unc: \n" << setAUncertainty[i] << "\n";
-//std::cout << "feature: \n" << setB(i,0) << ", " << setB(i,1) << ", " <<  setB(i,2) << "\n";
-//std::cout << "unc: \n" << setBUncertainty[i] << "\n";
-        Vec3 pos11(setB(i,0), setB(i,1), setB(i,2));
-        Mat33 info = setBUncertainty[i].inverse();
-        Edge3D edge1(pos11,info, 0,featureIdx);
-
-        if (!graph.addEdge3D(edge1))
-            std::cout << "error: vertex doesn't exist!\n";
-        Vec3 pos12(setA(i,0), setA(i,1), setA(i,2));
-        info = setAUncertainty[i].inverse();
-        Edge3D edge2(pos12,info, 1,featureIdx);
-        if (!graph.addEdge3D(edge2))
-            std::cout << "error: vertex doesn't exist!\n";
-
-        featureIdx++;
-    }
-
-//    graph.save2file("singleTr.g2o");
-    //graph.optimize(70);
-
-    uncertainty = graph.getPoseIncrementCovariance(1);
-    //std::cout << "kabsch est: \n";
-    //std::cout << transformation(0,3) << " " << transformation(1,3) << " "  << transformation(2,3);
-    //Quaternion qq(transformation.rotation());
-    //std::cout << " " << qq.x() << " " << qq.y() << " "  << qq.z() << " " << qq.w() << "\n";
-    //getchar();
-    //uncertainty = computeCovarianceMatrix(uncertainty,transformation);
-
-    uncertainty = uncertainty.inverse();
-
+    // information matrix of the pose increment (x, y, z, qx, qy, qz) evaluated at 'transformation'
+    Eigen::Matrix<double,6,1> g;
+    computeResidualInfo(setA.rows(), &setAUncertainty, &setBUncertainty, transformation);
+    computeNormalEquations(setA, setB, transformation, uncertainty, g);
     return uncertainty;
 }
 
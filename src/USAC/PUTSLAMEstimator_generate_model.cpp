@@ -48,8 +48,8 @@ bool PUTSLAMEstimator::computeTransformationModel(
 		std::cout << "Using g2oEst for transformation model" << std::endl;
 		putslam::TransformEst* g2oEst = putslam::createG2OEstimator();
 		Mat34 transformation = g2oEst->computeTransformation(
-			featuresMatrix.cast<double>().transpose(),
-			prevFeaturesMatrix.cast<double>().transpose());
+			featuresMatrix.cast<double>(),
+			prevFeaturesMatrix.cast<double>());
 		transformationModel = transformation.cast<float>().matrix();
 	}
 	else {
@@ -30,7 +30,7 @@ void Subject::notify(const cv::Mat& color, const cv::Mat& depth, int frameNo){
     }
 }
 
-void Subject::notify(std::vector<putslam::Edge>& features){
+void Subject::notify(std::vector<putslam::Edge3D>& features){
     for(vector<Observer*>::const_iterator iter = list.begin(); iter != list.end(); ++iter)
     {
         if(*iter != 0) {
@@ -0,0 +1,237 @@
+#include "Utilities/profiler.h"
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+
+using namespace putslam;
+
+/// events of the current thread (registered on the first event)
+static thread_local void* localEvents = nullptr;
+
+/// the instance
+Profiler& Profiler::get(void) {
+    static Profiler profiler;
+    return profiler;
+}
+
+/// Construction
+Profiler::Profiler(void) : enabled(false), trace(false), eventsPerThread(1 << 18),
+    startTime(std::chrono::steady_clock::now()), histograms(new Histogram[maxStagesNo]) {
+}
+
+Profiler::Histogram::Histogram() : count(0), sum(0), max(0) {
+    for (int i = 0; i < bucketsNo; i++)
+        buckets[i] = 0;
+}
+
+Profiler::ThreadEvents::ThreadEvents(int _threadNo) : threadNo(_threadNo), capacity(0), size(0), dropped(0) {
+}
+
+/// register stage (the same name -- the same id)
+int Profiler::registerStage(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mtxStages);
+    auto stage = std::find(stagesNames.begin(), stagesNames.end(), name);
+    if (stage != stagesNames.end())
+        return (int) (stage - stagesNames.begin());
+    if ((int) stagesNames.size() >= maxStagesNo) {
+        std::cerr << "Profiler: too many stages, " << name << " is not measured\n";
+        return -1;
+    }
+    stagesNames.push_back(name);
+    return (int) stagesNames.size() - 1;
+}
+
+/// enable recording (histograms), trace -- store events for the trace export too
+void Profiler::setEnabled(bool _enabled, bool _trace, size_t _eventsPerThread) {
+    mtxThreads.lock();
+    eventsPerThread = _eventsPerThread;
+    mtxThreads.unlock();
+    trace = _trace;
+    enabled = _enabled;
+}
+
+/// name of the current thread (trace)
+void Profiler::setThreadName(const std::string& name) {
+    ThreadEvents* events = threadEvents();
+    mtxThreads.lock();
+    events->name = name;
+    mtxThreads.unlock();
+}
+
+/// events of the current thread
+Profiler::ThreadEvents* Profiler::threadEvents(void) {
+    if (localEvents == nullptr) {
+        std::lock_guard<std::mutex> lock(mtxThreads);
+        threads.push_back(std::unique_ptr<ThreadEvents>(new ThreadEvents((int) threads.size())));
+        localEvents = threads.back().get();
+    }
+    return static_cast<ThreadEvents*>(localEvents);
+}
+
+/// index of the most significant bit (value > 0)
+static inline int highestBit(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = 0;
+    while (value >>= 1)
+        bit++;
+    return bit;
+#endif
+}
+
+/// bucket of the duration
+int Profiler::bucket(uint64_t duration) {
+    if (duration < 8)
+        return (int) duration;
+    int octave = highestBit(duration);
+    int bucketNo = 8 + (octave - 3) * 8 + (int) ((duration >> (octave - 3)) - 8);
+    return std::min(bucketNo, bucketsNo - 1);
+}
+
+/// mean duration of the bucket
+double Profiler::bucketValue(int bucketNo) {
+    if (bucketNo < 8)
+        return (double) bucketNo;
+    int octave = (bucketNo - 8) / 8 + 3;
+    int sub = (bucketNo - 8) % 8;
+    return std::ldexp(8.0 + sub + 0.5, octave - 3);
+}
+
+/// record the stage executed in [start, end] [us]
+void Profiler::record(int stageId, int64_t start, int64_t end) {
+    if (stageId < 0)
+        return;
+    uint64_t duration = (uint64_t) std::max(end - start, (int64_t) 0);
+    Histogram& histogram = histograms[stageId];
+    histogram.buckets[bucket(duration)].fetch_add(1, std::memory_order_relaxed);
+    histogram.count.fetch_add(1, std::memory_order_relaxed);
+    histogram.sum.fetch_add(duration, std::memory_order_relaxed);
+    uint64_t max = histogram.max.load(std::memory_order_relaxed);
+    while (duration > max && !histogram.max.compare_exchange_weak(max, duration, std::memory_order_relaxed));
+
+    if (trace.load(std::memory_order_relaxed)) {
+        ThreadEvents* events = threadEvents();
+        if (!events->events) {
+            // the buffer is allocated on the first stored event (threads which only set the name do not allocate)
+            mtxThreads.lock();
+            events->capacity = eventsPerThread;
+            mtxThreads.unlock();
+            events->events.reset(new Event[events->capacity]);
+        }
+        size_t size = events->size.load(std::memory_order_relaxed);
+        if (size < events->capacity) {
+            events->events[size].stageId = stageId;
+            events->events[size].start = start;
+            events->events[size].end = end;
+            events->size.store(size + 1, std::memory_order_release);
+        }
+        else
+            events->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/// percentile computed from the histogram
+double Profiler::percentile(const Histogram& histogram, double p) const {
+    uint64_t count = histogram.count.load(std::memory_order_relaxed);
+    if (count == 0)
+        return 0.0;
+    uint64_t rank = (uint64_t) std::ceil(std::min(std::max(p, 0.0), 1.0) * (double) count);
+    rank = std::max(rank, (uint64_t) 1);
+    uint64_t sum = 0;
+    for (int i = 0; i < bucketsNo; i++) {
+        sum += histogram.buckets[i].load(std::memory_order_relaxed);
+        if (sum >= rank)
+            return std::min(bucketValue(i), (double) histogram.max.load(std::memory_order_relaxed));
+    }
+    return (double) histogram.max.load(std::memory_order_relaxed);
+}
+
+/// percentile of the stage duration (p in [0,1]) [us]
+double Profiler::percentile(int stageId, double p) const {
+    if (stageId < 0 || stageId >= maxStagesNo)
+        return 0.0;
+    return percentile(histograms[stageId], p);
+}
+
+/// statistics of stages
+std::vector<Profiler::Stats> Profiler::getStats(void) const {
+    std::vector<Stats> stats;
+    std::lock_guard<std::mutex> lock(mtxStages);
+    for (size_t i = 0; i < stagesNames.size(); i++) {
+        const Histogram& histogram = histograms[i];
+        Stats stageStats;
+        stageStats.name = stagesNames[i];
+        stageStats.count = histogram.count.load(std::memory_order_relaxed);
+        if (stageStats.count == 0)
+            continue;
+        stageStats.mean = (double) histogram.sum.load(std::memory_order_relaxed) / (double) stageStats.count;
+        stageStats.p50 = percentile(histogram, 0.50);
+        stageStats.p95 = percentile(histogram, 0.95);
+        stageStats.p99 = percentile(histogram, 0.99);
+        stageStats.max = (double) histogram.max.load(std::memory_order_relaxed);
+        stats.push_back(stageStats);
+    }
+    return stats;
+}
+
+/// print statistics
+void Profiler::printStats(std::ostream& os) const {
+    os << "Profiler: stage, count, mean, p50, p95, p99, max [ms]\n";
+    for (auto& stats : getStats()) {
+        os << stats.name << "\t" << stats.count << "\t" << stats.mean / 1000.0 << "\t" << stats.p50 / 1000.0 << "\t"
+                << stats.p95 / 1000.0 << "\t" << stats.p99 / 1000.0 << "\t" << stats.max / 1000.0 << "\n";
+    }
+}
+
+/// save statistics (stage, count, mean, p50, p95, p99, max [us])
+bool Profiler::saveCSV(const std::string& filename) const {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Profiler: unable to open " << filename << "\n";
+        return false;
+    }
+    file << "stage,count,mean_us,p50_us,p95_us,p99_us,max_us\n";
+    for (auto& stats : getStats()) {
+        file << stats.name << "," << stats.count << "," << stats.mean << "," << stats.p50 << ","
+                << stats.p95 << "," << stats.p99 << "," << stats.max << "\n";
+    }
+    file.close();
+    return true;
+}
+
+/// save events in the Chrome trace format
+bool Profiler::saveTrace(const std::string& filename) const {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Profiler: unable to open " << filename << "\n";
+        return false;
+    }
+    std::vector<std::string> names;
+    mtxStages.lock();
+    names = stagesNames;
+    mtxStages.unlock();
+
+    file << "{\"traceEvents\":[\n";
+    bool first = true;
+    std::lock_guard<std::mutex> lock(mtxThreads);
+    for (auto& thread : threads) {
+        if (!thread->name.empty()) {
+            file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->threadNo
+                    << ",\"args\":{\"name\":\"" << thread->name << "\"}}";
+            first = false;
+        }
+        size_t size = thread->size.load(std::memory_order_acquire);
+        for (size_t i = 0; i < size; i++) {
+            const Event& event = thread->events[i];
+            file << (first ? "" : ",\n") << "{\"name\":\"" << names[event.stageId] << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                    << thread->threadNo << ",\"ts\":" << event.start << ",\"dur\":" << (event.end - event.start) << "}";
+            first = false;
+        }
+        if (thread->dropped > 0)
+            std::cout << "Profiler: " << thread->dropped << " events of thread " << thread->threadNo << " were not stored (buffer is full)\n";
+    }
+    file << "\n]}\n";
+    file.close();
+    return true;
+}
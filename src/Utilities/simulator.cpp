@@ -2,14 +2,30 @@
 #include <fstream>
 #include "Defs/eigen3.h"
 #include <vector>
+#include <thread>
+#include <atomic>
+#include <numeric>
+#include <algorithm>
+#include <limits>
+#include <cstdio>
+
+/// depth range of the sensor (DepthSensorModel::inverseModel)
+static const double minSensorDepth = 0.8, maxSensorDepth = 6.0;
+/// max number of cells of the spatial index
+static const double maxIndexCellsNo = 1e7;
 
 Simulator::Simulator(void){
     generator.seed((unsigned int)time(0));
 }
 
+Simulator::Simulator(unsigned int seed){
+    generator.seed(seed);
+}
+
 ///create environment -- room(walls,floor, ceiling)
 void Simulator::createRoom(size_t pointsNo, double width, double length, double height){
     environment.clear();
+    index = SpatialIndex();
     std::uniform_real_distribution<double> distributionWidth(-width/2.0, width/2.0);
     std::uniform_real_distribution<double> distributionLength(-length/2.0, length/2.0);
     std::uniform_real_distribution<double> distributionHeight(0, height);
@@ -39,6 +55,7 @@ void Simulator::createRoom(size_t pointsNo, double width, double length, double
 ///create environment -- random patches
 void Simulator::createEnvironment(size_t pointsNo, double width, double length, double height){
     environment.clear();
+    index = SpatialIndex();
     std::uniform_real_distribution<double> distributionWidth(-width/2.0, width/2.0);
     std::uniform_real_distribution<double> distributionLength(-length/2.0, length/2.0);
     std::uniform_real_distribution<double> distributionHeight(-height/2.0, height/2.0);
@@ -72,6 +89,7 @@ void Simulator::createEnvironment(size_t pointsNo, double width, double length,
 void Simulator::loadEnvironment(std::string filename){
     std::string line;    std::ifstream myfile(filename);
     Point3D point;
+    index = SpatialIndex();
     if (myfile.is_open()) {
         Vec3 pos;
         while ( getline (myfile,line) ) {
@@ -86,7 +104,7 @@ void Simulator::loadEnvironment(std::string filename){
 }
 
 /// samples from multivariate gaussian
-Point3D Simulator::sampleFromMultivariateGaussian(Eigen::Vector3d mean, Eigen::MatrixXd cov){
+Point3D Simulator::sampleFromMultivariateGaussian(Eigen::Vector3d mean, Eigen::MatrixXd cov, std::default_random_engine& randomEngine){
 
     Eigen::MatrixXd normTransform(mean.rows(),mean.rows());
     Eigen::LLT<Eigen::MatrixXd> cholSolver(cov);
@@ -106,7 +124,7 @@ Point3D Simulator::sampleFromMultivariateGaussian(Eigen::Vector3d mean, Eigen::M
     std::normal_distribution<double> normDistribution(0.0,0.5);
     Eigen::Vector3d sampleGauss;
     for (int i=0;i<3;i++)
-        sampleGauss(i) = normDistribution(generator);
+        sampleGauss(i) = normDistribution(randomEngine);
     Eigen::Vector3d sample = (normTransform*sampleGauss) + mean;
 
     Point3D point;
@@ -115,34 +133,163 @@ Point3D Simulator::sampleFromMultivariateGaussian(Eigen::Vector3d mean, Eigen::M
     return point;
 }
 
+/// build spatial index of the environment (uniform grid)
+void Simulator::buildIndex(double cellSize){
+    index = SpatialIndex();
+    if (environment.empty())
+        return;
+    Eigen::Vector3d minCorner(environment[0].x, environment[0].y, environment[0].z), maxCorner(minCorner);
+    for (auto& point : environment){
+        minCorner = minCorner.cwiseMin(Eigen::Vector3d(point.x, point.y, point.z));
+        maxCorner = maxCorner.cwiseMax(Eigen::Vector3d(point.x, point.y, point.z));
+    }
+    Eigen::Vector3d extent = maxCorner - minCorner;
+    index.cellSize = cellSize;
+    while ((extent(0)/index.cellSize+1.0)*(extent(1)/index.cellSize+1.0)*(extent(2)/index.cellSize+1.0) > maxIndexCellsNo)
+        index.cellSize *= 2.0;
+    index.origin = minCorner;
+    for (int i=0;i<3;i++)
+        index.cellsNo[i] = (int)std::floor(extent(i)/index.cellSize)+1;
+    size_t cellsNo = (size_t)index.cellsNo[0]*(size_t)index.cellsNo[1]*(size_t)index.cellsNo[2];
+
+    // counting sort of points by cells (ids in the cell stay sorted)
+    std::vector<size_t> pointCells(environment.size());
+    index.cellStart.assign(cellsNo+1, 0);
+    for (size_t i=0;i<environment.size();i++){
+        size_t cell[3];
+        cell[0] = std::min((size_t)((environment[i].x-index.origin(0))/index.cellSize), (size_t)index.cellsNo[0]-1);
+        cell[1] = std::min((size_t)((environment[i].y-index.origin(1))/index.cellSize), (size_t)index.cellsNo[1]-1);
+        cell[2] = std::min((size_t)((environment[i].z-index.origin(2))/index.cellSize), (size_t)index.cellsNo[2]-1);
+        pointCells[i] = (cell[2]*(size_t)index.cellsNo[1]+cell[1])*(size_t)index.cellsNo[0]+cell[0];
+        index.cellStart[pointCells[i]+1]++;
+    }
+    std::partial_sum(index.cellStart.begin(), index.cellStart.end(), index.cellStart.begin());
+    std::vector<size_t> cellFill(index.cellStart.begin(), index.cellStart.end()-1);
+    index.pointIds.resize(environment.size());
+    for (size_t i=0;i<environment.size();i++)
+        index.pointIds[cellFill[pointCells[i]]++] = (int)i;
+}
+
+/// ids of points which are potentially visible (sorted), all points if the index is not built
+void Simulator::getCandidates(const Mat34& sensorPose, const Mat34& sensorPoseInv, const DepthSensorModel& sensorModel, std::vector<int>& candidates) const{
+    candidates.clear();
+    if (index.cellStart.empty()){
+        candidates.resize(environment.size());
+        std::iota(candidates.begin(), candidates.end(), 0);
+        return;
+    }
+    const DepthSensorModel::Config& config = sensorModel.config;
+    // range of cells which contains the view frustum
+    Eigen::Vector3d minCorner(Eigen::Vector3d::Constant(std::numeric_limits<double>::max())), maxCorner(-minCorner);
+    for (double depth : {minSensorDepth, maxSensorDepth}){
+        for (int u : {0, config.imageSize[0]}){
+            for (int v : {0, config.imageSize[1]}){
+                Eigen::Vector3d corner(((double)u-config.focalAxis[0])*depth/config.focalLength[0], ((double)v-config.focalAxis[1])*depth/config.focalLength[1], depth);
+                corner = sensorPose*corner;
+                minCorner = minCorner.cwiseMin(corner);
+                maxCorner = maxCorner.cwiseMax(corner);
+            }
+        }
+    }
+    int cellMin[3], cellMax[3];
+    for (int i=0;i<3;i++){
+        cellMin[i] = std::max(0, (int)std::floor((minCorner(i)-index.origin(i))/index.cellSize));
+        cellMax[i] = std::min(index.cellsNo[i]-1, (int)std::floor((maxCorner(i)-index.origin(i))/index.cellSize));
+        if (cellMin[i]>cellMax[i])
+            return;
+    }
+    // side planes of the frustum in the sensor frame (normals point inside)
+    std::vector<Eigen::Vector3d> planes = {Eigen::Vector3d(config.focalLength[0], 0, config.focalAxis[0]).normalized(),
+                                           Eigen::Vector3d(-config.focalLength[0], 0, config.imageSize[0]-config.focalAxis[0]).normalized(),
+                                           Eigen::Vector3d(0, config.focalLength[1], config.focalAxis[1]).normalized(),
+                                           Eigen::Vector3d(0, -config.focalLength[1], config.imageSize[1]-config.focalAxis[1]).normalized()};
+    // cells are tested with their bounding spheres
+    double radius = 0.5*sqrt(3.0)*index.cellSize;
+    for (int z=cellMin[2];z<=cellMax[2];z++){
+        for (int y=cellMin[1];y<=cellMax[1];y++){
+            for (int x=cellMin[0];x<=cellMax[0];x++){
+                size_t cell = ((size_t)z*(size_t)index.cellsNo[1]+(size_t)y)*(size_t)index.cellsNo[0]+(size_t)x;
+                if (index.cellStart[cell]==index.cellStart[cell+1])
+                    continue;
+                Eigen::Vector3d center = index.origin + (Eigen::Vector3d(x, y, z)+Eigen::Vector3d::Constant(0.5))*index.cellSize;
+                Eigen::Vector3d centerSensor = sensorPoseInv*center;
+                if (centerSensor.z()<minSensorDepth-radius||centerSensor.z()>maxSensorDepth+radius)
+                    continue;
+                bool inside = true;
+                for (auto& plane : planes){
+                    if (plane.dot(centerSensor)<-radius){
+                        inside = false;
+                        break;
+                    }
+                }
+                if (inside)
+                    candidates.insert(candidates.end(), index.pointIds.begin()+(long)index.cellStart[cell], index.pointIds.begin()+(long)index.cellStart[cell+1]);
+            }
+        }
+    }
+    // the same order of points (and noise samples) as without the index
+    std::sort(candidates.begin(), candidates.end());
+}
+
 /// get point cloud from current camera view
 std::vector<int> Simulator::getCloud(const Mat34& sensorPose, DepthSensorModel& sensorModel, PointCloud& setPoints, std::vector<Mat33>& setUncertainty){
+    return getCloud(sensorPose, sensorModel, setPoints, setUncertainty, generator);
+}
+
+/// get point cloud from current camera view using the given random engine
+std::vector<int> Simulator::getCloud(const Mat34& sensorPose, DepthSensorModel& sensorModel, PointCloud& setPoints, std::vector<Mat33>& setUncertainty, std::default_random_engine& randomEngine){
     std::vector<int> pointIdentifiers;
     setPoints.clear();
     setUncertainty.clear();
-    for (size_t i=0;i<environment.size();i++){
+    Mat34 sensorPoseInv(sensorPose.inverse());
+    std::vector<int> candidates;
+    getCandidates(sensorPose, sensorPoseInv, sensorModel, candidates);
+    for (int i : candidates){
         Eigen::Vector4d point(environment[i].x, environment[i].y, environment[i].z, 1);
-        Eigen::Vector4d pointCamera = sensorPose.matrix().inverse()*point;
+        Eigen::Vector4d pointCamera = sensorPoseInv.matrix()*point;
         Eigen::Vector3d point2d = sensorModel.inverseModel(pointCamera(0), pointCamera(1), pointCamera(2));
         if (point2d(0)!=-1){
             Mat33 uncertainty;
             sensorModel.computeCov((uint_fast16_t)point2d(0), (uint_fast16_t)point2d(1), point2d(2), uncertainty);
-            Point3D point3D = sampleFromMultivariateGaussian(Eigen::Vector3d(pointCamera(0), pointCamera(1), pointCamera(2)),uncertainty);
+            Point3D point3D = sampleFromMultivariateGaussian(Eigen::Vector3d(pointCamera(0), pointCamera(1), pointCamera(2)),uncertainty, randomEngine);
             //point3D.x = pointCamera[0]; point3D.y = pointCamera[1]; point3D.z = pointCamera[2]; // no noise
             //point3D.x = room[i].x; point3D.y = room[i].y; point3D.z = room[i].z; // no noise global frame
             Eigen::Vector3d point2dTmp = sensorModel.inverseModel(point3D.x, point3D.y, point3D.z);
             if (point2dTmp(0)!=-1){
                 setPoints.push_back(point3D);
-                Eigen::Vector3d inv2d = sensorModel.inverseModel(point3D.x, point3D.y, point3D.z);
-                sensorModel.computeCov((uint_fast16_t)inv2d(0), (uint_fast16_t)inv2d(1), inv2d(2), uncertainty);
+                sensorModel.computeCov((uint_fast16_t)point2dTmp(0), (uint_fast16_t)point2dTmp(1), point2dTmp(2), uncertainty);
                 setUncertainty.push_back(uncertainty);
-                pointIdentifiers.push_back((int)i);
+                pointIdentifiers.push_back(i);
             }
         }
     }
     return pointIdentifiers;
 }
 
+/// get point clouds from sensor poses in parallel
+void Simulator::getClouds(const std::vector<Mat34>& sensorPoses, const DepthSensorModel& sensorModel, const std::vector<unsigned int>& seeds, std::vector<PointCloud>& cloudSeq, std::vector< std::vector<int> >& setIds, std::vector< std::vector<Mat33> >& uncertaintySet, int threadsNo){
+    cloudSeq.resize(sensorPoses.size());
+    setIds.resize(sensorPoses.size());
+    uncertaintySet.resize(sensorPoses.size());
+    if (threadsNo<=0)
+        threadsNo = std::max((int)std::thread::hardware_concurrency(), 1);
+    threadsNo = std::min(threadsNo, (int)sensorPoses.size());
+    std::atomic<size_t> nextPose(0);
+    auto processPoses = [&](){
+        // computeCov modifies the model, every thread uses its own copy
+        DepthSensorModel model(sensorModel);
+        for (size_t poseNo = nextPose++; poseNo<sensorPoses.size(); poseNo = nextPose++){
+            std::default_random_engine randomEngine(seeds[poseNo]);
+            setIds[poseNo] = getCloud(sensorPoses[poseNo], model, cloudSeq[poseNo], uncertaintySet[poseNo], randomEngine);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i=0;i<threadsNo;i++)
+        threads.push_back(std::thread(processPoses));
+    for (auto& thread : threads)
+        thread.join();
+}
+
 /// match point clouds
 bool Simulator::matchClouds(const PointCloud& setAin, Eigen::MatrixXd& setAout, const std::vector<Mat33>& uncertaintyAin, std::vector<Mat33>& uncertaintyAout, const std::vector<int>& setAids, const PointCloud& setBin, Eigen::MatrixXd& setBout, const std::vector<Mat33>& uncertaintyBin, std::vector<Mat33>& uncertaintyBout, const std::vector<int>& setBids){
     int matchesNo=0;
@@ -170,23 +317,141 @@ bool Simulator::matchClouds(const PointCloud& setAin, Eigen::MatrixXd& setAout,
 }
 
 /// run experiment and return a sequence of point clouds
-void Simulator::moveCamera(const std::vector<Mat34>& robotTrajectory, const Mat34 sensorPose, DepthSensorModel& sensorModel, std::vector<PointCloud>& cloudSeq, std::vector< std::vector<int> >& setIds, std::vector< std::vector<Mat33> >& uncertaintySet){
+void Simulator::moveCamera(const std::vector<Mat34>& robotTrajectory, const Mat34 sensorPose, DepthSensorModel& sensorModel, std::vector<PointCloud>& cloudSeq, std::vector< std::vector<int> >& setIds, std::vector< std::vector<Mat33> >& uncertaintySet, int threadsNo){
     cloudSeq.clear();    setIds.clear();    uncertaintySet.clear();
-    Mat34 sensorPoseGlobal; sensorPoseGlobal.matrix() = robotTrajectory[0].matrix()*sensorPose.matrix();
-    PointCloud cloud; std::vector<Mat33> uncertaintyCloud;
-    //std::vector<int> setId = getCloud(sensorPoseGlobal, sensorModel, environment, cloud, uncertaintyCloud);
-    //savePointCloud("../../resources/KabschUncertainty/cloud0.m", cloudA);
-    //cloudA = cloud2local(cloudA, sensorPose);
+    std::vector<Mat34> sensorPoses;
+    std::vector<unsigned int> seeds;
+    for (size_t i=0;i<robotTrajectory.size();i++){
+        Mat34 sensorPoseGlobal; sensorPoseGlobal.matrix() = robotTrajectory[i].matrix()*sensorPose.matrix();
+        sensorPoses.push_back(sensorPoseGlobal);
+        seeds.push_back((unsigned int)generator());
+    }
+    getClouds(sensorPoses, sensorModel, seeds, cloudSeq, setIds, uncertaintySet, threadsNo);
+}
+
+/// write pose: x y z qx qy qz qw
+static void writePose(std::ostream& os, const Mat34& pose){
+    Quaternion q(pose.rotation());
+    os << pose(0,3) << " " << pose(1,3) << " " << pose(2,3) << " " << q.x() << " " << q.y() << " " << q.z() << " " << q.w();
+}
+
+/// generate measurements along the trajectory and save the measurement stream and the graph
+bool Simulator::generateSequence(const std::vector<Mat34>& robotTrajectory, const Mat34& sensorPose, const DepthSensorModel& sensorModel, const std::string& measurementsFilename, const std::string& graphFilename, const SequenceConfig& sequenceConfig){
+    // edges are saved to the temporary file, vertices (initial estimates) are known at the end
+    std::string edgesFilename = graphFilename + ".edges";
+    std::ofstream measurements(measurementsFilename), edges(edgesFilename);
+    if (!measurements.is_open()||!edges.is_open()){
+        std::cout << "Simulator: unable to open " << measurementsFilename << " or " << edgesFilename << "\n";
+        return false;
+    }
+    measurements.precision(10); edges.precision(10);
+    measurements << "#FRAME pose_id x y z qx qy qz qw features_no (ground truth pose of the sensor)\n";
+    measurements << "#feature_id u v depth x y z (measurement in the sensor frame)\n";
+
+    // ground truth poses of the sensor and initial estimates from the noisy odometry
+    std::normal_distribution<double> noiseTrans(0.0, sequenceConfig.odometryNoiseTrans), noiseRot(0.0, sequenceConfig.odometryNoiseRot);
+    Mat66 odometryInfo(Mat66::Identity());
+    odometryInfo.block<3,3>(0,0) *= 1.0/pow(std::max(sequenceConfig.odometryNoiseTrans, 1e-6),2.0);
+    odometryInfo.block<3,3>(3,3) *= 1.0/pow(std::max(sequenceConfig.odometryNoiseRot, 1e-6),2.0);
+    std::vector<Mat34> sensorPoses, initialPoses;
+    std::vector<unsigned int> seeds;
     for (size_t i=0;i<robotTrajectory.size();i++){
-        //get point clouds
-        sensorPoseGlobal.matrix() = robotTrajectory[i].matrix()*sensorPose.matrix();
-        std::vector<int> setId = getCloud(sensorPoseGlobal, sensorModel, cloud, uncertaintyCloud);
-        cloudSeq.push_back(cloud);
-        setIds.push_back(setId);
-        //saveImageFeatures("../../resources/simulator/frame0.dat", sensorPose, cloudA, setAids, sensorModel, estimKabsch);
-        uncertaintySet.push_back(uncertaintyCloud);
-        //trajectorySensor.push_back(sensorPose);
+        Mat34 sensorPoseGlobal; sensorPoseGlobal.matrix() = robotTrajectory[i].matrix()*sensorPose.matrix();
+        sensorPoses.push_back(sensorPoseGlobal);
+        seeds.push_back((unsigned int)generator());
+        if (i==0){
+            initialPoses.push_back(sensorPoseGlobal);
+            continue;
+        }
+        Mat34 odometry(sensorPoses[i-1].inverse()*sensorPoseGlobal);
+        Mat34 odometryNoise(Eigen::Translation<double,3>(noiseTrans(generator), noiseTrans(generator), noiseTrans(generator))
+                            *Eigen::AngleAxisd(noiseRot(generator), Eigen::Vector3d::UnitX())
+                            *Eigen::AngleAxisd(noiseRot(generator), Eigen::Vector3d::UnitY())
+                            *Eigen::AngleAxisd(noiseRot(generator), Eigen::Vector3d::UnitZ()));
+        odometry = odometry*odometryNoise;
+        initialPoses.push_back(initialPoses.back()*odometry);
+        edges << "EDGE_SE3:QUAT " << i-1 << " " << i << " ";
+        writePose(edges, odometry);
+        for (int row=0;row<6;row++)
+            for (int col=row;col<6;col++)
+                edges << " " << odometryInfo(row,col);
+        edges << "\n";
     }
+
+    // features are initialized from the first measurement
+    size_t posesNo = robotTrajectory.size(), measurementsNo = 0;
+    std::vector<bool> featureObserved(environment.size(), false);
+    std::vector<Eigen::Vector3d> featureInit(environment.size());
+    size_t batchSize = std::max(sequenceConfig.batchSize, (size_t)1);
+    for (size_t firstPose=0;firstPose<posesNo;firstPose+=batchSize){
+        size_t lastPose = std::min(firstPose+batchSize, posesNo);
+        std::vector<Mat34> batchPoses(sensorPoses.begin()+(long)firstPose, sensorPoses.begin()+(long)lastPose);
+        std::vector<unsigned int> batchSeeds(seeds.begin()+(long)firstPose, seeds.begin()+(long)lastPose);
+        std::vector<PointCloud> cloudSeq; std::vector< std::vector<int> > setIds; std::vector< std::vector<Mat33> > uncertaintySet;
+        getClouds(batchPoses, sensorModel, batchSeeds, cloudSeq, setIds, uncertaintySet, sequenceConfig.threadsNo);
+        for (size_t i=0;i<cloudSeq.size();i++){
+            size_t poseNo = firstPose+i;
+            measurements << "FRAME " << poseNo << " ";
+            writePose(measurements, sensorPoses[poseNo]);
+            measurements << " " << cloudSeq[i].size() << "\n";
+            for (size_t j=0;j<cloudSeq[i].size();j++){
+                const Point3D& point = cloudSeq[i][j];
+                Eigen::Vector3d point2d = sensorModel.inverseModel(point.x, point.y, point.z);
+                measurements << setIds[i][j] << " " << point2d(0) << " " << point2d(1) << " " << point2d(2) << " " << point.x << " " << point.y << " " << point.z << "\n";
+                Mat33 info = uncertaintySet[i][j].inverse();
+                edges << "EDGE_SE3_TRACKXYZ " << poseNo << " " << posesNo+(size_t)setIds[i][j] << " 0 " << point.x << " " << point.y << " " << point.z << " "
+                      << info(0,0) << " " << info(0,1) << " " << info(0,2) << " " << info(1,1) << " " << info(1,2) << " " << info(2,2) << "\n";
+                if (!featureObserved[(size_t)setIds[i][j]]){
+                    featureObserved[(size_t)setIds[i][j]] = true;
+                    featureInit[(size_t)setIds[i][j]] = initialPoses[poseNo]*Eigen::Vector3d(point.x, point.y, point.z);
+                }
+            }
+            measurementsNo += cloudSeq[i].size();
+        }
+    }
+    measurements.close();
+    edges.close();
+
+    std::ofstream graph(graphFilename);
+    if (!graph.is_open()){
+        std::cout << "Simulator: unable to open " << graphFilename << "\n";
+        return false;
+    }
+    graph.precision(10);
+    size_t featuresNo = 0;
+    for (size_t i=0;i<posesNo;i++){
+        graph << "VERTEX_SE3:QUAT " << i << " ";
+        writePose(graph, initialPoses[i]);
+        graph << "\n";
+    }
+    if (posesNo>0)
+        graph << "FIX 0\n";
+    for (size_t i=0;i<environment.size();i++){
+        if (featureObserved[i]){
+            graph << "VERTEX_TRACKXYZ " << posesNo+i << " " << featureInit[i].x() << " " << featureInit[i].y() << " " << featureInit[i].z() << "\n";
+            featuresNo++;
+        }
+    }
+    std::ifstream edgesIn(edgesFilename);
+    graph << edgesIn.rdbuf();
+    edgesIn.close();
+    graph.close();
+    std::remove(edgesFilename.c_str());
+    std::cout << "Simulator: " << posesNo << " poses, " << featuresNo << " features, " << measurementsNo << " measurements\n";
+    return true;
+}
+
+/// save environment (feature id, x, y, z)
+bool Simulator::saveEnvironment(const std::string& filename) const{
+    std::ofstream file(filename);
+    if (!file.is_open()){
+        std::cout << "Simulator: unable to open " << filename << "\n";
+        return false;
+    }
+    file.precision(10);
+    for (size_t i=0;i<environment.size();i++)
+        file << i << " " << environment[i].x << " " << environment[i].y << " " << environment[i].z << "\n";
+    return true;
 }
 
 /// get environment
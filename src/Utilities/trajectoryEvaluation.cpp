@@ -0,0 +1,303 @@
+#include "Utilities/trajectoryEvaluation.h"
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <tuple>
+#include <thread>
+#include <cmath>
+
+using namespace putslam;
+
+/// Construction
+TrajectoryEvaluator::TrajectoryEvaluator(void) {
+}
+
+/// Construction
+TrajectoryEvaluator::TrajectoryEvaluator(const Config& _config) : config(_config) {
+}
+
+/// compute statistics (errors are sorted)
+TrajectoryEvaluator::ErrorStats TrajectoryEvaluator::ErrorStats::compute(std::vector<double>& errors) {
+    ErrorStats stats;
+    if (errors.empty())
+        return stats;
+    std::sort(errors.begin(), errors.end());
+    stats.count = errors.size();
+    double sum = 0, sumSquares = 0;
+    for (auto& error : errors) {
+        sum += error;
+        sumSquares += error * error;
+    }
+    stats.mean = sum / (double) stats.count;
+    stats.rmse = sqrt(sumSquares / (double) stats.count);
+    stats.stdDev = sqrt(std::max(sumSquares / (double) stats.count - stats.mean * stats.mean, 0.0));
+    stats.median = (stats.count % 2) ? errors[stats.count / 2] : 0.5 * (errors[stats.count / 2 - 1] + errors[stats.count / 2]);
+    stats.min = errors.front();
+    stats.max = errors.back();
+    return stats;
+}
+
+/// load trajectory (Freiburg format: timestamp x y z qx qy qz qw)
+bool TrajectoryEvaluator::loadTrajectory(const std::string& filename, Trajectory& trajectory) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cout << "TrajectoryEvaluator: unable to open " << filename << "\n";
+        return false;
+    }
+    trajectory.clear();
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::istringstream is(line);
+        double timestamp;
+        Eigen::Vector3d pos;
+        Quaternion q;
+        if (!(is >> timestamp >> pos.x() >> pos.y() >> pos.z() >> q.x() >> q.y() >> q.z() >> q.w()))
+            continue;
+        Mat34 pose(Mat34::Identity());
+        pose.linear() = q.normalized().matrix();
+        pose.translation() = pos;
+        trajectory.push_back(StampedPose(timestamp, pose));
+    }
+    std::stable_sort(trajectory.begin(), trajectory.end(),
+            [](const StampedPose& a, const StampedPose& b) {return a.timestamp < b.timestamp;});
+    return !trajectory.empty();
+}
+
+/// associate timestamps (the closest pairs first), returns pairs of ids sorted by the first trajectory
+std::vector<std::pair<size_t, size_t>> TrajectoryEvaluator::associate(const Trajectory& first, const Trajectory& second) const {
+    // potential matches: time difference, first id, second id
+    std::vector<std::tuple<double, size_t, size_t>> potentialMatches;
+    for (size_t i = 0; i < first.size(); i++) {
+        double timestamp = first[i].timestamp - config.offset;
+        auto it = std::lower_bound(second.begin(), second.end(), timestamp - config.maxDifference,
+                [](const StampedPose& pose, double value) {return pose.timestamp < value;});
+        for (; it != second.end() && it->timestamp < timestamp + config.maxDifference; it++) {
+            double difference = fabs(first[i].timestamp - (it->timestamp + config.offset));
+            if (difference < config.maxDifference)
+                potentialMatches.push_back(std::make_tuple(difference, i, (size_t) (it - second.begin())));
+        }
+    }
+    std::sort(potentialMatches.begin(), potentialMatches.end());
+    std::vector<bool> firstUsed(first.size(), false), secondUsed(second.size(), false);
+    std::vector<std::pair<size_t, size_t>> matches;
+    for (auto& match : potentialMatches) {
+        size_t i = std::get<1>(match), j = std::get<2>(match);
+        if (!firstUsed[i] && !secondUsed[j]) {
+            firstUsed[i] = true;
+            secondUsed[j] = true;
+            matches.push_back(std::make_pair(i, j));
+        }
+    }
+    std::sort(matches.begin(), matches.end());
+    return matches;
+}
+
+/// compute ATE (translational error after alignment)
+bool TrajectoryEvaluator::computeATE(const Trajectory& groundtruth, const Trajectory& estimated, ATEResult& result) const {
+    result.associations = associate(groundtruth, estimated);
+    if (result.associations.size() < 3) {
+        std::cout << "TrajectoryEvaluator: not enough associated poses (" << result.associations.size() << ")\n";
+        return false;
+    }
+    Eigen::Matrix<double, 3, Eigen::Dynamic> groundtruthXYZ(3, result.associations.size());
+    Eigen::Matrix<double, 3, Eigen::Dynamic> estimatedXYZ(3, result.associations.size());
+    for (size_t i = 0; i < result.associations.size(); i++) {
+        groundtruthXYZ.col(i) = groundtruth[result.associations[i].first].pose.translation();
+        estimatedXYZ.col(i) = estimated[result.associations[i].second].pose.translation() * config.scale;
+    }
+    // rotation and translation which align the estimated trajectory to the ground truth (no scale)
+    result.alignment.matrix() = Eigen::umeyama(estimatedXYZ, groundtruthXYZ, false);
+    std::vector<double> errors(result.associations.size());
+    for (size_t i = 0; i < result.associations.size(); i++)
+        errors[i] = (result.alignment * Eigen::Vector3d(estimatedXYZ.col(i)) - groundtruthXYZ.col(i)).norm();
+    result.translational = ErrorStats::compute(errors);
+    return true;
+}
+
+/// compute RPE
+bool TrajectoryEvaluator::computeRPE(const Trajectory& groundtruth, const Trajectory& estimated, RPEResult& result) const {
+    if (estimated.size() < 2 || groundtruth.size() < 2) {
+        std::cout << "TrajectoryEvaluator: not enough poses to compute RPE\n";
+        return false;
+    }
+    // the closest element of the sorted sequence
+    auto findClosest = [](const std::vector<double>& values, double value) -> size_t {
+        size_t id = std::lower_bound(values.begin(), values.end(), value) - values.begin();
+        if (id == values.size())
+            return id - 1;
+        if (id > 0 && value - values[id - 1] < values[id] - value)
+            return id - 1;
+        return id;
+    };
+    std::vector<double> stampsGt(groundtruth.size()), stampsEst(estimated.size());
+    for (size_t i = 0; i < groundtruth.size(); i++)
+        stampsGt[i] = groundtruth[i].timestamp;
+    for (size_t i = 0; i < estimated.size(); i++)
+        stampsEst[i] = estimated[i].timestamp;
+
+    // position of poses along the trajectory in units of delta
+    std::vector<double> indexEst(estimated.size(), 0.0);
+    for (size_t i = 0; i < estimated.size(); i++) {
+        if (config.deltaUnit == 's')
+            indexEst[i] = stampsEst[i];
+        else if (config.deltaUnit == 'f' || i == 0)
+            indexEst[i] = (config.deltaUnit == 'f') ? (double) i : 0.0;
+        else {
+            Mat34 motion = estimated[i - 1].pose.inverse() * estimated[i].pose;
+            if (config.deltaUnit == 'm')
+                indexEst[i] = indexEst[i - 1] + motion.translation().norm();
+            else
+                indexEst[i] = indexEst[i - 1] + Eigen::AngleAxisd(motion.rotation()).angle();
+        }
+    }
+
+    // pairs of estimated poses
+    std::vector<std::pair<size_t, size_t>> pairs;
+    bool allPairs = false;
+    std::mt19937 generator(0);
+    if (!config.fixedDelta) {
+        if (config.maxPairs == 0 || (double) estimated.size() < sqrt((double) config.maxPairs))
+            allPairs = true;
+        else {
+            std::uniform_int_distribution<size_t> distribution(0, estimated.size() - 1);
+            for (size_t i = 0; i < config.maxPairs; i++)
+                pairs.push_back(std::make_pair(distribution(generator), distribution(generator)));
+        }
+    }
+    else {
+        for (size_t i = 0; i < estimated.size(); i++) {
+            size_t j = findClosest(indexEst, indexEst[i] + config.delta);
+            if (j != estimated.size() - 1)
+                pairs.push_back(std::make_pair(i, j));
+        }
+        if (config.maxPairs != 0 && pairs.size() > config.maxPairs) {
+            std::shuffle(pairs.begin(), pairs.end(), generator);
+            pairs.resize(config.maxPairs);
+        }
+    }
+
+    // max time difference between the estimated pose and the ground truth
+    std::vector<double> intervals(stampsGt.size() - 1);
+    for (size_t i = 0; i + 1 < stampsGt.size(); i++)
+        intervals[i] = stampsGt[i + 1] - stampsGt[i];
+    std::nth_element(intervals.begin(), intervals.begin() + intervals.size() / 2, intervals.end());
+    double gtMaxTimeDifference = 2.0 * intervals[intervals.size() / 2];
+
+    // ground truth poses associated with estimated poses (-1 if too far)
+    std::vector<int> gtIds(estimated.size());
+    for (size_t i = 0; i < estimated.size(); i++) {
+        size_t id = findClosest(stampsGt, stampsEst[i] + config.offset);
+        gtIds[i] = (fabs(stampsGt[id] - (stampsEst[i] + config.offset)) > gtMaxTimeDifference) ? -1 : (int) id;
+    }
+
+    // errors computed in parallel, every thread processes a range of pairs (rows of poses if all pairs are used)
+    size_t tasksNo = allPairs ? estimated.size() : pairs.size();
+    int threadsNo = std::max(std::min(getThreadsNo(), (int) tasksNo), 1);
+    std::vector<std::vector<double>> transErrors(threadsNo), rotErrors(threadsNo);
+    auto computeErrors = [&](int threadNo) {
+        auto addError = [&](size_t i, size_t j) {
+            if (gtIds[i] < 0 || gtIds[j] < 0)
+                return;
+            Mat34 motionEst = estimated[i].pose.inverse() * estimated[j].pose;
+            motionEst.translation() *= config.scale;
+            Mat34 motionGt = groundtruth[gtIds[i]].pose.inverse() * groundtruth[gtIds[j]].pose;
+            Mat34 error = motionEst * motionGt.inverse();
+            transErrors[threadNo].push_back(error.translation().norm());
+            double cosAngle = std::min(1.0, std::max(-1.0, (error.linear().trace() - 1.0) / 2.0));
+            rotErrors[threadNo].push_back(acos(cosAngle));
+        };
+        size_t begin = tasksNo * threadNo / threadsNo, end = tasksNo * (threadNo + 1) / threadsNo;
+        for (size_t task = begin; task < end; task++) {
+            if (allPairs) {
+                for (size_t j = 0; j < estimated.size(); j++)
+                    addError(task, j);
+            }
+            else
+                addError(pairs[task].first, pairs[task].second);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int threadNo = 1; threadNo < threadsNo; threadNo++)
+        threads.push_back(std::thread(computeErrors, threadNo));
+    computeErrors(0);
+    for (auto& thread : threads)
+        thread.join();
+
+    std::vector<double> translational, rotational;
+    for (int threadNo = 0; threadNo < threadsNo; threadNo++) {
+        translational.insert(translational.end(), transErrors[threadNo].begin(), transErrors[threadNo].end());
+        rotational.insert(rotational.end(), rotErrors[threadNo].begin(), rotErrors[threadNo].end());
+    }
+    if (translational.empty()) {
+        std::cout << "TrajectoryEvaluator: no pairs of poses to compute RPE\n";
+        return false;
+    }
+    result.translational = ErrorStats::compute(translational);
+    result.rotational = ErrorStats::compute(rotational);
+    return true;
+}
+
+/// print ATE (format of evaluate_ate.py --verbose)
+void TrajectoryEvaluator::printATE(std::ostream& os, const ATEResult& result) {
+    os << "compared_pose_pairs " << result.translational.count << " pairs\n";
+    os << "absolute_translational_error.rmse " << result.translational.rmse << " m\n";
+    os << "absolute_translational_error.mean " << result.translational.mean << " m\n";
+    os << "absolute_translational_error.median " << result.translational.median << " m\n";
+    os << "absolute_translational_error.std " << result.translational.stdDev << " m\n";
+    os << "absolute_translational_error.min " << result.translational.min << " m\n";
+    os << "absolute_translational_error.max " << result.translational.max << " m\n";
+}
+
+/// print RPE (format of evaluate_rpe.py --verbose)
+void TrajectoryEvaluator::printRPE(std::ostream& os, const RPEResult& result) {
+    const double rad2deg = 180.0 / M_PI;
+    os << "compared_pose_pairs " << result.translational.count << " pairs\n";
+    os << "translational_error.rmse " << result.translational.rmse << " m\n";
+    os << "translational_error.mean " << result.translational.mean << " m\n";
+    os << "translational_error.median " << result.translational.median << " m\n";
+    os << "translational_error.std " << result.translational.stdDev << " m\n";
+    os << "translational_error.min " << result.translational.min << " m\n";
+    os << "translational_error.max " << result.translational.max << " m\n";
+    os << "rotational_error.rmse " << result.rotational.rmse * rad2deg << " deg\n";
+    os << "rotational_error.mean " << result.rotational.mean * rad2deg << " deg\n";
+    os << "rotational_error.median " << result.rotational.median * rad2deg << " deg\n";
+    os << "rotational_error.std " << result.rotational.stdDev * rad2deg << " deg\n";
+    os << "rotational_error.min " << result.rotational.min * rad2deg << " deg\n";
+    os << "rotational_error.max " << result.rotational.max * rad2deg << " deg\n";
+}
+
+/// evaluate trajectory from file and save ATE and RPE to files
+bool TrajectoryEvaluator::evaluate(const Trajectory& groundtruth, const std::string& estimatedFilename,
+        const std::string& ateFilename, const std::string& rpeFilename) const {
+    Trajectory estimated;
+    if (!loadTrajectory(estimatedFilename, estimated))
+        return false;
+    ATEResult ate;
+    RPEResult rpe;
+    bool ateValid = computeATE(groundtruth, estimated, ate);
+    bool rpeValid = computeRPE(groundtruth, estimated, rpe);
+    if (ateValid) {
+        std::ofstream ateFile(ateFilename);
+        printATE(ateFile, ate);
+        std::cout << estimatedFilename << ": ATE rmse " << ate.translational.rmse << " m\n";
+    }
+    if (rpeValid) {
+        std::ofstream rpeFile(rpeFilename);
+        printRPE(rpeFile, rpe);
+        std::cout << estimatedFilename << ": RPE rmse " << rpe.translational.rmse << " m, "
+                << rpe.rotational.rmse * 180.0 / M_PI << " deg\n";
+    }
+    return ateValid && rpeValid;
+}
+
+/// number of threads
+int TrajectoryEvaluator::getThreadsNo(void) const {
+    if (config.threadsNo > 0)
+        return config.threadsNo;
+    return std::max((int) std::thread::hardware_concurrency(), 1);
+}
@@ -0,0 +1,144 @@
+#include "VisualPlaceRecognition/chowliutreebuilder.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+namespace of2 {
+
+ChowLiuTreeBuilder::ChowLiuTreeBuilder(int _wordsNo) :
+    wordsNo(_wordsNo), imagesNo(0), occurrences(_wordsNo, 0),
+    cooccurrences((size_t)_wordsNo * (size_t)(_wordsNo - 1) / 2, 0) {
+}
+
+ChowLiuTreeBuilder::~ChowLiuTreeBuilder() {
+}
+
+void ChowLiuTreeBuilder::add(const cv::Mat& imgDescriptors) {
+    CV_Assert(imgDescriptors.cols == wordsNo && imgDescriptors.type() == CV_32F);
+
+    // sparse representation of the chunk: observed words of each image and images of each word
+    std::vector<std::vector<int> > imageWords(imgDescriptors.rows);
+    std::vector<std::vector<int> > wordImages(wordsNo);
+    for (int i = 0; i < imgDescriptors.rows; i++) {
+        const float* bow = imgDescriptors.ptr<float>(i);
+        for (int word = 0; word < wordsNo; word++) {
+            if (bow[word] > 0) {
+                imageWords[i].push_back(word);
+                wordImages[word].push_back(i);
+            }
+        }
+    }
+
+    // each thread updates its own rows of the co-occurrence table
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int word1 = 0; word1 < wordsNo; word1++) {
+        occurrences[word1] += wordImages[word1].size();
+        if (wordImages[word1].empty() || word1 == wordsNo - 1)
+            continue;
+        uint32_t* row = &cooccurrences[pairIndex(word1, word1 + 1)];
+        for (size_t i = 0; i < wordImages[word1].size(); i++) {
+            const std::vector<int>& words = imageWords[wordImages[word1][i]];
+            for (std::vector<int>::const_iterator word2 = std::upper_bound(words.begin(), words.end(), word1);
+                 word2 != words.end(); word2++)
+                row[*word2 - word1 - 1]++;
+        }
+    }
+    imagesNo += imgDescriptors.rows;
+}
+
+uint64_t ChowLiuTreeBuilder::cooccurrence(int word1, int word2) const {
+    if (word1 > word2)
+        std::swap(word1, word2);
+    return cooccurrences[pairIndex(word1, word2)];
+}
+
+double ChowLiuTreeBuilder::P(int word, bool observed) const {
+    double p = (0.98 * (double)occurrences[word] / (double)imagesNo) + 0.01;
+    return observed ? p : 1 - p;
+}
+
+double ChowLiuTreeBuilder::mutualInfo(int word1, int word2) const {
+    const double imgs = (double)imagesNo;
+    const double n1 = (double)occurrences[word1];
+    const double n2 = (double)occurrences[word2];
+    const double n11 = (double)cooccurrence(word1, word2);
+
+    // joint probabilities (not smoothed, as in ChowLiuTree::JP)
+    double accumulation = 0;
+    double P00 = (imgs - n1 - n2 + n11) / imgs;
+    if (P00 > 0) accumulation += P00 * log(P00 / (P(word1, false) * P(word2, false)));
+    double P01 = (n2 - n11) / imgs;
+    if (P01 > 0) accumulation += P01 * log(P01 / (P(word1, false) * P(word2, true)));
+    double P10 = (n1 - n11) / imgs;
+    if (P10 > 0) accumulation += P10 * log(P10 / (P(word1, true) * P(word2, false)));
+    double P11 = n11 / imgs;
+    if (P11 > 0) accumulation += P11 * log(P11 / (P(word1, true) * P(word2, true)));
+    return accumulation;
+}
+
+double ChowLiuTreeBuilder::CP(int wordA, bool observedA, int wordB, bool observedB) const {
+    const double nB = (double)occurrences[wordB];
+    const double nAB = (double)cooccurrence(wordA, wordB);
+    double total = observedB ? nB : (double)imagesNo - nB;
+    double count = observedB ? nAB : (double)occurrences[wordA] - nAB;
+    if (!observedA)
+        count = total - count;
+    if (total > 0)
+        return (0.98 * count) / total + 0.01;
+    return observedA ? 0.01 : 0.99;
+}
+
+cv::Mat ChowLiuTreeBuilder::make() const {
+    CV_Assert(imagesNo > 0 && wordsNo > 1);
+
+    // Prim's algorithm, maximum spanning tree of the mutual information graph
+    std::vector<bool> inTree(wordsNo, false);
+    std::vector<double> bestInfo(wordsNo, -std::numeric_limits<double>::max());
+    std::vector<int> parent(wordsNo, 0);
+    int root = 0, last = root;
+    inTree[root] = true;
+    for (int i = 1; i < wordsNo; i++) {
+#pragma omp parallel for schedule(static)
+        for (int word = 0; word < wordsNo; word++) {
+            if (inTree[word])
+                continue;
+            double info = mutualInfo(last, word);
+            if (info > bestInfo[word]) {
+                bestInfo[word] = info;
+                parent[word] = last;
+            }
+        }
+        int next = -1;
+        for (int word = 0; word < wordsNo; word++)
+            if (!inTree[word] && (next < 0 || bestInfo[word] > bestInfo[next]))
+                next = word;
+        inTree[next] = true;
+        last = next;
+
+        // Status
+        if (wordsNo >= 10 && i % (wordsNo / 10) == 0)
+            std::cout << "." << std::flush;
+    }
+
+    cv::Mat cltree(4, wordsNo, CV_64F);
+    for (int q = 0; q < wordsNo; q++) {
+        if (q == root) {
+            //setting P(zq|zpq) to P(zq) gives the root node of the chow-liu
+            //independence from a parent node.
+            cltree.at<double>(0, q) = q;
+            cltree.at<double>(1, q) = P(q, true);
+            cltree.at<double>(2, q) = P(q, true);
+            cltree.at<double>(3, q) = P(q, true);
+            continue;
+        }
+        cltree.at<double>(0, q) = parent[q];
+        cltree.at<double>(1, q) = P(q, true);
+        cltree.at<double>(2, q) = CP(q, true, parent[q], true);
+        cltree.at<double>(3, q) = CP(q, true, parent[q], false);
+    }
+    return cltree;
+}
+
+} // namespace of2
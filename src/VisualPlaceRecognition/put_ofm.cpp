@@ -4,7 +4,7 @@
 
 #define OPENCV2P4
 
-of2::FabMap *generateFABMAPInstance(cv::FileStorage &settings)
+of2::FabMap *generateFABMAPInstance(cv::FileStorage &settings, const std::string& version)
 {
 
     cv::FileStorage fs;
@@ -57,7 +57,12 @@ of2::FabMap *generateFABMAPInstance(cv::FileStorage &settings)
     of2::FabMap *fabmap;
 
     //create an instance of the desired type of FabMap
-    std::string fabMapVersion = settings["openFabMapOptions"]["FabMapVersion"];
+    //FabMap2 (inverted index, query cost sublinear in the number of places) is the default one
+    std::string fabMapVersion = version;
+    if(fabMapVersion.empty())
+        fabMapVersion = (std::string)settings["openFabMapOptions"]["FabMapVersion"];
+    if(fabMapVersion.empty())
+        fabMapVersion = "FABMAP2";
     if(fabMapVersion == "FABMAP1") {
         fabmap = new of2::FabMap1(clTree,
                                   settings["openFabMapOptions"]["PzGe"],
@@ -87,8 +92,7 @@ of2::FabMap *generateFABMAPInstance(cv::FileStorage &settings)
                                   settings["openFabMapOptions"]["PzGne"],
                                   options);
     } else {
-        std::cerr << "Could not identify openFABMAPVersion from settings"
-                " file" << std::endl;
+        std::cerr << "Could not identify openFABMAPVersion: " << fabMapVersion << std::endl;
         return NULL;
     }
 
@@ -212,6 +216,22 @@ int openFABMAP(std::string testPath,
 }
 
 
+/*
+generates ORB detector/extractor based on options in the settings file
+*/
+cv::Ptr<cv::ORB> generateORB(cv::FileStorage &fs)
+{
+    int featuresNo = fs["FeatureOptions"]["OrbDetector"]["NumFeatures"];
+    float scaleFactor = fs["FeatureOptions"]["OrbDetector"]["ScaleFactor"];
+    int levelsNo = fs["FeatureOptions"]["OrbDetector"]["NumLevels"];
+    int fastThreshold = fs["FeatureOptions"]["OrbDetector"]["FastThreshold"];
+    return cv::ORB::create(featuresNo > 0 ? featuresNo : 500,
+                           scaleFactor > 1 ? scaleFactor : 1.2f,
+                           levelsNo > 0 ? levelsNo : 8,
+                           31, 0, 2, cv::ORB::HARRIS_SCORE, 31,
+                           fastThreshold > 0 ? fastThreshold : 20);
+}
+
 /*
 generates a feature detector based on options in the settings file
 */
@@ -297,6 +317,10 @@ cv::Ptr<cv::FeatureDetector> generateDetector(cv::FileStorage &fs) {
                     fs["FeatureOptions"]["MSERDetector"]["MinMargin"],
                     fs["FeatureOptions"]["MSERDetector"]["EdgeBlurSize"]);
 
+        } else if(detectorType == "ORB") {
+
+            detector = generateORB(fs);
+
         } else {
             std::cerr << "Could not create detector class. Specify detector "
                     "options in the settings file" << std::endl;
@@ -347,6 +371,11 @@ cv::Ptr<cv::DescriptorExtractor> generateExtractor(cv::FileStorage &fs)
 			(int)fs["FeatureOptions"]["SurfDetector"]["Upright"] > 0);
 #endif
 
+    } else if(extractorType == "ORB") {
+
+        // binary descriptors, require binary vocabulary (FilePaths/VocabularyTree)
+        extractor = generateORB(fs);
+
     } else {
         std::cerr << "Could not create Descriptor Extractor. Please specify "
                 "extractor type in settings file" << std::endl;
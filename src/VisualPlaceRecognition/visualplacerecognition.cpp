@@ -1,11 +1,12 @@
 #include "VisualPlaceRecognition/visualplacerecognition.h"
 #include "VisualPlaceRecognition/put_ofm.h"
 
-VisualPlaceRecognition::VisualPlaceRecognition(uint32_t _minFeatures, uint32_t _tailFramesToSkip, double_t _minNewPlaceProb)
+VisualPlaceRecognition::VisualPlaceRecognition(uint32_t _minFeatures, uint32_t _tailFramesToSkip, double_t _minNewPlaceProb, const std::string& fabMapVersion)
 {
 	minFeatures = _minFeatures;
 	tailFramesToSkip = _tailFramesToSkip;
 	minNewPlaceProb = _minNewPlaceProb;
+    nextImageID = 0;
 
     std::string settfilename = "../../resources/VisualPlaceRecognition/settings.yml";
     std::string vocabfilename = "../../resources/VisualPlaceRecognition/vocabulary.yml";
@@ -23,7 +24,7 @@ VisualPlaceRecognition::VisualPlaceRecognition(uint32_t _minFeatures, uint32_t _
         return;
     }
 
-    cv::Ptr<cv::DescriptorExtractor> extractor = generateExtractor(fs);
+    extractor = generateExtractor(fs);
     if(!extractor) {
         std::cerr << "Feature Extractor error" << std::endl;
         return;
@@ -32,7 +33,26 @@ VisualPlaceRecognition::VisualPlaceRecognition(uint32_t _minFeatures, uint32_t _
     std::string placeAddOption = fs["FabMapPlaceAddition"];
 //    bool addNewOnly = (placeAddOption == "NewMaximumOnly");
 
-    fabMap = generateFABMAPInstance(fs);
+    fabMap = generateFABMAPInstance(fs, fabMapVersion);
+    if(!fabMap) {
+        std::cerr << "FabMap error" << std::endl;
+        return;
+    }
+
+    // hierarchical vocabulary (optional) replaces the flat vocabulary
+    std::string vocabTreeFilename = fs["FilePaths"]["VocabularyTree"];
+    if (!vocabTreeFilename.empty()) {
+        std::cout << "Loading Vocabulary Tree" << std::endl;
+        vocabTree = new of2::VocabularyTree();
+        if (vocabTree->load(vocabTreeFilename)) {
+            // BOW vectors index the Chow Liu tree of the FabMap model
+            if (vocabTree->getWordsNo() == fabMap->vocabSize())
+                return;
+            std::cerr << vocabTreeFilename << ": vocabulary tree has " << vocabTree->getWordsNo()
+                      << " words, FabMap model has " << fabMap->vocabSize() << std::endl;
+        }
+        vocabTree.release();
+    }
 
     std::cout << "Loading Vocabulary" << std::endl;
     fs.open(vocabfilename, cv::FileStorage::READ);
@@ -48,8 +68,6 @@ VisualPlaceRecognition::VisualPlaceRecognition(uint32_t _minFeatures, uint32_t _
             cv::DescriptorMatcher::create("FlannBased");
     bide = new cv::BOWImgDescriptorExtractor(extractor, matcher);
     bide->setVocabulary(vocab);
-
-    nextImageID = 0;
 }
 
 VisualPlaceRecognition::~VisualPlaceRecognition()
@@ -79,7 +97,66 @@ std::vector<std::pair<int, double>> VisualPlaceRecognition::findAddPlace(cv::Mat
     }
 
     // extract BOW descriptor
-    bide->compute(frame, kpts, bow);
+    if (vocabTree) {
+        cv::Mat descriptors;
+        extractor->compute(frame, kpts, descriptors);
+        vocabTree->transform(descriptors, bow);
+    }
+    else
+        bide->compute(frame, kpts, bow);
+
+    return findAddPlaceBOW(bow, inputID, addFrame);
+}
+
+std::vector<std::pair<int, double>> VisualPlaceRecognition::findAddPlace(const std::vector<cv::KeyPoint>& kpts, const cv::Mat& descriptors, int32_t inputID, bool addFrame)
+{
+    std::vector<std::pair<int, double>> similarPlaces;
+
+    // bail out if insufficient number of keypoints detected
+    if(kpts.size() < minFeatures || descriptors.rows < (int)minFeatures)
+        return similarPlaces;
+
+    if (!isDescriptorCompatible(descriptors))
+    {
+        std::cerr << "Frontend descriptors (" << descriptors.cols << " cols, type " << descriptors.type() << ") do not match the vocabulary";
+        if (descriptors.type() == CV_8U && !vocabTree)
+            std::cerr << " (binary descriptors require a binary vocabulary tree, FilePaths/VocabularyTree)";
+        std::cerr << std::endl;
+        return similarPlaces;
+    }
+
+    cv::Mat bow;
+    if (vocabTree) {
+        // O(log K) word lookup in the vocabulary tree (binary descriptors are compared in Hamming space)
+        vocabTree->transform(descriptors, bow);
+        return findAddPlaceBOW(bow, inputID, addFrame);
+    }
+
+    // extract BOW descriptor (assign descriptors to words)
+    bide->compute(descriptors, bow);
+
+    return findAddPlaceBOW(bow, inputID, addFrame);
+}
+
+bool VisualPlaceRecognition::isDescriptorCompatible(const cv::Mat& descriptors) const
+{
+    if (vocabTree) {
+        // binary words (k-majority) are compared in Hamming space, float words in L2 -- the type has to be the same
+        return descriptors.type() == vocabTree->descriptorType() && descriptors.cols == vocabTree->descriptorSize();
+    }
+    if (!bide || bide->getVocabulary().empty())
+        return false;
+    // flat vocabulary is clustered with k-means (L2), bits of binary descriptors (ORB, BRIEF) converted to floats are not comparable
+    return descriptors.type() == bide->getVocabulary().type() && descriptors.cols == bide->getVocabulary().cols;
+}
+
+std::vector<std::pair<int, double>> VisualPlaceRecognition::findAddPlaceBOW(const cv::Mat& bow, int32_t inputID, bool addFrame)
+{
+    // return vector of found similar places
+    std::vector<std::pair<int, double>> similarPlaces;
+
+    if (bow.empty() || !fabMap)
+        return similarPlaces;
 
     std::vector<of2::IMatch> matches;
 
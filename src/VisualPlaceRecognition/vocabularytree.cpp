@@ -0,0 +1,408 @@
+#include "VisualPlaceRecognition/vocabularytree.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <cfloat>
+
+namespace of2 {
+
+/// binary file header
+static const char vocabularyTreeMagic[4] = {'V','T','R','E'};
+static const int vocabularyTreeVersion = 1;
+/// max size of the descriptor accepted from the vocabulary tree file
+static const int maxDescriptorSize = 65536;
+
+VocabularyTree::VocabularyTree(int _branching, int _depth) :
+    branching(_branching), depth(_depth) {
+}
+
+VocabularyTree::~VocabularyTree() {
+}
+
+float VocabularyTree::distance(const uchar* descA, const uchar* descB) const {
+    // binary descriptors (ORB, LDB) -- Hamming distance
+    if (centres.type() == CV_8U) {
+        int dist = 0;
+        int i = 0;
+        for (; i + 8 <= centres.cols; i += 8) {
+            uint64_t a, b;
+            memcpy(&a, descA + i, sizeof(a));
+            memcpy(&b, descB + i, sizeof(b));
+            dist += __builtin_popcountll(a ^ b);
+        }
+        for (; i < centres.cols; i++)
+            dist += __builtin_popcount((unsigned int)(descA[i] ^ descB[i]));
+        return (float)dist;
+    }
+    const float* a = (const float*)descA;
+    const float* b = (const float*)descB;
+    float dist = 0;
+    for (int i = 0; i < centres.cols; i++) {
+        float diff = a[i] - b[i];
+        dist += diff * diff;
+    }
+    return dist;
+}
+
+void VocabularyTree::train(const cv::Mat& _descriptors, int maxIterations) {
+    CV_Assert(!_descriptors.empty());
+    CV_Assert(branching > 1 && depth > 0);
+
+    // binary descriptors are clustered in Hamming space, the rest as floats
+    cv::Mat descriptors;
+    if (_descriptors.type() != CV_32F && _descriptors.type() != CV_8U)
+        _descriptors.convertTo(descriptors, CV_32F);
+    else
+        descriptors = _descriptors;
+
+    // Start timing
+    int64 start_time = cv::getTickCount();
+
+    nodes.clear();
+    weights.clear();
+    // centres.cols and type are used by distance()
+    centres = cv::Mat(1, descriptors.cols, descriptors.type(), cv::Scalar(0));
+
+    std::vector<cv::Mat> nodeCentres;
+    nodeCentres.push_back(centres.row(0));
+    Node root = {-1, 0, -1};
+    nodes.push_back(root);
+
+    std::vector<int> indices(descriptors.rows);
+    for (int i = 0; i < descriptors.rows; i++)
+        indices[i] = i;
+    buildNode(0, descriptors, indices, 0, maxIterations, nodeCentres);
+
+    // store centres contiguously
+    cv::Mat allCentres((int)nodeCentres.size(), descriptors.cols, descriptors.type());
+    for (size_t i = 0; i < nodeCentres.size(); i++)
+        nodeCentres[i].copyTo(allCentres.row((int)i));
+    centres = allCentres;
+
+    std::cout << "Vocabulary tree: " << weights.size() << " words, " << nodes.size() << " nodes, time: "
+              << (cv::getTickCount() - start_time) / cv::getTickFrequency() << "s" << std::endl;
+}
+
+void VocabularyTree::buildNode(int nodeId, const cv::Mat& descriptors, std::vector<int>& indices, int level, int maxIterations, std::vector<cv::Mat>& nodeCentres) {
+    cv::Mat clusterCentres;
+    std::vector<int> labels;
+    int clustersNo = 0;
+    if (level < depth && (int)indices.size() > branching)
+        clustersNo = kmeans(descriptors, indices, branching, maxIterations, clusterCentres, labels);
+
+    // leaf -- new word
+    if (clustersNo < 2) {
+        nodes[nodeId].wordId = (int)weights.size();
+        weights.push_back(1.0f);
+        return;
+    }
+
+    int firstChild = (int)nodes.size();
+    nodes[nodeId].firstChild = firstChild;
+    nodes[nodeId].childrenNo = clustersNo;
+    for (int i = 0; i < clustersNo; i++) {
+        Node child = {-1, 0, -1};
+        nodes.push_back(child);
+        nodeCentres.push_back(clusterCentres.row(i));
+    }
+
+    std::vector<std::vector<int> > childIndices(clustersNo);
+    for (size_t i = 0; i < indices.size(); i++)
+        childIndices[labels[i]].push_back(indices[i]);
+    // free memory before going deeper
+    std::vector<int>().swap(indices);
+    for (int i = 0; i < clustersNo; i++)
+        buildNode(firstChild + i, descriptors, childIndices[i], level + 1, maxIterations, nodeCentres);
+}
+
+int VocabularyTree::kmeans(const cv::Mat& descriptors, const std::vector<int>& indices, int k, int maxIterations, cv::Mat& clusterCentres, std::vector<int>& labels) const {
+    const int cols = descriptors.cols;
+    const int pointsNo = (int)indices.size();
+    std::mt19937 generator((unsigned int)pointsNo);
+
+    // k-means++ seeding
+    cv::Mat seeds(k, cols, descriptors.type());
+    std::vector<float> minDist(pointsNo, FLT_MAX);
+    int seedsNo = 0;
+    int chosen = std::uniform_int_distribution<int>(0, pointsNo - 1)(generator);
+    while (seedsNo < k) {
+        descriptors.row(indices[chosen]).copyTo(seeds.row(seedsNo));
+        const uchar* seed = seeds.ptr(seedsNo);
+        seedsNo++;
+        double distSum = 0;
+        for (int i = 0; i < pointsNo; i++) {
+            minDist[i] = std::min(minDist[i], distance(descriptors.ptr(indices[i]), seed));
+            distSum += minDist[i];
+        }
+        // all points are already centres
+        if (distSum <= 0)
+            break;
+        double threshold = std::uniform_real_distribution<double>(0, distSum)(generator);
+        chosen = pointsNo - 1;
+        for (int i = 0; i < pointsNo; i++) {
+            threshold -= minDist[i];
+            if (threshold <= 0) {
+                chosen = i;
+                break;
+            }
+        }
+    }
+    k = seedsNo;
+
+    // Lloyd iterations
+    labels.assign(pointsNo, 0);
+    clusterCentres = seeds.rowRange(0, k).clone();
+    for (int iter = 0; iter < maxIterations; iter++) {
+        int changed = 0;
+#pragma omp parallel for reduction(+:changed)
+        for (int i = 0; i < pointsNo; i++) {
+            const uchar* desc = descriptors.ptr(indices[i]);
+            int best = 0;
+            float bestDist = FLT_MAX;
+            for (int j = 0; j < k; j++) {
+                float dist = distance(desc, clusterCentres.ptr(j));
+                if (dist < bestDist) {
+                    bestDist = dist;
+                    best = j;
+                }
+            }
+            if (best != labels[i] || iter == 0)
+                changed++;
+            labels[i] = best;
+        }
+        if (changed == 0)
+            break;
+
+        // update centres
+        if (descriptors.type() == CV_8U) {
+            updateMajorityCentres(descriptors, indices, labels, k, clusterCentres);
+            continue;
+        }
+        std::vector<double> sums((size_t)k * cols, 0.0);
+        std::vector<int> counts(k, 0);
+        for (int i = 0; i < pointsNo; i++) {
+            const float* desc = descriptors.ptr<float>(indices[i]);
+            double* sum = &sums[(size_t)labels[i] * cols];
+            for (int c = 0; c < cols; c++)
+                sum[c] += desc[c];
+            counts[labels[i]]++;
+        }
+        for (int j = 0; j < k; j++) {
+            if (counts[j] == 0)
+                continue;
+            float* centre = clusterCentres.ptr<float>(j);
+            for (int c = 0; c < cols; c++)
+                centre[c] = (float)(sums[(size_t)j * cols + c] / counts[j]);
+        }
+    }
+
+    // remove empty clusters
+    std::vector<int> counts(k, 0);
+    for (int i = 0; i < pointsNo; i++)
+        counts[labels[i]]++;
+    std::vector<int> newLabel(k, -1);
+    int clustersNo = 0;
+    for (int j = 0; j < k; j++) {
+        if (counts[j] == 0)
+            continue;
+        if (clustersNo != j)
+            clusterCentres.row(j).copyTo(clusterCentres.row(clustersNo));
+        newLabel[j] = clustersNo++;
+    }
+    for (int i = 0; i < pointsNo; i++)
+        labels[i] = newLabel[labels[i]];
+    clusterCentres = clusterCentres.rowRange(0, clustersNo);
+    return clustersNo;
+}
+
+void VocabularyTree::updateMajorityCentres(const cv::Mat& descriptors, const std::vector<int>& indices, const std::vector<int>& labels, int k, cv::Mat& clusterCentres) const {
+    const int bitsNo = descriptors.cols * 8;
+    std::vector<int> bitCounts((size_t)k * bitsNo, 0);
+    std::vector<int> counts(k, 0);
+    for (size_t i = 0; i < indices.size(); i++) {
+        const uchar* desc = descriptors.ptr(indices[i]);
+        int* bitCount = &bitCounts[(size_t)labels[i] * bitsNo];
+        for (int c = 0; c < descriptors.cols; c++)
+            for (int bit = 0; bit < 8; bit++)
+                bitCount[c * 8 + bit] += (desc[c] >> (7 - bit)) & 1;
+        counts[labels[i]]++;
+    }
+    // k-majority: bit of the centre is set if it is set in more than half of the cluster members
+    for (int j = 0; j < k; j++) {
+        if (counts[j] == 0)
+            continue;
+        uchar* centre = clusterCentres.ptr(j);
+        const int* bitCount = &bitCounts[(size_t)j * bitsNo];
+        for (int c = 0; c < descriptors.cols; c++) {
+            uchar byte = 0;
+            for (int bit = 0; bit < 8; bit++)
+                if (2 * bitCount[c * 8 + bit] > counts[j])
+                    byte |= (uchar)(1 << (7 - bit));
+            centre[c] = byte;
+        }
+    }
+}
+
+void VocabularyTree::computeWeights(const cv::Mat& imageBOWs) {
+    CV_Assert(imageBOWs.cols == getWordsNo());
+    std::vector<uint64_t> occurrences(weights.size(), 0);
+    for (int i = 0; i < imageBOWs.rows; i++) {
+        const float* bow = imageBOWs.ptr<float>(i);
+        for (int j = 0; j < imageBOWs.cols; j++)
+            if (bow[j] > 0)
+                occurrences[j]++;
+    }
+    computeWeights(occurrences, (uint64_t)imageBOWs.rows);
+}
+
+void VocabularyTree::computeWeights(const std::vector<uint64_t>& occurrences, uint64_t imagesNo) {
+    CV_Assert(occurrences.size() == weights.size());
+    // idf = log(N / n_i)
+    for (size_t j = 0; j < weights.size(); j++)
+        weights[j] = (float)std::log((double)imagesNo / (double)std::max(occurrences[j], (uint64_t)1));
+}
+
+int VocabularyTree::quantize(const cv::Mat& descriptor) const {
+    CV_Assert(!nodes.empty() && descriptor.cols == centres.cols && descriptor.type() == centres.type());
+    const uchar* desc = descriptor.ptr(0);
+    int nodeId = 0;
+    while (nodes[nodeId].firstChild >= 0) {
+        const Node& node = nodes[nodeId];
+        int best = node.firstChild;
+        float bestDist = FLT_MAX;
+        for (int i = node.firstChild; i < node.firstChild + node.childrenNo; i++) {
+            float dist = distance(desc, centres.ptr(i));
+            if (dist < bestDist) {
+                bestDist = dist;
+                best = i;
+            }
+        }
+        nodeId = best;
+    }
+    return nodes[nodeId].wordId;
+}
+
+void VocabularyTree::transform(const cv::Mat& _descriptors, cv::Mat& bow, bool tfidf) const {
+    cv::Mat descriptors;
+    if (_descriptors.type() != centres.type())
+        _descriptors.convertTo(descriptors, centres.type());
+    else
+        descriptors = _descriptors;
+
+    bow = cv::Mat::zeros(1, getWordsNo(), CV_32F);
+    if (descriptors.empty())
+        return;
+    float* bowPtr = bow.ptr<float>(0);
+    for (int i = 0; i < descriptors.rows; i++)
+        bowPtr[quantize(descriptors.row(i))] += 1.0f;
+
+    float sum = 0;
+    for (int j = 0; j < bow.cols; j++) {
+        if (tfidf)
+            bowPtr[j] *= weights[j];
+        sum += bowPtr[j];
+    }
+    if (sum > 0)
+        for (int j = 0; j < bow.cols; j++)
+            bowPtr[j] /= sum;
+}
+
+cv::Mat VocabularyTree::getVocabulary() const {
+    cv::Mat vocabulary(getWordsNo(), centres.cols, centres.type());
+    for (size_t i = 0; i < nodes.size(); i++)
+        if (nodes[i].wordId >= 0)
+            centres.row((int)i).copyTo(vocabulary.row(nodes[i].wordId));
+    return vocabulary;
+}
+
+bool VocabularyTree::save(const std::string& filename) const {
+    std::ofstream file(filename.c_str(), std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << filename << ": could not write vocabulary tree" << std::endl;
+        return false;
+    }
+    int header[7] = {vocabularyTreeVersion, branching, depth, (int)nodes.size(), (int)weights.size(), centres.cols, centres.type()};
+    file.write(vocabularyTreeMagic, sizeof(vocabularyTreeMagic));
+    file.write((const char*)header, sizeof(header));
+    for (size_t i = 0; i < nodes.size(); i++) {
+        int node[3] = {nodes[i].firstChild, nodes[i].childrenNo, nodes[i].wordId};
+        file.write((const char*)node, sizeof(node));
+    }
+    for (int i = 0; i < centres.rows; i++)
+        file.write((const char*)centres.ptr(i), centres.cols * centres.elemSize());
+    if (!weights.empty())
+        file.write((const char*)&weights[0], weights.size() * sizeof(float));
+    return file.good();
+}
+
+bool VocabularyTree::load(const std::string& filename) {
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << filename << ": vocabulary tree not found" << std::endl;
+        return false;
+    }
+    char magic[4];
+    int header[7];
+    file.read(magic, sizeof(magic));
+    file.read((char*)header, sizeof(header));
+    if (!file.good() || memcmp(magic, vocabularyTreeMagic, sizeof(magic)) != 0 || header[0] != vocabularyTreeVersion) {
+        std::cerr << filename << ": wrong format of the vocabulary tree file" << std::endl;
+        return false;
+    }
+    // counts are checked against the size of the file before anything is allocated
+    const int nodesNo = header[3], wordsNo = header[4], cols = header[5], type = header[6];
+    const std::streamoff headerSize = (std::streamoff)(sizeof(magic) + sizeof(header));
+    file.seekg(0, std::ios::end);
+    const int64_t dataSize = (int64_t)(file.tellg() - headerSize);
+    file.seekg(headerSize, std::ios::beg);
+    if (header[1] < 2 || header[2] < 1 || nodesNo < 1 || wordsNo < 1 || wordsNo > nodesNo
+            || cols < 1 || cols > maxDescriptorSize || (type != CV_32F && type != CV_8U)) {
+        std::cerr << filename << ": wrong header of the vocabulary tree file" << std::endl;
+        return false;
+    }
+    const int64_t elemSize = (type == CV_8U) ? 1 : (int64_t)sizeof(float);
+    if (dataSize != (int64_t)nodesNo * (3 * (int64_t)sizeof(int) + cols * elemSize) + (int64_t)wordsNo * (int64_t)sizeof(float)) {
+        std::cerr << filename << ": size of the vocabulary tree file does not match its header" << std::endl;
+        return false;
+    }
+    branching = header[1];
+    depth = header[2];
+    nodes.resize(nodesNo);
+    weights.resize(wordsNo);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        int node[3];
+        file.read((char*)node, sizeof(node));
+        nodes[i].firstChild = node[0];
+        nodes[i].childrenNo = node[1];
+        nodes[i].wordId = node[2];
+    }
+    centres.create(nodesNo, cols, type);
+    for (int i = 0; i < centres.rows; i++)
+        file.read((char*)centres.ptr(i), centres.cols * centres.elemSize());
+    file.read((char*)&weights[0], weights.size() * sizeof(float));
+    if (!file.good()) {
+        std::cerr << filename << ": vocabulary tree file is truncated" << std::endl;
+        nodes.clear();
+        weights.clear();
+        return false;
+    }
+    // children are stored after the parent, leaves point to existing words
+    for (int i = 0; i < nodesNo; i++) {
+        const Node& node = nodes[i];
+        bool valid = (node.firstChild >= 0) ? (node.firstChild > i && node.childrenNo > 0 && node.childrenNo <= nodesNo - node.firstChild)
+                : (node.wordId >= 0 && node.wordId < wordsNo);
+        if (!valid) {
+            std::cerr << filename << ": wrong node " << i << " in the vocabulary tree file" << std::endl;
+            nodes.clear();
+            weights.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace of2
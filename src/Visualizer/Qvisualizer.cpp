@@ -4,6 +4,8 @@
 #include <cmath>
 #include <stdexcept>
 #include <chrono>
+#include <unordered_map>
+#include <algorithm>
 #include <GL/glut.h>
 
 using namespace putslam;
@@ -11,6 +13,86 @@ using namespace putslam;
 /// A single instance of Visualizer
 QGLVisualizer::Ptr visualizer;
 
+/// OpenGL entry points above 1.1 resolved by Qt in the context of the viewer
+/// vertex buffer objects (OpenGL 1.5), shaders (OpenGL 2.0) and instanced arrays (OpenGL 3.3 or ARB extensions)
+class GLFunctions
+{
+public:
+    /// buffers can be used
+    bool buffers;
+    /// instanced drawing with shaders can be used
+    bool instancing;
+
+    PFNGLGENBUFFERSPROC glGenBuffers;
+    PFNGLDELETEBUFFERSPROC glDeleteBuffers;
+    PFNGLBINDBUFFERPROC glBindBuffer;
+    PFNGLBUFFERDATAPROC glBufferData;
+    PFNGLBUFFERSUBDATAPROC glBufferSubData;
+
+    PFNGLCREATEPROGRAMPROC glCreateProgram;
+    PFNGLCREATESHADERPROC glCreateShader;
+    PFNGLSHADERSOURCEPROC glShaderSource;
+    PFNGLCOMPILESHADERPROC glCompileShader;
+    PFNGLGETSHADERIVPROC glGetShaderiv;
+    PFNGLGETSHADERINFOLOGPROC glGetShaderInfoLog;
+    PFNGLATTACHSHADERPROC glAttachShader;
+    PFNGLDELETESHADERPROC glDeleteShader;
+    PFNGLBINDATTRIBLOCATIONPROC glBindAttribLocation;
+    PFNGLLINKPROGRAMPROC glLinkProgram;
+    PFNGLGETPROGRAMIVPROC glGetProgramiv;
+    PFNGLDELETEPROGRAMPROC glDeleteProgram;
+    PFNGLUSEPROGRAMPROC glUseProgram;
+    PFNGLGETUNIFORMLOCATIONPROC glGetUniformLocation;
+    PFNGLUNIFORM1IPROC glUniform1i;
+    PFNGLENABLEVERTEXATTRIBARRAYPROC glEnableVertexAttribArray;
+    PFNGLDISABLEVERTEXATTRIBARRAYPROC glDisableVertexAttribArray;
+    PFNGLVERTEXATTRIBPOINTERPROC glVertexAttribPointer;
+    PFNGLVERTEXATTRIBDIVISORPROC glVertexAttribDivisor;
+    PFNGLDRAWELEMENTSINSTANCEDPROC glDrawElementsInstanced;
+
+    GLFunctions() : buffers(false), instancing(false) {
+    }
+
+    /// resolve functions (the context of the viewer has to be current)
+    void init(void)
+    {
+        buffers = resolve(glGenBuffers, "glGenBuffers") & resolve(glDeleteBuffers, "glDeleteBuffers")
+                & resolve(glBindBuffer, "glBindBuffer") & resolve(glBufferData, "glBufferData")
+                & resolve(glBufferSubData, "glBufferSubData");
+        instancing = buffers & resolve(glCreateProgram, "glCreateProgram") & resolve(glCreateShader, "glCreateShader")
+                & resolve(glShaderSource, "glShaderSource") & resolve(glCompileShader, "glCompileShader")
+                & resolve(glGetShaderiv, "glGetShaderiv") & resolve(glGetShaderInfoLog, "glGetShaderInfoLog")
+                & resolve(glAttachShader, "glAttachShader") & resolve(glDeleteShader, "glDeleteShader")
+                & resolve(glBindAttribLocation, "glBindAttribLocation") & resolve(glLinkProgram, "glLinkProgram")
+                & resolve(glGetProgramiv, "glGetProgramiv") & resolve(glDeleteProgram, "glDeleteProgram")
+                & resolve(glUseProgram, "glUseProgram") & resolve(glGetUniformLocation, "glGetUniformLocation")
+                & resolve(glUniform1i, "glUniform1i") & resolve(glEnableVertexAttribArray, "glEnableVertexAttribArray")
+                & resolve(glDisableVertexAttribArray, "glDisableVertexAttribArray")
+                & resolve(glVertexAttribPointer, "glVertexAttribPointer")
+                & resolve(glVertexAttribDivisor, "glVertexAttribDivisor", "glVertexAttribDivisorARB")
+                & resolve(glDrawElementsInstanced, "glDrawElementsInstanced", "glDrawElementsInstancedARB");
+    }
+
+private:
+    /// resolve function (or its ARB version)
+    template <typename Function>
+    static bool resolve(Function& function, const char* name, const char* nameARB = nullptr)
+    {
+        const QGLContext* context = QGLContext::currentContext();
+        function = (context) ? reinterpret_cast<Function>(context->getProcAddress(QString(name))) : nullptr;
+        if (!function && context && nameARB)
+            function = reinterpret_cast<Function>(context->getProcAddress(QString(nameARB)));
+        return function != nullptr;
+    }
+};
+
+/// OpenGL functions of the viewer
+static GLFunctions gl;
+
+/// first vertex attribute of the instance transformation (x, y, z columns and position)
+/// attributes 0, 2 and 3 alias gl_Vertex, gl_Normal and gl_Color on some drivers, 8-11 (texture coordinates) are not used
+static const GLuint instanceAttrib = 8;
+
 class SolidSphere
 {
 protected:
@@ -18,9 +100,11 @@ protected:
     std::vector<GLfloat> normals;
     std::vector<GLfloat> texcoords;
     std::vector<GLushort> indices;
+    /// vertex and index buffers
+    GLuint vbo, ibo;
 
 public:
-    SolidSphere(float radius, unsigned int rings, unsigned int sectors)
+    SolidSphere(float radius, unsigned int rings, unsigned int sectors) : vbo(0), ibo(0)
     {
         float const R = 1.0f/(float)(rings-1);
         float const S = 1.0f/(float)(sectors-1);
@@ -50,7 +134,7 @@ public:
                 *n++ = (float) z;
         }
 
-        indices.resize(rings * sectors * 4);
+        indices.resize((rings-1) * (sectors-1) * 4);
         std::vector<GLushort>::iterator i = indices.begin();
         for(r = 0; r < rings-1; r++)
         	for(s = 0; s < sectors-1; s++) {
@@ -61,34 +145,67 @@ public:
         }
     }
 
-    void draw(GLfloat x, GLfloat y, GLfloat z)
+    ~SolidSphere()
     {
-        glMatrixMode(GL_MODELVIEW);
-        glPushMatrix();
-        glTranslatef(x,y,z);
-        glEnable(GL_NORMALIZE);
+        if (vbo){
+            gl.glDeleteBuffers(1, &vbo);
+            gl.glDeleteBuffers(1, &ibo);
+        }
+    }
 
+    /// draw instances of the sphere (instance -- x, y, z columns of rotation/scale and position, 12 floats)
+    void drawInstanced(GLuint instanceVbo, GLsizei instancesNo)
+    {
+        if (!vbo){
+            gl.glGenBuffers(1, &vbo);
+            // vertices followed by normals
+            gl.glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            gl.glBufferData(GL_ARRAY_BUFFER, (vertices.size()+normals.size())*sizeof(GLfloat), nullptr, GL_STATIC_DRAW);
+            gl.glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size()*sizeof(GLfloat), vertices.data());
+            gl.glBufferSubData(GL_ARRAY_BUFFER, vertices.size()*sizeof(GLfloat), normals.size()*sizeof(GLfloat), normals.data());
+            gl.glGenBuffers(1, &ibo);
+            gl.glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+            gl.glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size()*sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
+        }
+        glDisableClientState(GL_COLOR_ARRAY);
         glEnableClientState(GL_VERTEX_ARRAY);
         glEnableClientState(GL_NORMAL_ARRAY);
-
-        glVertexPointer(3, GL_FLOAT, 0, &vertices[0]);
-        glNormalPointer(GL_FLOAT, 0, &normals[0]);
-        glDrawElements(GL_QUADS, (int) indices.size(), GL_UNSIGNED_SHORT, &indices[0]);
-        glPopMatrix();
+        gl.glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glVertexPointer(3, GL_FLOAT, 0, (const GLvoid*)0);
+        glNormalPointer(GL_FLOAT, 0, (const GLvoid*)(vertices.size()*sizeof(GLfloat)));
+        gl.glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+        for (GLuint i = 0; i < 4; i++){
+            gl.glEnableVertexAttribArray(instanceAttrib + i);
+            gl.glVertexAttribPointer(instanceAttrib + i, 3, GL_FLOAT, GL_FALSE, 12*sizeof(GLfloat), (const GLvoid*)(3*i*sizeof(GLfloat)));
+            gl.glVertexAttribDivisor(instanceAttrib + i, 1);
+        }
+        gl.glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+        gl.glDrawElementsInstanced(GL_QUADS, (GLsizei) indices.size(), GL_UNSIGNED_SHORT, (const GLvoid*)0, instancesNo);
+        for (GLuint i = 0; i < 4; i++){
+            gl.glVertexAttribDivisor(instanceAttrib + i, 0);
+            gl.glDisableVertexAttribArray(instanceAttrib + i);
+        }
+        gl.glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        gl.glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glDisableClientState(GL_NORMAL_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
     }
 };
 
-QGLVisualizer::QGLVisualizer(void) {
+QGLVisualizer::QGLVisualizer(void) : instancingProgram(0), featureInstances(12), trajectoryInstances(12),
+        ellipsoidInstances(12), links(6) {
 }
 
 /// Construction
-QGLVisualizer::QGLVisualizer(Config _config): config(_config){
+QGLVisualizer::QGLVisualizer(Config _config): config(_config), instancingProgram(0), featureInstances(12),
+        trajectoryInstances(12), ellipsoidInstances(12), links(6) {
 
 }
 
 /// Construction
 QGLVisualizer::QGLVisualizer(std::string configFile) :
-        config(configFile) {
+        config(configFile), instancingProgram(0), featureInstances(12), trajectoryInstances(12),
+        ellipsoidInstances(12), links(6) {
     tinyxml2::XMLDocument configXML;
     std::string filename = "../../resources/" + configFile;
     configXML.LoadFile(filename.c_str());
@@ -98,38 +215,206 @@ QGLVisualizer::QGLVisualizer(std::string configFile) :
 
 /// Destruction
 QGLVisualizer::~QGLVisualizer(void) {
+    makeCurrent();
+    mtxPointClouds.lock();
+    for (auto& cloud : pointClouds)
+        gl.glDeleteBuffers(1, &cloud.vbo);
+    pointClouds.clear();
+    mtxPointClouds.unlock();
+    for (DynamicBuffer* buffer : {&featureInstances, &trajectoryInstances, &ellipsoidInstances, &links}){
+        if (buffer->vbo)
+            gl.glDeleteBuffers(1, &buffer->vbo);
+    }
+    unitSphere.reset();
+    if (instancingProgram)
+        gl.glDeleteProgram(instancingProgram);
 }
 
-/// Draw ellipsoid
-void QGLVisualizer::drawEllipsoid(unsigned int uiStacks, unsigned int uiSlices, double fA, double fB, double fC) const {
-    float tStep = (float)(M_PI) / (float)uiSlices;
-    float sStep = (float)(M_PI) / (float)uiStacks;
-    //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    glPolygonMode(GL_FRONT_AND_BACK,GL_COLOR);
-    for(double t = -M_PI/2.0; t <= (M_PI/2.0f)+.0001f; t += tStep) {
-        glBegin(GL_TRIANGLE_STRIP);
-        for(double s = -M_PI; s <= M_PI+.0001f; s += sStep) {
-            glVertex3d((fA * cos(t) * cos(s)), (fB * cos(t) * sin(s)), (fC * sin(t)));
-            double norm = sqrt(pow(fA * cos(t) * cos(s),2.0)+pow(fB * cos(t) * sin(s),2.0) + pow(fC * sin(t),2.0));
-            glNormal3d((fA * cos(t) * cos(s))/norm, (fB * cos(t) * sin(s))/norm, (fC * sin(t))/norm);
-            glVertex3d(fA * cos(t+tStep) * cos(s), fB * cos(t+tStep) * sin(s), fC * sin(t+tStep));
-            norm = sqrt(pow(fA * cos(t+tStep) * cos(s),2.0)+pow(fB * cos(t+tStep) * sin(s),2.0) + pow(fC * sin(t+tStep),2.0));
-            glNormal3d((fA * cos(t+tStep) * cos(s))/norm, (fB * cos(t+tStep) * sin(s))/norm, (fC * sin(t+tStep))/norm);
+/// set element (idx == size() appends the element)
+void QGLVisualizer::DynamicBuffer::set(size_t idx, const GLfloat* values){
+    if (idx >= size())
+        data.resize((idx+1)*elementSize);
+    std::copy(values, values + elementSize, data.begin() + idx*elementSize);
+    if (dirtyBegin == dirtyEnd){
+        dirtyBegin = idx; dirtyEnd = idx + 1;
+    }
+    else {
+        dirtyBegin = std::min(dirtyBegin, idx); dirtyEnd = std::max(dirtyEnd, idx + 1);
+    }
+}
+
+/// upload modified elements
+void QGLVisualizer::DynamicBuffer::upload(void){
+    if (!vbo)
+        gl.glGenBuffers(1, &vbo);
+    gl.glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    if (size() > capacity){
+        // buffer is reallocated with twice the size -- appending is amortized
+        capacity = 2*size();
+        gl.glBufferData(GL_ARRAY_BUFFER, capacity*elementSize*sizeof(GLfloat), nullptr, GL_DYNAMIC_DRAW);
+        dirtyBegin = 0; dirtyEnd = size();
+    }
+    if (dirtyEnd > dirtyBegin)
+        gl.glBufferSubData(GL_ARRAY_BUFFER, dirtyBegin*elementSize*sizeof(GLfloat),
+                (dirtyEnd-dirtyBegin)*elementSize*sizeof(GLfloat), &data[dirtyBegin*elementSize]);
+    dirtyBegin = dirtyEnd = 0;
+    gl.glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/// voxel grid filter -- mean position and color of points in the voxel (interleaved x,y,z,r,g,b)
+static void downsampleCloud(const std::vector<GLfloat>& cloud, double voxelSize, std::vector<GLfloat>& cloudDown){
+    std::unordered_map<int64_t, std::pair<size_t, int>> voxels; // voxel -> (index, points no)
+    cloudDown.clear();
+    for (size_t i = 0; i < cloud.size(); i += 6){
+        int64_t x = (int64_t) std::floor(cloud[i] / voxelSize);
+        int64_t y = (int64_t) std::floor(cloud[i+1] / voxelSize);
+        int64_t z = (int64_t) std::floor(cloud[i+2] / voxelSize);
+        int64_t key = ((x & 0x1FFFFF) << 42) | ((y & 0x1FFFFF) << 21) | (z & 0x1FFFFF);
+        auto voxel = voxels.find(key);
+        if (voxel == voxels.end()){
+            voxels[key] = std::make_pair(cloudDown.size(), 1);
+            cloudDown.insert(cloudDown.end(), cloud.begin() + i, cloud.begin() + i + 6);
         }
-        glEnd();
+        else {
+            for (size_t j = 0; j < 6; j++)
+                cloudDown[voxel->second.first + j] += cloud[i + j];
+            voxel->second.second++;
+        }
+    }
+    for (auto& voxel : voxels){
+        for (size_t j = 0; j < 6; j++)
+            cloudDown[voxel.second.first + j] /= (GLfloat) voxel.second.second;
     }
 }
 
-/// Draw ellipsoid
-void QGLVisualizer::drawEllipsoid(const Vec3& pos, const Mat33& covariance) const{
-    Eigen::SelfAdjointEigenSolver<Mat33> es;
-    es.compute(covariance);
-    Mat33 V(es.eigenvectors());
-    double GLmat[16]={V(0,0), V(1,0), V(2,0), 0, V(0,1), V(1,1), V(2,1), 0, V(0,2), V(1,2), V(2,2), 0, pos.x(), pos.y(), pos.z(), 1};
-    glPushMatrix();
-        glMultMatrixd(GLmat);
-        drawEllipsoid(10,10,sqrt(es.eigenvalues()(0))*config.ellipsoidScale, sqrt(es.eigenvalues()(1))*config.ellipsoidScale, sqrt(es.eigenvalues()(2))*config.ellipsoidScale);
-    glPopMatrix();
+/// Create shader program for instanced drawing (per-vertex lighting of GL_LIGHT0 as in the fixed-function pipeline,
+/// color material -- ambient and diffuse from the current color)
+GLuint QGLVisualizer::createInstancingProgram(void) const{
+    const char* vertexShader =
+        "#version 120\n"
+        "attribute vec3 instanceX;\n"
+        "attribute vec3 instanceY;\n"
+        "attribute vec3 instanceZ;\n"
+        "attribute vec3 instancePos;\n"
+        "uniform bool lighting;\n"
+        "void main(){\n"
+        "    vec3 pos = instanceX*gl_Vertex.x + instanceY*gl_Vertex.y + instanceZ*gl_Vertex.z + instancePos;\n"
+        "    vec4 eyePos = gl_ModelViewMatrix*vec4(pos, 1.0);\n"
+        "    gl_Position = gl_ProjectionMatrix*eyePos;\n"
+        "    if (!lighting)\n"
+        "        gl_FrontColor = gl_Color;\n"
+        "    else {\n"
+        "        // normals are transformed by the inverse transpose of the instance matrix (cofactors, normalized)\n"
+        "        vec3 normal = cross(instanceY, instanceZ)*gl_Normal.x + cross(instanceZ, instanceX)*gl_Normal.y + cross(instanceX, instanceY)*gl_Normal.z;\n"
+        "        if (dot(instanceX, cross(instanceY, instanceZ)) < 0.0)\n"
+        "            normal = -normal;\n"
+        "        normal = normalize(gl_NormalMatrix*normal);\n"
+        "        vec3 lightDir = normalize(gl_LightSource[0].position.xyz - eyePos.xyz*gl_LightSource[0].position.w);\n"
+        "        float diffuse = max(dot(normal, lightDir), 0.0);\n"
+        "        vec4 color = gl_FrontMaterial.emission + gl_LightModel.ambient*gl_Color\n"
+        "            + gl_LightSource[0].ambient*gl_Color + diffuse*gl_LightSource[0].diffuse*gl_Color;\n"
+        "        if (diffuse > 0.0){\n"
+        "            vec3 halfVector = normalize(lightDir + vec3(0.0, 0.0, 1.0));\n"
+        "            color += pow(max(dot(normal, halfVector), 0.0), gl_FrontMaterial.shininess)*gl_FrontMaterial.specular*gl_LightSource[0].specular;\n"
+        "        }\n"
+        "        gl_FrontColor = vec4(clamp(color.rgb, 0.0, 1.0), gl_Color.a);\n"
+        "    }\n"
+        "}\n";
+    const char* fragmentShader =
+        "#version 120\n"
+        "void main(){\n"
+        "    gl_FragColor = gl_Color;\n"
+        "}\n";
+    GLuint program = gl.glCreateProgram();
+    const char* sources[2] = {vertexShader, fragmentShader};
+    GLenum types[2] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+    for (int i = 0; i < 2; i++){
+        GLuint shader = gl.glCreateShader(types[i]);
+        gl.glShaderSource(shader, 1, &sources[i], nullptr);
+        gl.glCompileShader(shader);
+        GLint status;
+        gl.glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+        if (!status){
+            char log[1024];
+            gl.glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+            std::cout << "Visualizer: unable to compile shader: " << log << "\n";
+        }
+        gl.glAttachShader(program, shader);
+        gl.glDeleteShader(shader);
+    }
+    const char* attribs[4] = {"instanceX", "instanceY", "instanceZ", "instancePos"};
+    for (GLuint i = 0; i < 4; i++)
+        gl.glBindAttribLocation(program, instanceAttrib + i, attribs[i]);
+    gl.glLinkProgram(program);
+    GLint status;
+    gl.glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (!status){
+        std::cout << "Visualizer: unable to link shader program, instances will not be drawn\n";
+        gl.glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+/// Draw unit sphere instances
+void QGLVisualizer::drawInstances(DynamicBuffer& instances){
+    if (!instancingProgram || instances.size() == 0)
+        return;
+    instances.upload();
+    gl.glUseProgram(instancingProgram);
+    gl.glUniform1i(gl.glGetUniformLocation(instancingProgram, "lighting"), glIsEnabled(GL_LIGHTING));
+    unitSphere->drawInstanced(instances.vbo, (GLsizei)instances.size());
+    gl.glUseProgram(0);
+}
+
+/// Set transformation of the instance of the unit sphere
+void QGLVisualizer::setInstance(DynamicBuffer& instances, size_t idx, const Mat33& transform, const Eigen::Vector3d& position){
+    GLfloat instance[12];
+    for (int col = 0; col < 3; col++)
+        for (int row = 0; row < 3; row++)
+            instance[3*col + row] = (GLfloat) transform(row, col);
+    for (int row = 0; row < 3; row++)
+        instance[9 + row] = (GLfloat) position(row);
+    instances.set(idx, instance);
+}
+
+/// Set ellipsoid instance of the measurement
+void QGLVisualizer::setEllipsoid(size_t idx){
+    const Edge3D& measurement = measurements[idx];
+    Mat34 camPose(Mat34::Identity());
+    if (camTrajectory.size() > measurement.fromVertexId)
+        camPose = camTrajectory[measurement.fromVertexId].pose;
+    // unit sphere scaled by the standard deviations along the principal axes
+    Eigen::SelfAdjointEigenSolver<Mat33> es(measurement.info.inverse());
+    Mat33 shape = es.eigenvectors() * (es.eigenvalues().cwiseMax(0).cwiseSqrt()*config.ellipsoidScale).asDiagonal();
+    setInstance(ellipsoidInstances, idx, camPose.rotation()*shape, camPose*measurement.trans.vector());
+}
+
+/// Set vertices of the pose to feature link
+void QGLVisualizer::setLink(size_t idx){
+    Eigen::Vector3d feature(featuresMap[linksIds[idx].second].position.vector());
+    Eigen::Vector3d pose(feature);
+    if (camTrajectory.size() > (size_t)linksIds[idx].first)
+        pose = camTrajectory[linksIds[idx].first].pose.translation();
+    GLfloat link[6] = {(GLfloat)pose.x(), (GLfloat)pose.y(), (GLfloat)pose.z(),
+                       (GLfloat)feature.x(), (GLfloat)feature.y(), (GLfloat)feature.z()};
+    links.set(idx, link);
+}
+
+/// Update instances and links after the pose was added or moved
+void QGLVisualizer::updatePoseInstances(int poseId){
+    setInstance(trajectoryInstances, poseId, Mat33::Identity()*config.trajectoryPointsSize,
+            camTrajectory[poseId].pose.translation());
+    auto poseLink = poseLinks.find(poseId);
+    if (poseLink != poseLinks.end()){
+        for (size_t link : poseLink->second)
+            setLink(link);
+    }
+    auto poseEllipsoid = poseEllipsoids.find(poseId);
+    if (poseEllipsoid != poseEllipsoids.end()){
+        for (size_t ellipsoid : poseEllipsoid->second)
+            setEllipsoid(ellipsoid);
+    }
 }
 
 /// Observer update
@@ -179,7 +464,8 @@ void QGLVisualizer::update(MapModifier& mapModifier) {
 
 /// Observer update
 void QGLVisualizer::update(const cv::Mat& color, const cv::Mat& depth, int frameNo){
-    //pointClouds.push_back(std::make_pair(frameNo, cloud));
+    if (!config.drawPointClouds)
+        return;
     mtxImages.lock();
     colorImagesBuff.push_back(color);
     depthImagesBuff.push_back(depth);
@@ -188,143 +474,144 @@ void QGLVisualizer::update(const cv::Mat& color, const cv::Mat& depth, int frame
 }
 
 /// Observer update
-void QGLVisualizer::update(std::vector<Edge>& features){
+void QGLVisualizer::update(std::vector<Edge3D>& features){
+    if (!config.drawMeasurements)
+        return;
     mtxMeasurementsBuff.lock();
-    mtxMeasurements.lock();
-
-    for (Edge &e : features) {
-    	Edge *pE = &e;
-    	Edge3D* e3D = dynamic_cast<Edge3D*>(pE);
-    	if (e3D)
-    		measurementsBuff.push_back(*e3D);
-    }
-
-    //measurementsBuff.insert(measurementsBuff.end(), features.begin(), features.end());
-    mtxMeasurements.unlock();
+    measurementsBuff.insert(measurementsBuff.end(), features.begin(), features.end());
     mtxMeasurementsBuff.unlock();
 }
 
 /// Draw point clouds
 void QGLVisualizer::drawPointClouds(void){
+    qglviewer::Vec viewerPos = camera()->position();
+    Eigen::Vector3f viewer((float)viewerPos.x, (float)viewerPos.y, (float)viewerPos.z);
+    glPointSize((float)config.cloudPointSize);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
     mtxPointClouds.lock();
-    for (size_t i = 0;i<pointClouds.size();i++){
-        mtxCamTrajectory.lock();
-        if (camTrajectory.size()>(size_t)imagesIds[i]){
-            Mat34 camPose = camTrajectory[imagesIds[i]].pose;
-            mtxCamTrajectory.unlock();
-            double GLmat[16]={camPose(0,0), camPose(1,0), camPose(2,0), camPose(3,0), camPose(0,1), camPose(1,1), camPose(2,1), camPose(3,1), camPose(0,2), camPose(1,2), camPose(2,2), camPose(3,2), camPose(0,3), camPose(1,3), camPose(2,3), camPose(3,3)};
-            glPushMatrix();
-                glMultMatrixd(GLmat);
-                glPointSize((float)config.cloudPointSize);
-                glCallList(cloudsList[i]);
-            glPopMatrix();
-        }
+    for (auto& cloud : pointClouds){
+        if (posesSnapshot.size()<=(size_t)cloud.poseId)
+            continue;
+        const Mat34& camPose = posesSnapshot[cloud.poseId];
+        // level of detail -- voxel size is doubled every doubled distance from the viewer
+        double dist = (camPose.cast<float>()*cloud.centroid - viewer).norm();
+        size_t level = 0;
+        for (double range = config.cloudLODDistance; dist>range && level+1<cloud.levels.size(); range *= 2.0)
+            level++;
+        GLfloat GLmat[16]={(GLfloat)camPose(0,0), (GLfloat)camPose(1,0), (GLfloat)camPose(2,0), 0, (GLfloat)camPose(0,1), (GLfloat)camPose(1,1), (GLfloat)camPose(2,1), 0, (GLfloat)camPose(0,2), (GLfloat)camPose(1,2), (GLfloat)camPose(2,2), 0, (GLfloat)camPose(0,3), (GLfloat)camPose(1,3), (GLfloat)camPose(2,3), 1};
+        glPushMatrix();
+            glMultMatrixf(GLmat);
+            gl.glBindBuffer(GL_ARRAY_BUFFER, cloud.vbo);
+            glVertexPointer(3, GL_FLOAT, 6*sizeof(GLfloat), (const GLvoid*)0);
+            glColorPointer(3, GL_FLOAT, 6*sizeof(GLfloat), (const GLvoid*)(3*sizeof(GLfloat)));
+            glDrawArrays(GL_POINTS, cloud.levels[level].first, cloud.levels[level].second);
+        glPopMatrix();
     }
     mtxPointClouds.unlock();
+    gl.glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
 }
 
-/// Create point cloud List
-GLuint QGLVisualizer::createCloudList(const std::pair<int,PointCloud>& pointCloud){
-    // create one display list
-    GLuint index = glGenLists(1);
+/// Downsample point cloud and upload it to the GPU
+QGLVisualizer::CloudBuffer QGLVisualizer::createCloudBuffer(int poseId, const PointCloud& pointCloud) const{
+    CloudBuffer cloud;
+    cloud.poseId = poseId;
+    std::vector<GLfloat> points;
+    points.reserve(pointCloud.size()*6);
+    for (auto& point : pointCloud){
+        points.push_back((GLfloat)point.x); points.push_back((GLfloat)point.y); points.push_back((GLfloat)point.z);
+        points.push_back((GLfloat)(point.r/255.0)); points.push_back((GLfloat)(point.g/255.0)); points.push_back((GLfloat)(point.b/255.0));
+    }
+    // levels of detail stored one after another in the single buffer
+    std::vector<GLfloat> vertices, level;
+    if (config.cloudVoxelSize>0)
+        downsampleCloud(points, config.cloudVoxelSize, vertices);
+    else
+        vertices.swap(points);
+    cloud.levels.push_back(std::make_pair(0, (GLsizei)(vertices.size()/6)));
+    cloud.centroid = Eigen::Vector3f::Zero();
+    for (size_t i = 0; i < vertices.size(); i += 6)
+        cloud.centroid += Eigen::Vector3f(vertices[i], vertices[i+1], vertices[i+2]);
+    if (vertices.size()>0)
+        cloud.centroid /= (float)(vertices.size()/6);
+    double voxelSize = config.cloudVoxelSize;
+    for (int levelNo = 1; levelNo < config.cloudLODLevels && config.cloudVoxelSize > 0; levelNo++){
+        voxelSize *= 2.0;
+        std::vector<GLfloat> prevLevel(vertices.begin() + cloud.levels.back().first*6, vertices.end());
+        downsampleCloud(prevLevel, voxelSize, level);
+        cloud.levels.push_back(std::make_pair((GLint)(vertices.size()/6), (GLsizei)(level.size()/6)));
+        vertices.insert(vertices.end(), level.begin(), level.end());
+    }
 
-    // compile the display list, store a triangle in it
-    glNewList(index, GL_COMPILE);
-        glBegin(GL_POINTS);
-        for (size_t n = 0; n < pointCloud.second.size(); n++){
-            glColor3ub((unsigned char)pointCloud.second[n].r, (unsigned char)pointCloud.second[n].g, (unsigned char)pointCloud.second[n].b);
-            glVertex3d(pointCloud.second[n].x, pointCloud.second[n].y, pointCloud.second[n].z);
-        }
-        glEnd();
-    glEndList();
-    return index;
+    gl.glGenBuffers(1, &cloud.vbo);
+    gl.glBindBuffer(GL_ARRAY_BUFFER, cloud.vbo);
+    gl.glBufferData(GL_ARRAY_BUFFER, vertices.size()*sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+    gl.glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return cloud;
 }
 
 /// draw objects
 void QGLVisualizer::draw(){
     // Here we are in the world coordinate system. Draw unit size axis.
     drawAxis();
-    if (config.drawPointClouds){
+    // camera poses are copied once per frame
+    mtxCamTrajectory.lock();
+    posesSnapshot.resize(camTrajectory.size());
+    for (size_t i = 0;i<camTrajectory.size();i++)
+        posesSnapshot[i] = camTrajectory[i].pose;
+    mtxCamTrajectory.unlock();
+    if (config.drawPointClouds && gl.buffers){
         drawPointClouds();
     }
     if (config.drawTrajectory){
         glLineWidth((float)config.trajectoryWidth);
         glColor4f((float)config.trajectoryColor.red(), (float)config.trajectoryColor.green(), (float)config.trajectoryColor.blue(), (float)config.trajectoryColor.alpha());
         glBegin(GL_LINE_STRIP);
-        mtxCamTrajectory.lock();
-        for (auto it=camTrajectory.begin();it!=camTrajectory.end();it++){
-            glVertex3d(it->pose(0,3), it->pose(1,3), it->pose(2,3));
+        for (auto it=posesSnapshot.begin();it!=posesSnapshot.end();it++){
+            glVertex3d((*it)(0,3), (*it)(1,3), (*it)(2,3));
         }
-        mtxCamTrajectory.unlock();
         glEnd();
     }
-    SolidSphere sphereTraj((float)config.trajectoryPointsSize, config.featuresSmoothness, config.featuresSmoothness);
+    // features, trajectory points and ellipsoids -- instances of the unit sphere updated in updateMap
     if (config.drawTrajectoryPoints){
         glColor4f((float)config.trajectoryPointsColor.red(), (float)config.trajectoryPointsColor.green(), (float)config.trajectoryPointsColor.blue(), (float)config.trajectoryPointsColor.alpha());
-        mtxCamTrajectory.lock();
-        for (auto it=camTrajectory.begin();it!=camTrajectory.end();it++){
-            //glPushMatrix();
-                sphereTraj.draw((float)it->pose(0,3), (float)it->pose(1,3), (float)it->pose(2,3));
-              //  glTranslated(it->pose(0,3), it->pose(1,3), it->pose(2,3));
-                //solidSphere(config.trajectoryPointsSize, 10, 10);
-                //glutSolidSphere(config.trajectoryPointsSize,6,6);
-            //glPopMatrix();
-        }
-        mtxCamTrajectory.unlock();
-        glEnd();
+        drawInstances(trajectoryInstances);
     }
-    SolidSphere sphereFeature((float)config.featuresSize, config.featuresSmoothness, config.featuresSmoothness);
     if (config.drawFeatures){
         glColor4f((float)config.featuresColor.red(), (float)config.featuresColor.green(), (float)config.featuresColor.blue(), (float)config.featuresColor.alpha());
-        mtxFeaturesMap.lock();
-        for (auto it=featuresMap.begin();it!=featuresMap.end();it++){
-            //glPushMatrix();
-                sphereFeature.draw((float)it->second.position.x(), (float)it->second.position.y(), (float)it->second.position.z());
-                //glTranslated(it->second.position.x(), it->second.position.y(), it->second.position.z());
-                //solidSphere(config.featuresSize, 10, 10);
-                //glutSolidSphere(config.featuresSize,6,6);
-            //glPopMatrix();
-        }
-        mtxFeaturesMap.unlock();
-        glEnd();
+        drawInstances(featureInstances);
     }
-    if (config.drawPose2Feature){
+    if (config.drawPose2Feature && links.size()>0 && gl.buffers){
         glLineWidth((float)config.pose2FeatureWidth);
         glColor4f((float)config.pose2FeatureColor.red(), (float)config.pose2FeatureColor.green(), (float)config.pose2FeatureColor.blue(), (float)config.pose2FeatureColor.alpha());
-        glBegin(GL_LINES);
-        mtxCamTrajectory.lock();
-        mtxFeaturesMap.lock();
-        for (auto it=featuresMap.begin();it!=featuresMap.end();it++){
-            for (auto itPose=it->second.posesIds.begin();itPose!=it->second.posesIds.end();itPose++){
-                glVertex3d(camTrajectory[*itPose].pose(0,3), camTrajectory[*itPose].pose(1,3), camTrajectory[*itPose].pose(2,3));
-                glVertex3d(it->second.position.x(), it->second.position.y(), it->second.position.z());
-            }
-        }
-        mtxCamTrajectory.unlock();
-        mtxFeaturesMap.unlock();
-        glEnd();
+        links.upload();
+        glEnableClientState(GL_VERTEX_ARRAY);
+        gl.glBindBuffer(GL_ARRAY_BUFFER, links.vbo);
+        glVertexPointer(3, GL_FLOAT, 0, (const GLvoid*)0);
+        glDrawArrays(GL_LINES, 0, (GLsizei)(2*links.size()));
+        gl.glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glDisableClientState(GL_VERTEX_ARRAY);
     }
     if (config.drawMeasurements){
+        glPointSize((float)config.measurementSize);
+        glColor4f((float)config.measurementsColor.red(), (float)config.measurementsColor.green(), (float)config.measurementsColor.blue(), (float)config.measurementsColor.alpha());
+        glBegin(GL_POINTS);
         mtxMeasurements.lock();
         for (size_t i = 0;i<measurements.size();i++){
-            mtxCamTrajectory.lock();
-            Mat34 camPose = camTrajectory[measurements[i].fromVertexId].pose;
-            mtxCamTrajectory.unlock();
-            double GLmat[16]={camPose(0,0), camPose(1,0), camPose(2,0), camPose(3,0), camPose(0,1), camPose(1,1), camPose(2,1), camPose(3,1), camPose(0,2), camPose(1,2), camPose(2,2), camPose(3,2), camPose(0,3), camPose(1,3), camPose(2,3), camPose(3,3)};
-            glPushMatrix();
-                glMultMatrixd(GLmat);
-                glPointSize((float)config.measurementSize);
-                glBegin(GL_POINTS);
-                glColor4f((float)config.measurementsColor.red(), (float)config.measurementsColor.green(), (float)config.measurementsColor.blue(), (float)config.measurementsColor.alpha());
-                glVertex3d(measurements[i].trans.x(),measurements[i].trans.y(),measurements[i].trans.z());
-                glEnd();
-                if (config.drawEllipsoids){
-                    glColor4f((float)config.ellipsoidColor.red(), (float)config.ellipsoidColor.green(), (float)config.ellipsoidColor.blue(), (float)config.ellipsoidColor.alpha());
-                    drawEllipsoid(measurements[i].trans, measurements[i].info.inverse());
-                }
-            glPopMatrix();
+            if (posesSnapshot.size()<=(size_t)measurements[i].fromVertexId)
+                continue;
+            Eigen::Vector3d point(posesSnapshot[measurements[i].fromVertexId]*measurements[i].trans.vector());
+            glVertex3d(point.x(), point.y(), point.z());
         }
         mtxMeasurements.unlock();
+        glEnd();
+        if (config.drawEllipsoids){
+            glColor4f((float)config.ellipsoidColor.red(), (float)config.ellipsoidColor.green(), (float)config.ellipsoidColor.blue(), (float)config.ellipsoidColor.alpha());
+            drawInstances(ellipsoidInstances);
+        }
     }
     updateMap();
 }
@@ -341,24 +628,15 @@ void QGLVisualizer::updateFeature(std::map<int,MapFeature>& featuresMap,
 
 ///update map
 void QGLVisualizer::updateMap(){
+    // instances are updated only for the modified poses and features
     bufferMapVisualization.mtxBuffer.lock();
-    if (bufferMapVisualization.addFeatures()) {
-        featuresMap.insert(bufferMapVisualization.features2add.begin(),
-                bufferMapVisualization.features2add.end());
-        bufferMapVisualization.features2add.clear();
-    }
-    if (bufferMapVisualization.updateFeatures()) {
-        for (auto it =
-                bufferMapVisualization.features2update.begin();
-                it != bufferMapVisualization.features2update.end(); it++) {
-            updateFeature(featuresMap, it->second);
-        }
-        bufferMapVisualization.features2update.clear();
-    }
     mtxCamTrajectory.lock();
     if (bufferMapVisualization.addPoses()) {
-        camTrajectory.insert(camTrajectory.end(), bufferMapVisualization.poses2add.begin(),
-                bufferMapVisualization.poses2add.end());
+        for (auto it = bufferMapVisualization.poses2add.begin();
+                it != bufferMapVisualization.poses2add.end(); it++) {
+            camTrajectory.push_back(*it);
+            updatePoseInstances((int)camTrajectory.size()-1);
+        }
         bufferMapVisualization.poses2add.clear();
     }
     if (bufferMapVisualization.updatePoses()) {
@@ -366,32 +644,63 @@ void QGLVisualizer::updateMap(){
                 bufferMapVisualization.poses2update.begin();
                 it != bufferMapVisualization.poses2update.end(); it++) {
             camTrajectory[it->vertexId].pose = it->pose;
+            updatePoseInstances(it->vertexId);
         }
         bufferMapVisualization.poses2update.clear();
     }
     mtxCamTrajectory.unlock();
+    if (bufferMapVisualization.addFeatures()) {
+        for (auto it = bufferMapVisualization.features2add.begin();
+                it != bufferMapVisualization.features2add.end(); it++) {
+            if (!featuresMap.insert(*it).second)
+                continue;
+            featureInstancesIds[it->first] = featureInstances.size();
+            setInstance(featureInstances, featureInstances.size(), Mat33::Identity()*config.featuresSize, it->second.position.vector());
+            for (auto itPose = it->second.posesIds.begin(); itPose != it->second.posesIds.end(); itPose++) {
+                linksIds.push_back(std::make_pair((int)*itPose, it->first));
+                poseLinks[*itPose].push_back(linksIds.size()-1);
+                featureLinks[it->first].push_back(linksIds.size()-1);
+                setLink(linksIds.size()-1);
+            }
+        }
+        bufferMapVisualization.features2add.clear();
+    }
+    if (bufferMapVisualization.updateFeatures()) {
+        for (auto it =
+                bufferMapVisualization.features2update.begin();
+                it != bufferMapVisualization.features2update.end(); it++) {
+            updateFeature(featuresMap, it->second);
+            auto instance = featureInstancesIds.find(it->first);
+            if (instance == featureInstancesIds.end())
+                continue;
+            setInstance(featureInstances, instance->second, Mat33::Identity()*config.featuresSize, featuresMap[it->first].position.vector());
+            for (size_t link : featureLinks[it->first])
+                setLink(link);
+        }
+        bufferMapVisualization.features2update.clear();
+    }
     bufferMapVisualization.mtxBuffer.unlock();
-    if (config.drawPointClouds){
-        if (colorImagesBuff.size()>0){
+    if (config.drawPointClouds && gl.buffers){
+        // a few clouds per frame -- the viewer stays responsive and does not compete with SLAM threads
+        for (int cloudsNo = 0; cloudsNo < config.cloudsPerFrame; cloudsNo++){
             mtxImages.lock();
-            size_t imagesSize = colorImagesBuff.size();
-            mtxImages.unlock();
-            while (imagesSize){
-                mtxImages.lock();
-                cv::Mat color(colorImagesBuff.back());
-                colorImagesBuff.pop_back();
-                cv::Mat depth(depthImagesBuff.back());
-                depthImagesBuff.pop_back();
-                int frameNo(imagesIds.back());
-                imagesSize = colorImagesBuff.size();
+            if (colorImagesBuff.empty()){
                 mtxImages.unlock();
-                PointCloud cloud;
-                sensorModel.convert2cloud(color, depth, cloud);
-                mtxPointClouds.lock();
-                pointClouds.push_back(std::make_pair(frameNo, cloud));
-                cloudsList.push_back(createCloudList(pointClouds.back()));
-                mtxPointClouds.unlock();
+                break;
             }
+            cv::Mat color(colorImagesBuff.front());
+            colorImagesBuff.erase(colorImagesBuff.begin());
+            cv::Mat depth(depthImagesBuff.front());
+            depthImagesBuff.erase(depthImagesBuff.begin());
+            int frameNo(imagesIds.front());
+            imagesIds.erase(imagesIds.begin());
+            mtxImages.unlock();
+            PointCloud cloud;
+            sensorModel.convert2cloud(color, depth, cloud);
+            CloudBuffer cloudBuffer = createCloudBuffer(frameNo, cloud);
+            mtxPointClouds.lock();
+            pointClouds.push_back(cloudBuffer);
+            mtxPointClouds.unlock();
         }
     }
     mtxMeasurementsBuff.lock();
@@ -401,6 +710,8 @@ void QGLVisualizer::updateMap(){
             if (((int)(*it).toVertexId>config.measurementFeaturesIds.first)&&
                 ((int)(*it).toVertexId<config.measurementFeaturesIds.second)){
                     measurements.push_back(*it);
+                    poseEllipsoids[(*it).fromVertexId].push_back(measurements.size()-1);
+                    setEllipsoid(measurements.size()-1);
             }
         }
         //measurements.insert(measurements.end(), measurementsBuff.begin(), measurementsBuff.end());
@@ -439,6 +750,16 @@ void QGLVisualizer::init(){
     // Opens help window
     help();
 
+    gl.init();
+    if (!gl.buffers)
+        std::cout << "Visualizer: vertex buffer objects are not supported (OpenGL 1.5), point clouds and links will not be drawn\n";
+    unitSphere.reset(new SolidSphere(1.0f, config.featuresSmoothness, config.featuresSmoothness));
+    if (gl.instancing)
+        instancingProgram = createInstancingProgram();
+    else
+        std::cout << "Visualizer: instanced drawing is not supported (OpenGL 3.3), instances will not be drawn\n";
+
+    setAnimationPeriod(config.animationPeriod);
     startAnimation();
 }
 